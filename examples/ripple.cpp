@@ -44,7 +44,12 @@ using namespace Vectormath::Aos;
 #include "arraybuilder.h"
 #include "buffer.h"
 #include "bufferbuilder.h"
+#include "meshoptimiser.h"
+#include "meshgen.h"
+#include "uniformbuffer.h"
 #include "context.h"
+#include "drawcall.h"
+#include "depthprepass.h"
 #include <shader.h>
 
 namespace ripple
@@ -55,14 +60,10 @@ namespace ripple
 
 	static constexpr float SIZE_X = 4; // size of plane in world space
 	static constexpr float SIZE_Z = 4;
-	static constexpr float HALF_SIZE_X = SIZE_X / 2.0f;
-	static constexpr float HALF_SIZE_Z = SIZE_Z / 2.0f;
 
 	// ripple displacement speed
 	static constexpr float SPEED = 2;
 
-	static constexpr int TOTAL_INDICES = NUM_X * NUM_Z * 2 * 3;
-
 } // namespace ripple
 
 GLuint Context::width = 800;
@@ -105,11 +106,51 @@ std::shared_ptr<float[]> glMat4(const Matrix4 &mat4)
 
 using Vec4 = Vec<GLfloat, 4>;
 using Vec3 = Vec<GLfloat, 3>;
-using Index = Vec<GLushort, 1>;
+using Index = Vec<GLuint, 1>;
+
+// narrowed to the smallest index type that fits the plane
+std::shared_ptr<IndexBuffer> rippleIndices;
+// the plane at rest, and after this frame's ripple
+std::shared_ptr<Buffer<Vec3>> restPositions;
+std::shared_ptr<Buffer<Vec3>> displacedPositions;
+// ripple_displace.comp where there is compute, else ripple_displace.vert captured by transform feedback
+std::shared_ptr<ShaderProgram> displaceCompute;
+std::unique_ptr<DrawCall> displaceCall;
+// draws displacedPositions, however many passes need the plane
+std::unique_ptr<DrawCall> rippleCall;
+// a coarser plane, split up on the GPU as finely as it appears on screen; T switches to it
+std::unique_ptr<DrawCall> tessCall;
+std::shared_ptr<Buffer<Vec3>> tessPositions;
+bool tessellate = false;
+// S shows the render stats overlay
+bool showStats = false;
+// the plane's draws, with a depth prepass when overdraw calls for one; P cycles auto, always and never
+std::unique_ptr<DepthPrepass> prepass;
+
+// the Frame block in every ripple shader
+struct FrameBlock
+{
+	std140::mat4 MVP;
+	GLfloat time;
+	/* framebuffer size in pixels, for the tessellation levels */
+	std140::vec2 viewport;
+
+	static constexpr const char *name = "Frame";
+	static constexpr const char *fields[] = {"MVP", "time", "viewport"};
+	using members = std140::members<std140::mat4, GLfloat, std140::vec2>;
+};
+std::unique_ptr<UniformBuffer<FrameBlock>> frameUniforms;
+
+// the Object block in ripple.vert, pushed through the context's uniform ring for each draw
+struct ObjectBlock
+{
+	std140::mat4 Model;
+
+	static constexpr const char *name = "Object";
+	static constexpr const char *fields[] = {"Model"};
+	using members = std140::members<std140::mat4>;
+};
 
-GLuint vaoBuildID;
-GLuint vboVerticesID;
-GLuint vboIndicesID;
 Matrix4 P = Matrix4::identity();
 
 int width, height;
@@ -120,7 +161,7 @@ using namespace ripple;
 int main()
 {
 
-	std::unique_ptr<Context> context = std::make_unique<Context>(WIDTH, HEIGHT, "Ripple", false);
+	std::unique_ptr<Context> context = std::make_unique<Context>(WIDTH, HEIGHT, "Ripple", false, true);
 	{
 
 		// Set the required callback functions
@@ -148,56 +189,81 @@ int main()
 				std::cout << "Attribute " << attribute.location << " : " << attribute.name << std::endl;
 			}
 			ripple_program->unuse();
+			context->programs.push_back(ripple_program);
 
-			BufferBuilder<Vec3> ripple_positions;
-			BufferBuilder<Index> ripple_indices;
-
-			// setup plane geometry
-			// setup plane vertices
-			int count = 0;
-			int i = 0, j = 0;
-			for (j = 0; j <= NUM_Z; j++)
+			// the ripple itself, evaluated once a frame into a buffer rather than in every pass
+			std::shared_ptr<ShaderProgram> displace_program(new ShaderProgram());
+			if (context->hasCompute)
 			{
-				for (i = 0; i <= NUM_X; i++)
-				{
-					ripple_positions.emplace(((float(i) / (NUM_X - 1)) * 2 - 1) * HALF_SIZE_X, 0.0f, ((float(j) / (NUM_Z - 1)) * 2 - 1) * HALF_SIZE_Z);
-				}
+				displace_program->load_from_file(ShaderKind::eCOMPUTE_SHADER, "./shaders/ripple_displace.comp");
+				displace_program->compile(ShaderKind::eCOMPUTE_SHADER);
+			}
+			else
+			{
+				displace_program->load_from_file(ShaderKind::eVERTEX_SHADER, "./shaders/ripple_displace.vert");
+				displace_program->compile(ShaderKind::eVERTEX_SHADER);
+				displace_program->capture_varyings({"displaced"});
 			}
+			displace_program->link();
+			displace_program->unuse();
+			context->programs.push_back(displace_program);
+
+			// setup plane geometry, split across the worker threads
+			ProceduralMesh plane;
+			generate_plane(plane, SIZE_X, SIZE_Z, NUM_X, NUM_Z, &context->jobs);
+
+			// reorder triangles for the vertex cache and overdraw, and the vertices to match
+			MeshOptimiserReport report = optimise_mesh(plane.indices, plane.positions, plane.normals, plane.uvs);
+			std::cout << "ACMR " << report.before.acmr << " -> " << report.after.acmr
+					  << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << std::endl;
 
-			// fill plane indices array
-			for (i = 0; i < NUM_Z; i++)
+			rippleIndices = plane.indices.make_index_buffer(GL_STATIC_DRAW);
+
+			frameUniforms = std::make_unique<UniformBuffer<FrameBlock>>();
+			frameUniforms->verify(*ripple_program);
+			frameUniforms->verify(*displace_program);
+
+			restPositions = plane.positions.make_buffer(GL_ARRAY_BUFFER);
+			displacedPositions = std::make_shared<Buffer<Vec3>>(GL_ARRAY_BUFFER, nullptr, (GLsizei) plane.positions.mBuffer.size(), GL_DYNAMIC_COPY);
+			if (context->hasCompute)
 			{
-				for (j = 0; j < NUM_X; j++)
-				{
-					int i0 = i * (NUM_X + 1) + j;
-					int i1 = i0 + 1;
-					int i2 = i0 + (NUM_X + 1);
-					int i3 = i2 + 1;
-					if ((j + i) % 2)
-					{
-						ripple_indices.emplace(i0);
-						ripple_indices.emplace(i2);
-						ripple_indices.emplace(i1);
-						ripple_indices.emplace(i1);
-						ripple_indices.emplace(i2);
-						ripple_indices.emplace(i3);
-					}
-					else
-					{
-						ripple_indices.emplace(i0);
-						ripple_indices.emplace(i2);
-						ripple_indices.emplace(i3);
-						ripple_indices.emplace(i0);
-						ripple_indices.emplace(i3);
-						ripple_indices.emplace(i1);
-					}
-				}
+				displaceCompute = displace_program;
 			}
+			else
+			{
+				displaceCall = std::make_unique<DrawCall>(displace_program);
+				displaceCall->addBuffer("vVertex", restPositions);
+			}
+			rippleCall = std::make_unique<DrawCall>(ripple_program);
+			rippleCall->addBuffer("vVertex", displacedPositions);
+			rippleCall->addIndexBuffer(rippleIndices);
+			ripple_program->unuse();
+			prepass = std::make_unique<DepthPrepass>();
 
-			array_builder(vaoBuildID,
-						  ripple_program,
-						  BufferInitialiser<Vec3>{"vVertex", ripple_positions, GL_ARRAY_BUFFER, GL_STATIC_DRAW},
-						  BufferInitialiser<Index>{"", ripple_indices, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW});
+			if (context->hasTessellation)
+			{
+				std::shared_ptr<ShaderProgram> tess_program(new ShaderProgram());
+				tess_program->load_from_file(ShaderKind::eVERTEX_SHADER, "./shaders/ripple_tess.vert");
+				tess_program->load_from_file(ShaderKind::eTESS_CONTROL_SHADER, "./shaders/ripple.tesc");
+				tess_program->load_from_file(ShaderKind::eTESS_EVALUATION_SHADER, "./shaders/ripple.tese");
+				tess_program->load_from_file(ShaderKind::eFRAGMENT_SHADER, "./shaders/ripple.frag");
+				tess_program->compile(ShaderKind::eVERTEX_SHADER);
+				tess_program->compile(ShaderKind::eTESS_CONTROL_SHADER);
+				tess_program->compile(ShaderKind::eTESS_EVALUATION_SHADER);
+				tess_program->compile(ShaderKind::eFRAGMENT_SHADER);
+				tess_program->link();
+				frameUniforms->verify(*tess_program);
+				context->programs.push_back(tess_program);
+
+				// a sixteenth of the triangles; the patches are only ever split from here
+				ProceduralMesh coarse;
+				generate_plane(coarse, SIZE_X, SIZE_Z, NUM_X / 4, NUM_Z / 4);
+				tessPositions = coarse.positions.make_buffer(GL_ARRAY_BUFFER);
+				tessCall = std::make_unique<DrawCall>(tess_program);
+				tessCall->addBuffer("vVertex", tessPositions);
+				tessCall->addIndexBuffer(coarse.indices.make_index_buffer(GL_STATIC_DRAW, true, GL_PATCHES));
+				tess_program->unuse();
+			}
 
 			context->drawcb = [](const Context &context, float alpha)
 			{
@@ -215,24 +281,63 @@ int main()
 				Transform3 MV = Transform3::translation(Vector3(0.0f, 0.0f, camdist)) * Transform3::rotationX(rX) * Transform3::rotationY(rY);
 				Matrix4 MVP = P * MV;
 
-				std::shared_ptr<ShaderProgram> ripple_program(context.programs[0]);
-				ripple_program->use();
-				gl_exec(glBindVertexArray, vaoBuildID);
-				GLint location = ripple_program->uniform_location("MVP");
-				auto mvp = glMat4(MVP);
-				gl_exec(glUniformMatrix4fv, location, 1, GL_FALSE, mvp.get());
-				location = ripple_program->uniform_location("time");
-				gl_exec(glUniform1f, location, vtime);
-				gl_exec(glDrawElements, GL_TRIANGLES, TOTAL_INDICES, GL_UNSIGNED_SHORT, nullptr);
-				gl_exec(glBindVertexArray, 0);
-				ripple_program->unuse();
+				// once per frame, however many programs read it
+				const auto [fbWidth, fbHeight] = context.getFrameBufferSize();
+				frameUniforms->data.MVP = MVP;
+				frameUniforms->data.time = vtime;
+				frameUniforms->data.viewport = std140::vec2{(GLfloat)fbWidth, (GLfloat)fbHeight};
+				frameUniforms->upload();
+
+				ObjectBlock object;
+				object.Model = Matrix4::identity();
+				if (tessellate && tessCall)
+				{
+					// displaced in ripple.tese, so there is no separate pass
+					tessCall->program->use();
+					context.uniforms.bind(object);
+					tessCall->drawPatches(3);
+					tessCall->program->unuse();
+					return;
+				}
+
+				if (displaceCompute)
+				{
+					restPositions->bindStorage("Rest");
+					displacedPositions->bindStorage("Displaced");
+					displaceCompute->dispatch_invocations(displacedPositions->getSize());
+					displaceCompute->unuse();
+					// the draw below reads the result as vertices
+					memory_barrier(eBARRIER_VERTEX_ATTRIB);
+				}
+				else
+				{
+					displaceCall->capture(displacedPositions);
+				}
+
+				prepass->opaque(*rippleCall, [&](ShaderProgram &) { context.uniforms.bind(object); });
+				prepass->flush(fbWidth, fbHeight);
 			};
 
 			// Game loop
 			while (!context->done())
 			{
+				context->showStats = showStats;
 				context->draw();
 			}
+			if (displaceCall)
+			{
+				std::cout << "Captured " << displaceCall->capturedPrimitives() << " of " << displacedPositions->getSize() << " vertices" << std::endl;
+			}
+			prepass.reset();
+			rippleCall.reset();
+			tessCall.reset();
+			tessPositions.reset();
+			displaceCall.reset();
+			displaceCompute.reset();
+			displacedPositions.reset();
+			restPositions.reset();
+			rippleIndices.reset();
+			frameUniforms.reset();
 		}
 		context.release();
 		// Terminates GLFW, clearing any resources allocated by GLFW.
@@ -246,6 +351,18 @@ void key_cb(GLFWwindow *window, int key, int scancode, int action, int mode)
 	std::cout << key << std::endl;
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GL_TRUE);
+	if (key == GLFW_KEY_T && action == GLFW_PRESS)
+		tessellate = !tessellate;
+	if (key == GLFW_KEY_S && action == GLFW_PRESS)
+		showStats = !showStats;
+	if (key == GLFW_KEY_P && action == GLFW_PRESS && prepass)
+	{
+		static DepthPrepass::Mode prepassMode = DepthPrepass::eAUTO;
+		prepassMode = DepthPrepass::Mode((prepassMode + 1) % 3);
+		prepass->setMode(prepassMode);
+		std::cout << "Depth prepass " << (prepassMode == DepthPrepass::eAUTO ? "auto" : prepassMode == DepthPrepass::eALWAYS ? "always" : "never")
+				  << ", overdraw " << prepass->overdraw() << std::endl;
+	}
 }
 
 void fb_size_cb(GLFWwindow *window, int fbwidth, int fbheight)
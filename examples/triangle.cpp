@@ -48,6 +48,7 @@ using namespace Vectormath::Aos;
 #include "drawcall.h"
 #include "framebuffer.h"
 #include "vertexdata.h"
+#include "immediatebatcher.h"
 
 GLuint Context::width = 800;
 GLuint Context::height = 600;
@@ -97,6 +98,8 @@ ColouredVertex vertices[3];
 GLshort indices[3];
 GLuint vaoID;
 GLuint vaoBuildID;
+// outlines over the triangle, rebuilt every frame
+std::unique_ptr<ImmediateBatcher> debugDraw;
 GLuint vboVerticesID;
 GLuint vboColorsID;
 GLuint vboIndicesID;
@@ -143,6 +146,7 @@ int main()
 					  BufferInitialiser<Vec3>{"vVertex", positions, GL_ARRAY_BUFFER, GL_STATIC_DRAW},
 					  BufferInitialiser<Vec4>{"vColor", colors, GL_ARRAY_BUFFER, GL_STATIC_DRAW},
 					  IndexBufferInitialiser<Index>{indices, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW});
+		debugDraw = std::make_unique<ImmediateBatcher>();
 
 		context->drawcb = [](const Context &context, float alpha)
 		{
@@ -164,23 +168,39 @@ int main()
 			gl_exec(glClear, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
 			// nvgEndFrame(vg);
-			std::shared_ptr<ShaderProgram> program(context.programs[0]);
-			program->use();
+			// a reference, so the frame costs no reference count traffic
+			ShaderProgram &program = *context.programs[0];
+			program.use();
 			glBindVertexArray(vaoBuildID);
-			GLint location = program->uniform_location("MVP");
+			GLint location = program.uniform_location("MVP");
 			Matrix4 modelview_projection = proj * model_view;
 			std::shared_ptr<float[]> mvp = glMat4(modelview_projection);
-			glUniformMatrix4fv(location, 1, GL_FALSE, mvp.get());
+			gl_exec(glUniformMatrix4fv, location, 1, GL_FALSE, mvp.get());
 			glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_SHORT, 0);
 			glBindVertexArray(0);
-			program->unuse();
+
+			// the MVP set above stays with the program for the batcher's draws
+			debugDraw->box(program, Point3(-0.95f, -0.95f, -0.5f), Point3(0.95f, 0.95f, 0.5f), ImmediateBatcher::rgba(255, 255, 255));
+			debugDraw->cross(program, Point3(0.0f, -1.0f / 3.0f, 0.0f), 0.1f, ImmediateBatcher::rgba(255, 255, 0));
+			const Point3 corners[3] = {Point3(-1.0f, -1.0f, 0.0f), Point3(0.0f, 1.0f, 0.0f), Point3(1.0f, -1.0f, 0.0f)};
+			for (int i = 0; i < 3; ++i)
+			{
+				debugDraw->line(program, corners[i], corners[(i + 1) % 3], ImmediateBatcher::rgba(255, 0, 255));
+			}
+			debugDraw->flush();
+			program.unuse();
 		};
 
+		// static chrome: tessellated once, then redrawn from the layer's cache
+		context->ui->addPanel([](NVGcontext *vg) { drawNVGWindow(vg, "Triangle", 16.0f, 16.0f, 200.0f, 120.0f); });
+		context->ui->addPanel([](NVGcontext *vg) { drawNVGWindow(vg, "Properties", 16.0f, 152.0f, 200.0f, 240.0f); });
+
 		// Game loop
 		while (!context->done())
 		{
 			context->draw();
 		}
+		debugDraw.reset();
 		program->unuse();
 	}
 	// Terminates GLFW, clearing any resources allocated by GLFW.
@@ -49,6 +49,12 @@ std::shared_ptr<Buffer<T>> build_data_buffer(std::shared_ptr<ShaderProgram> prog
 
 }
 
+/* index buffers that pick their own type are built up front and passed straight through */
+inline std::shared_ptr<IndexBuffer> build_data_buffer(std::shared_ptr<ShaderProgram> program, std::shared_ptr<IndexBuffer> buffer)
+{
+	return buffer;
+}
+
 template <typename T>
 void bind_attribute(AttributeInitaliser<T> &attribute_buffer)
 {
@@ -62,6 +68,11 @@ void bind_attribute(std::shared_ptr<Buffer<T>> buffer)
 	buffer->bindIndices();
 }
 
+inline void bind_attribute(std::shared_ptr<IndexBuffer> buffer)
+{
+	buffer->bindIndices();
+}
+
 /* for each attribute buffer we bind the attributes */
 template <typename... Ts>
 void bind_attributes(std::tuple<Ts...> &tuple)
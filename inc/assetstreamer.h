@@ -0,0 +1,169 @@
+#pragma once
+
+/**
+ * Asynchronous asset streaming. Files are read and decoded on the job
+ * system's workers; finished data joins an upload queue that the GL thread
+ * drains in update(), copying at most a fixed number of bytes a frame
+ * through a mapped staging buffer: glCopyBufferSubData for buffers, and
+ * glTexSubImage2D with the staging buffer as the pixel unpack buffer for
+ * textures. Large assets are spread over as many frames as their size
+ * needs, so streaming never stalls a frame for longer than the budget allows.
+ *
+ * Requests hand back a std::shared_future that becomes ready once the data is
+ * on the GPU. Only poll it (is_ready) on the GL thread: the upload itself
+ * happens there, so blocking on it would never finish.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "jobsystem.h"
+#include "texture.h"
+
+template <typename T>
+class Buffer;
+template <typename T>
+class BufferBuilder;
+
+template <typename T>
+using Streamed = std::shared_future<std::shared_ptr<T>>;
+
+template <typename T>
+bool is_ready(const Streamed<T> &streamed)
+{
+	return streamed.valid() && streamed.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+class AssetStreamer
+{
+public:
+	/* the largest piece of a buffer, or band of texture rows, copied in one go */
+	static constexpr GLsizeiptr BUFFER_PIECE_SIZE = 64 << 10;
+	static constexpr GLsizeiptr TEXTURE_BAND_SIZE = 256 << 10;
+
+	/* stagingSize is also the most a single frame can upload; it is at least TEXTURE_BAND_SIZE */
+	explicit AssetStreamer(JobSystem &jobs, GLsizeiptr stagingSize = 4 << 20, GLsizeiptr bytesPerFrame = 1 << 20);
+	~AssetStreamer();
+
+	AssetStreamer(const AssetStreamer &other) = delete;
+	AssetStreamer &operator=(const AssetStreamer &other) = delete;
+
+	/* a frame always copies at least one piece, so budgets under a piece's size round up to it */
+	void set_budget(GLsizeiptr bytesPerFrame);
+	GLsizeiptr get_budget() const
+	{
+		return budget;
+	}
+
+	/* uploads waiting for the GL thread, including any part way through */
+	size_t pending() const;
+
+	/**
+	 * Run on the GL thread once a frame (Context::draw does this): start new
+	 * uploads and copy up to the budget. Returns the number of bytes copied.
+	 */
+	GLsizeiptr update();
+
+	/**
+	 * Read a whole file on a worker. Nothing goes to the GPU, so this is
+	 * ready as soon as the read finishes; shaders compile from it as usual.
+	 */
+	Streamed<std::vector<GLchar>> stream_file(const std::filesystem::path &filename);
+
+	/**
+	 * Build a buffer on a worker and stream it into a Buffer<T>.
+	 * @param build Loads and decodes the data, eg. by filling a BufferBuilder from a file
+	 * @param target GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+	 * @param usage Usage hint
+	 */
+	template <typename T>
+	Streamed<Buffer<T>> stream_buffer(std::function<BufferBuilder<T>()> build, GLenum target, GLenum usage = GL_STATIC_DRAW)
+	{
+		auto promise = std::make_shared<std::promise<std::shared_ptr<Buffer<T>>>>();
+		Streamed<Buffer<T>> result = promise->get_future().share();
+		std::shared_ptr<Queue> shared = queue;
+		jobs.run([shared, promise, build = std::move(build), target, usage]() {
+			Upload upload;
+			GLsizei count = 0;
+			try
+			{
+				BufferBuilder<T> builder = build();
+				count = GLsizei(builder.mBuffer.size());
+				upload.bytes.resize(builder.mBuffer.size() * sizeof(T));
+				if (!upload.bytes.empty())
+					std::memcpy(upload.bytes.data(), builder.mBuffer.data(), upload.bytes.size());
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+				return;
+			}
+			// these only ever run on the GL thread
+			auto buffer = std::make_shared<std::shared_ptr<Buffer<T>>>();
+			upload.create = [buffer, target, usage, count]() {
+				*buffer = std::make_shared<Buffer<T>>(target, nullptr, count, usage);
+			};
+			add_buffer_pieces(upload, [buffer]() { return (*buffer)->getBuffer(); });
+			upload.complete = [buffer, promise]() {
+				promise->set_value(std::move(*buffer));
+			};
+			push(*shared, std::move(upload));
+		});
+		return result;
+	}
+
+	/**
+	 * Load an image on a worker, build its mips there if the filter is a CPU
+	 * one, and stream the levels into a Texture through a pixel unpack buffer.
+	 */
+	Streamed<Texture> stream_texture(const std::filesystem::path &filename, MipFilter filter = eMIP_KAISER, bool srgb = true);
+
+private:
+	/**
+	 * A range of bytes that goes up in one go. Once it is in the staging
+	 * buffer, issue is called with its offset there, with the staging buffer
+	 * bound to both GL_COPY_READ_BUFFER and GL_PIXEL_UNPACK_BUFFER.
+	 */
+	struct Piece
+	{
+		GLsizeiptr offset;
+		GLsizeiptr size;
+		std::function<void(GLintptr source)> issue;
+	};
+
+	struct Upload
+	{
+		std::vector<GLubyte> bytes;
+		std::vector<Piece> pieces;
+		/* pieces already copied */
+		size_t next = 0;
+		bool created = false;
+		/* make the destination object, before the first piece goes */
+		std::function<void()> create;
+		std::function<void()> complete;
+	};
+
+	/* shared with the worker jobs, so it outlives the streamer if they do */
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Upload> incoming;
+	};
+
+	static void push(Queue &queue, Upload upload);
+	static void add_buffer_pieces(Upload &upload, std::function<GLuint()> destination);
+
+	JobSystem &jobs;
+	std::shared_ptr<Queue> queue;
+	std::deque<Upload> active;
+	GLuint staging;
+	GLsizeiptr stagingSize;
+	GLsizeiptr budget;
+};
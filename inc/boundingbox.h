@@ -0,0 +1,57 @@
+#pragma once
+
+#include <limits>
+
+/**
+ * Axis aligned bounding box. A default constructed box is empty and grows
+ * to fit whatever is added to it.
+ */
+struct BoundingBox
+{
+	Point3 lower{std::numeric_limits<float>::max()};
+	Point3 upper{-std::numeric_limits<float>::max()};
+
+	bool empty() const
+	{
+		return lower.getX() > upper.getX();
+	}
+
+	void extend(const Point3 &point)
+	{
+		lower = minPerElem(lower, point);
+		upper = maxPerElem(upper, point);
+	}
+
+	void extend(const BoundingBox &other)
+	{
+		if (other.empty())
+			return;
+		lower = minPerElem(lower, other.lower);
+		upper = maxPerElem(upper, other.upper);
+	}
+
+	Point3 centre() const
+	{
+		return lerp(0.5f, lower, upper);
+	}
+
+	Vector3 extents() const
+	{
+		return (upper - lower) * 0.5f;
+	}
+};
+
+/**
+ * Bounding sphere. BufferBuilder centres it on the box centre, so a culler
+ * can test against whichever of the two is tighter.
+ */
+struct BoundingSphere
+{
+	Point3 centre{0.0f};
+	float radius{-1.0f};
+
+	bool empty() const
+	{
+		return radius < 0.0f;
+	}
+};
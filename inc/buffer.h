@@ -1,4 +1,5 @@
 #pragma once
+#include <utility>
 
 /**
  * API for binding an opengl buffer
@@ -16,6 +17,23 @@ private:
 	GLsizei mSize;
 	static constexpr GLsizei mComponentCount = element_type::dim;
 	static constexpr GLenum  mType = GL_enum<component_type>::value;
+	/* how the vertex shader sees each element (see GL_attribute) */
+	static constexpr GLint     mAttributeSize = GL_attribute<component_type>::size(mComponentCount);
+	static constexpr GLboolean mNormalized = GL_attribute<component_type>::normalized;
+	static constexpr bool      mInteger = GL_attribute<component_type>::integer;
+
+	void setAttributePointer(GLint location)
+	{
+		constexpr GLsizei stride = GLsizei(sizeof(component_type) * mComponentCount);
+		if constexpr (mInteger)
+		{
+			gl_exec(glVertexAttribIPointer, location, mAttributeSize, mType, stride, nullptr);
+		}
+		else
+		{
+			gl_exec(glVertexAttribPointer, location, mAttributeSize, mType, mNormalized, stride, nullptr);
+		}
+	}
 
 public:
 
@@ -44,7 +62,24 @@ public:
 
 	~Buffer() 
 	{
-		gl_exec(glDeleteBuffers, 1, &mBuffer);
+		if (mBuffer != 0)
+			gl_exec(glDeleteBuffers, 1, &mBuffer);
+	}
+
+	Buffer(const Buffer &other) = delete;
+	Buffer &operator=(const Buffer &other) = delete;
+
+	/* a moved from buffer owns nothing */
+	Buffer(Buffer &&other) noexcept : mBuffer(std::exchange(other.mBuffer, 0)), mTarget(other.mTarget), mSize(std::exchange(other.mSize, 0))
+	{
+	}
+
+	Buffer &operator=(Buffer &&other) noexcept
+	{
+		std::swap(mBuffer, other.mBuffer);
+		std::swap(mTarget, other.mTarget);
+		std::swap(mSize, other.mSize);
+		return *this;
 	}
 	
 	GLuint getSize() const {
@@ -55,6 +90,10 @@ public:
 		return mType;
 	}
 
+	GLuint getBuffer() const {
+		return mBuffer;
+	}
+
 	void update(const void *bufferData, GLenum usage)
 	{
 		constexpr GLsizei typeSize = sizeof(component_type);
@@ -64,21 +103,44 @@ public:
 		return;
 	}
 
- 	 void bindAttribute(std::shared_ptr<ShaderProgram> program, const std::string& name) 
+ 	 void bindAttribute(ShaderProgram &program, const std::string& name) 
 	 {
-	    GLint location = program->attribute_location(name);
+	    GLint location = program.attribute_location(name);
 		gl_exec(glBindBuffer, mTarget, mBuffer);
 		gl_exec(glEnableVertexAttribArray, location);
-		gl_exec(glVertexAttribPointer, location, mComponentCount, mType, GL_FALSE, GLsizei(sizeof(component_type) * mComponentCount), nullptr);
+		setAttributePointer(location);
 	 }
 
+	void bindAttribute(const std::shared_ptr<ShaderProgram> &program, const std::string& name)
+	{
+		bindAttribute(*program, name);
+	}
+
 	void bindAttribute(GLint location)
 	 {
 		gl_exec(glBindBuffer, mTarget, mBuffer);
 		gl_exec(glEnableVertexAttribArray, location);
-		gl_exec(glVertexAttribPointer, location, mComponentCount, mType, GL_FALSE, GLsizei(sizeof(component_type) * mComponentCount), nullptr);
+		setAttributePointer(location);
 	 }
 
+	/* capture transform feedback output into this buffer, at binding point index */
+	void bindFeedback(GLuint index = 0)
+	{
+		gl_exec(glBindBufferBase, GL_TRANSFORM_FEEDBACK_BUFFER, index, mBuffer);
+	}
+
+	/* read and write this buffer as a shader storage block, at binding point index */
+	void bindStorage(GLuint index)
+	{
+		gl_exec(glBindBufferBase, GL_SHADER_STORAGE_BUFFER, index, mBuffer);
+	}
+
+	/* the same, at the binding point of storage blocks of this name (see storage_block_binding) */
+	void bindStorage(const std::string& blockName)
+	{
+		bindStorage(storage_block_binding(blockName));
+	}
+
 	void unbind()
 	{
 		gl_ext(glBindBuffer, mTarget, 0);
@@ -100,6 +162,17 @@ public:
 		gl_exec(glDrawElements, mode, mSize, mType, (void*) 0);
 	}
 
+	/**
+	 * Draw the buffer's indices as patches for the tessellation stages
+	 * @param verticesPerPatch Control points in each patch, eg 3 for a triangle list
+	 */
+	void drawPatches(GLint verticesPerPatch) const
+	{
+		assert(mTarget == GL_ELEMENT_ARRAY_BUFFER);
+		gl_exec(glPatchParameteri, GL_PATCH_VERTICES, verticesPerPatch);
+		gl_exec(glDrawElements, GL_PATCHES, mSize, mType, (void*) 0);
+	}
+
 	/**
 	 * Draw some of the buffer
 	 * @param mode Primitive to use
@@ -1,6 +1,12 @@
 
 #pragma once
 
+#include "boundingbox.h"
+#include "indexbuffer.h"
+#include "uvremap.h"
+#include "vertexpacking.h"
+#include "vertextransform.h"
+
 // look at http://coliru.stacked-crooked.com/a/454dc9ba82274528
 /**
  * Class used to build a binary buffer from a sequence of scalar tuples,
@@ -20,6 +26,12 @@ public:
 	/* datatype of elements in the buffer */
 	static constexpr GLenum  mType = GL_enum<component_type>::value;
 
+	/* positions are three float elements; only they grow the bounds when added directly */
+	static constexpr bool mIsPosition = element_type::dim == 3 && std::is_same<component_type, GLfloat>::value;
+
+	/* bounds of every position added so far, as Point3s or as position elements */
+	BoundingBox mBounds;
+
 
 	BufferBuilder(std::initializer_list<element_type> list)
 	{
@@ -27,7 +39,7 @@ public:
 		std::initializer_list<element_type>::iterator it = list.begin();
 		while(it != list.end())
 		{
-			mBuffer.push_back(*it);
+			add(*it);
 			++it;
 		}
 	}
@@ -42,33 +54,169 @@ public:
 	void add(const element_type& vec)
 	{
 		mBuffer.push_back(vec);
+		if constexpr (mIsPosition)
+			mBounds.extend(Point3(vec.x, vec.y, vec.z));
 	}
 
 	template <typename... Args>
 	void emplace(Args&&... args)
 	{
 		mBuffer.emplace_back(std::forward<Args>(args)...);
+		if constexpr (mIsPosition)
+			mBounds.extend(Point3(mBuffer.back().x, mBuffer.back().y, mBuffer.back().z));
+	}
+
+	void add(const Point3 &point)
+	{
+		add(&point, 1);
+	}
+
+	void add(const Vector3 &vec)
+	{
+		add(&vec, 1);
+	}
+
+	void add(const Vector4 &vec)
+	{
+		add(&vec, 1);
+	}
+
+	/**
+	 * Bulk appends from arrays of vectormath values (see vertextransform.h).
+	 * Builders of compressed formats receive the converted values.
+	 */
+	void add(const Point3 *points, size_t count)
+	{
+		mBounds.extend(compute_bounds(points, count));
+		append_floats<3>(count, [points](GLfloat *dst, size_t first, size_t n) { pack_xyz(points + first, dst, n); });
+	}
+
+	void add(const Vector3 *vectors, size_t count)
+	{
+		append_floats<3>(count, [vectors](GLfloat *dst, size_t first, size_t n) { pack_xyz(vectors + first, dst, n); });
+	}
+
+	void add(const Vector4 *vectors, size_t count)
+	{
+		append_floats<4>(count, [vectors](GLfloat *dst, size_t first, size_t n) { pack_xyzw(vectors + first, dst, n); });
+	}
+
+	/* append points transformed by an affine matrix, returning the bounds of what was added */
+	BoundingBox add_transformed(const Matrix4 &matrix, const Point3 *points, size_t count)
+	{
+		BoundingBox bounds;
+		append_floats<3>(count, [&](GLfloat *dst, size_t first, size_t n) { transform_points(matrix, points + first, dst, n, bounds); });
+		mBounds.extend(bounds);
+		return bounds;
+	}
+
+	/* append directions transformed by a 3x3 matrix, eg. normals by the inverse transpose */
+	void add_transformed(const Matrix3 &matrix, const Vector3 *vectors, size_t count, bool normalise = false)
+	{
+		append_floats<3>(count, [&](GLfloat *dst, size_t first, size_t n) { transform_vectors(matrix, vectors + first, dst, n, normalise); });
+	}
+
+	void add_normalised(const Vector3 *vectors, size_t count)
+	{
+		append_floats<3>(count, [vectors](GLfloat *dst, size_t first, size_t n) { normalise_vectors(vectors + first, dst, n); });
+	}
+
+	/**
+	 * Append elements converted from tightly packed floats, eg. to halves or
+	 * normalised shorts (see vertexpacking.h).
+	 * @param src Floats to convert, GL_attribute size floats per element
+	 * @param count Number of elements to append
+	 */
+	void add_packed(const GLfloat *src, GLsizei count)
+	{
+		const size_t base = mBuffer.size();
+		mBuffer.resize(base + count);
+		pack_components(src, reinterpret_cast<component_type *>(&mBuffer[base]), size_t(count) * mComponentCount);
 	}
 
-	void add(Point3 point)
+	/* append the whole of a float builder, converted to this builder's format */
+	template <typename S>
+	void add_packed(const BufferBuilder<S> &source)
 	{
-		GLfloat v3[3];
-		storeXYZ(point, &v3);
-		mBuffer.push_back(v3);
+		static_assert(std::is_same<typename S::type, GLfloat>::value, "Can only pack from float buffers!");
+		static_assert(S::dim == GL_attribute<component_type>::size(mComponentCount), "Source dimension does not match!");
+		if (!source.mBuffer.empty())
+			add_packed(&source.mBuffer[0].x, GLsizei(source.mBuffer.size()));
+		mBounds.extend(source.mBounds);
 	}
 
-	void add(Vector3& vec)
+	const BoundingBox &bounds() const
 	{
-		GLfloat v3[3];
-		storeXYZ(vec, &v3);
-		mBuffer.push_back(v3);
+		return mBounds;
 	}
 
-	void add(Vector4& vec)
+	/* rebuild the bounds after writing positions straight into mBuffer */
+	void recompute_bounds()
 	{
-		GLfloat v4[4];
-		storeXYZW(vec, &v4);
-		mBuffer.push_back(v4);
+		static_assert(mIsPosition, "Only float position builders can measure their bounds!");
+		mBounds = BoundingBox();
+		for (const element_type &p : mBuffer)
+			mBounds.extend(Point3(p.x, p.y, p.z));
+	}
+
+	/**
+	 * Sphere around the positions, centred on the box centre. Float position
+	 * builders measure the furthest position from there, which is usually much
+	 * tighter than the box corners; other formats fall back to those.
+	 */
+	BoundingSphere boundingSphere() const
+	{
+		BoundingSphere sphere;
+		if (mBounds.empty())
+			return sphere;
+		sphere.centre = mBounds.centre();
+		if constexpr (mIsPosition)
+		{
+			const GLfloat cx = sphere.centre.getX(), cy = sphere.centre.getY(), cz = sphere.centre.getZ();
+			GLfloat furthest = 0.0f;
+			for (const element_type &p : mBuffer)
+			{
+				const GLfloat dx = p.x - cx, dy = p.y - cy, dz = p.z - cz;
+				furthest = std::max(furthest, dx * dx + dy * dy + dz * dz);
+			}
+			sphere.radius = std::sqrt(furthest);
+		}
+		else
+		{
+			sphere.radius = length(mBounds.extents());
+		}
+		return sphere;
+	}
+
+	/**
+	 * Append count elements whose float form kernel(dst, first, n) writes, Width
+	 * floats each. Float builders are written in place; other formats are
+	 * staged in blocks and converted with pack_components.
+	 */
+	template <size_t Width, typename Kernel>
+	void append_floats(size_t count, Kernel &&kernel)
+	{
+		static_assert(Width == size_t(GL_attribute<component_type>::size(mComponentCount)), "Element dimension does not match the source!");
+		if (count == 0)
+			return;
+		const size_t base = mBuffer.size();
+		mBuffer.resize(base + count);
+		component_type *dst = reinterpret_cast<component_type *>(&mBuffer[base]);
+		if constexpr (std::is_same<component_type, GLfloat>::value)
+		{
+			kernel(dst, 0, count);
+		}
+		else
+		{
+			constexpr size_t blockSize = 256;
+			GLfloat staging[blockSize * Width];
+			for (size_t first = 0; first < count; first += blockSize)
+			{
+				const size_t n = std::min(blockSize, count - first);
+				kernel(staging, first, n);
+				pack_components(staging, dst + first * mComponentCount, n * mComponentCount);
+			}
+		}
 	}
 
     const void* BufferBuilder::getData()
@@ -102,6 +250,67 @@ public:
 		return ::produce_buffer<T>(target, getData(), (GLsizei) mBuffer.size(), usage);
 	}
 
+	/* largest value in an index builder, which decides the index type at upload */
+	GLuint maxIndex() const
+	{
+		static_assert(element_type::dim == 1 && std::is_integral<component_type>::value, "Only index builders have a maximum index!");
+		GLuint result = 0;
+		for (const element_type &index : mBuffer)
+			result = std::max(result, GLuint(index.x));
+		return result;
+	}
+
+	/**
+	 * Upload an index builder as the narrowest index type that holds it
+	 * @param allow32Bit If false, triangle lists too big for 16 bit indices are split into base vertex chunks
+	 * @param mode The primitives the indices make
+	 */
+	std::shared_ptr<IndexBuffer> make_index_buffer(GLenum usage = GL_STATIC_DRAW, bool allow32Bit = true, GLenum mode = GL_TRIANGLES)
+	{
+		static_assert(element_type::dim == 1 && std::is_integral<component_type>::value, "Only index builders can make index buffers!");
+		std::vector<GLuint> wide;
+		const GLuint *indices = nullptr;
+		if constexpr (std::is_same<component_type, GLuint>::value)
+		{
+			indices = mBuffer.empty() ? nullptr : &mBuffer[0].x;
+		}
+		else
+		{
+			wide.reserve(mBuffer.size());
+			for (const element_type &index : mBuffer)
+				wide.push_back(GLuint(index.x));
+			indices = wide.data();
+		}
+		return std::make_shared<IndexBuffer>(indices, elementCount(), maxIndex(), usage, allow32Bit, mode);
+	}
+
+	/**
+	 * Move texture coordinates [first, first + count) into their image's place
+	 * in an atlas or texture array. Three component coordinates also get the
+	 * array layer.
+	 */
+	void remap_uvs(const UVRemap &remap, size_t first = 0, size_t count = SIZE_MAX)
+	{
+		static_assert((element_type::dim == 2 || element_type::dim == 3) && std::is_same<component_type, GLfloat>::value,
+					  "Only float texture coordinates can be remapped!");
+		const size_t end = first + std::min(count, mBuffer.size() - std::min(first, mBuffer.size()));
+		for (size_t i = first; i < end; ++i)
+		{
+			element_type &uv = mBuffer[i];
+			remap.apply(uv.x, uv.y);
+			if constexpr (element_type::dim == 3)
+				uv.z = remap.layer;
+		}
+	}
+
+	/* remap every texture coordinate through the table, imageOfVertex[i] naming the image vertex i samples */
+	void remap_uvs(const UVRemapTable &table, const std::vector<GLuint> &imageOfVertex)
+	{
+		assert(imageOfVertex.size() == mBuffer.size());
+		for (size_t i = 0; i < mBuffer.size(); ++i)
+			remap_uvs(table[imageOfVertex[i]], i, 1);
+	}
+
 	void update_buffer(std::shared_ptr< Buffer<element_type> > buffer)
 	{
 		buuffer->update(getData());
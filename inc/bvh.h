@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * Bounding volume hierarchy over scene items, for culling and picking in
+ * scenes too big for CullingSet's linear pass. Built top down with the
+ * binned surface area heuristic; objects that move only need refit(),
+ * which keeps the tree shape and regrows the boxes bottom up. Nodes are
+ * 32 bytes, stored depth first so a node's left child follows it directly,
+ * and each subtree's items are contiguous.
+ */
+
+#include <functional>
+#include <limits>
+#include <vector>
+#include "boundingbox.h"
+#include "culling.h"
+
+/* a ray, or a segment when maxDistance is finite; direction need not be normalised */
+struct Ray
+{
+    Point3 origin;
+    Vector3 direction;
+    GLfloat maxDistance = std::numeric_limits<GLfloat>::max();
+
+    /* from a to b; distances along it are then fractions of the way */
+    static Ray segment(const Point3 &a, const Point3 &b)
+    {
+        return Ray{a, b - a, 1.0f};
+    }
+};
+
+struct RayHit
+{
+    GLuint item;
+    /* in units of the ray's direction */
+    GLfloat distance;
+};
+
+class BVH
+{
+public:
+    /* items per leaf before the heuristic is even asked */
+    static constexpr GLuint MAX_LEAF_ITEMS = 4;
+
+    /**
+     * Exact test of a ray against one item, for when its box is not enough:
+     * returns whether it hit, and if so, before distance, updating distance.
+     */
+    using ItemTest = std::function<bool(GLuint item, const Ray &ray, GLfloat &distance)>;
+
+    void build(const std::vector<BoundingBox> &boxes);
+
+    /* move an item; takes effect at the next refit */
+    void set(GLuint item, const BoundingBox &box);
+
+    /* regrow every node's box around its children, keeping the tree shape */
+    void refit();
+
+    size_t size() const
+    {
+        return mBoxes.size();
+    }
+
+    size_t nodeCount() const
+    {
+        return mNodes.size();
+    }
+
+    /**
+     * Fill visible with every item whose box is at least partly inside the
+     * frustum, in tree order. Subtrees inside a plane stop testing it, and
+     * those inside all six are taken whole.
+     * @return number of visible items
+     */
+    size_t cull(const Frustum &frustum, std::vector<GLuint> &visible) const;
+
+    /* nearest item hit by the ray, by box or by exact test */
+    bool raycast(const Ray &ray, RayHit &hit, const ItemTest &exact = nullptr) const;
+
+private:
+    struct Node
+    {
+        GLfloat lower[3];
+        /* items in a leaf, 0 for an interior node */
+        GLuint count;
+        GLfloat upper[3];
+        /* leaf: first of its items in mItems; interior: the right child, the left being the next node */
+        GLuint offset;
+    };
+    static_assert(sizeof(Node) == 32, "Nodes should be half a cache line");
+
+    GLuint buildNode(GLuint first, GLuint count, GLuint depth, std::vector<Point3> &centres);
+    void fitNode(Node &node, GLuint first, GLuint count) const;
+    void appendSubtree(GLuint node, std::vector<GLuint> &visible) const;
+
+    std::vector<Node> mNodes;
+    std::vector<GLuint> mItems;
+    std::vector<BoundingBox> mBoxes;
+};
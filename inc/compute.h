@@ -0,0 +1,58 @@
+#pragma once
+
+/**
+ * Compute support: needs a GL 4.3 context (see Context's compute flag) or the
+ * ARB compute, storage buffer and image load/store extensions. Programs are
+ * built from a lone eCOMPUTE_SHADER and run with ShaderProgram::dispatch;
+ * their inputs and outputs are storage buffers (Buffer::bindStorage) and
+ * images (Texture::bindImage). Writes from a dispatch are only seen by later
+ * work after a memory_barrier naming how that work will read them.
+ */
+
+/* how the data a dispatch wrote is about to be read */
+enum Barrier : GLbitfield
+{
+	/* as vertex attributes, eg. positions a compute pass deformed */
+	eBARRIER_VERTEX_ATTRIB     = GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT,
+	eBARRIER_ELEMENT_ARRAY     = GL_ELEMENT_ARRAY_BARRIER_BIT,
+	eBARRIER_UNIFORM           = GL_UNIFORM_BARRIER_BIT,
+	/* sampled through a texture unit */
+	eBARRIER_TEXTURE_FETCH     = GL_TEXTURE_FETCH_BARRIER_BIT,
+	/* by image loads and stores in a later dispatch or draw */
+	eBARRIER_IMAGE_ACCESS      = GL_SHADER_IMAGE_ACCESS_BARRIER_BIT,
+	/* as indirect draw or dispatch arguments */
+	eBARRIER_COMMAND           = GL_COMMAND_BARRIER_BIT,
+	eBARRIER_PIXEL_BUFFER      = GL_PIXEL_BUFFER_BARRIER_BIT,
+	eBARRIER_TEXTURE_UPDATE    = GL_TEXTURE_UPDATE_BARRIER_BIT,
+	/* by glBufferSubData, glGetBufferSubData or a mapping */
+	eBARRIER_BUFFER_UPDATE     = GL_BUFFER_UPDATE_BARRIER_BIT,
+	eBARRIER_FRAMEBUFFER       = GL_FRAMEBUFFER_BARRIER_BIT,
+	eBARRIER_TRANSFORM_FEEDBACK = GL_TRANSFORM_FEEDBACK_BARRIER_BIT,
+	eBARRIER_ATOMIC_COUNTER    = GL_ATOMIC_COUNTER_BARRIER_BIT,
+	/* by storage buffer access in a later dispatch or draw */
+	eBARRIER_STORAGE           = GL_SHADER_STORAGE_BARRIER_BIT,
+	eBARRIER_ALL               = GL_ALL_BARRIER_BITS
+};
+
+inline Barrier operator|(Barrier a, Barrier b)
+{
+	return Barrier(GLbitfield(a) | GLbitfield(b));
+}
+
+/* make earlier incoherent writes (storage buffers, images, atomics) visible to the reads named */
+inline void memory_barrier(Barrier barriers)
+{
+	gl_exec(glMemoryBarrier, GLbitfield(barriers));
+}
+
+/**
+ * Whether this context can build, feed and dispatch compute programs. The
+ * compute shaders here are #version 430, which the ARB extensions on a 3.3
+ * context do not make compile, so this wants 4.3 as well; glad is generated
+ * for 3.3 and loads the entry points through the extensions.
+ */
+inline bool compute_supported()
+{
+	const bool version = (GLVersion.major > 4) || ((GLVersion.major == 4) && (GLVersion.minor >= 3));
+	return version && GLAD_GL_ARB_compute_shader && GLAD_GL_ARB_shader_storage_buffer_object && GLAD_GL_ARB_shader_image_load_store && GLAD_GL_ARB_program_interface_query;
+}
@@ -1,5 +1,14 @@
 #pragma once
+#include <chrono>
+#include <iterator>
+#include <memory>
 #include <variant>
+#include "jobsystem.h"
+#include "assetstreamer.h"
+#include "uniformring.h"
+#include "compute.h"
+#include "statecache.h"
+#include "uilayer.h"
 
 using Callback = std::variant<GLFWerrorfun, GLFWframebuffersizefun, GLFWkeyfun, GLFWmousebuttonfun, GLFWcursorposfun>;
 
@@ -23,6 +32,28 @@ struct Context
 	NVGcontext *vg;
 	GLFWwindow *window;
 
+	// NanoVG panels kept tessellated between frames, drawn over drawcb's output
+	std::unique_ptr<UILayer> ui;
+
+	// worker threads, plus the queue of jobs that have to run on this (the GL) thread
+	JobSystem jobs;
+
+	// background loads, uploaded a budgeted amount each frame
+	AssetStreamer streaming{jobs};
+
+	// per draw uniform blocks; mutable so drawcb can push into it
+	mutable UniformRing uniforms;
+
+	// whether compute programs can run here (see compute.h)
+	bool hasCompute{false};
+	// whether programs can have tessellation stages, GL 4.0 and up
+	bool hasTessellation{false};
+
+	// finished frames' render stats (see renderstats.h), drawn over the frame while showStats is set
+	RenderStatsOverlay statsOverlay;
+	bool showStats{false};
+	std::chrono::steady_clock::time_point frameStart{};
+
 
 	static void default_error_cb(int error, const char *desc)
 	{
@@ -63,24 +94,38 @@ struct Context
 				   callbackfn);
 	}
 
-	Context(GLuint width, GLuint height, const char *title, bool resizable = false)
+	/**
+	 * Open a window and its GL context
+	 * @param compute Ask for OpenGL 4.3, for compute and tessellation shaders, settling for 3.3 if the driver lacks it; check hasCompute and hasTessellation
+	 */
+	Context(GLuint width, GLuint height, const char *title, bool resizable = false, bool compute = false)
 	{
 		vg = nullptr;
 		this->width = width;
 		this->height = height;
-		std::cout << "Starting GLFW context, OpenGL 3.3" << std::endl;
+		std::cout << "Starting GLFW context, OpenGL " << (compute ? "4.3" : "3.3") << std::endl;
 		// Init GLFW
 		glfwInit();
 		errorcb = default_error_cb;
 		glfwSetErrorCallback(default_error_cb);
 		// Set all the required options for GLFW
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, compute ? 4 : 3);
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 		glfwWindowHint(GLFW_RESIZABLE, resizable ? GL_TRUE : GL_FALSE);
+#ifndef NDEBUG
+		// so KHR_debug reports everything glGetError would, without a round trip per call
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
 		// Create a GLFWwindow object that we can use for GLFW's functions
 		window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+		if ((window == nullptr) && compute)
+		{
+			std::cout << "No OpenGL 4.3, falling back to 3.3" << std::endl;
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+			window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+		}
 		glfwMakeContextCurrent(window);
 		if (window == nullptr)
 		{
@@ -97,6 +142,16 @@ struct Context
 			std::cerr << "Failed to initialize OpenGL context" << std::endl;
 			glfwTerminate();
 		}
+		hasCompute = compute_supported();
+		// the tessellation shaders are #version 400, so the extension alone is not enough
+		hasTessellation = (GLVersion.major >= 4) && GLAD_GL_ARB_tessellation_shader;
+		gl_trace_from_environment();
+#ifndef NDEBUG
+		if (!gl_check_mode(eGL_CHECK_DEBUG_OUTPUT))
+		{
+			std::cout << "No KHR_debug, checking glGetError after every GL call" << std::endl;
+		}
+#endif
 
 		vg = nvgCreateGL3(NVG_ANTIALIAS | NVG_STENCIL_STROKES | NVG_DEBUG);
 		int fontBold = nvgCreateFont(vg, "sans-bold", "./nanovg/example//Roboto-Bold.ttf");
@@ -106,6 +161,8 @@ struct Context
 					  << std::endl;
 			glfwTerminate();
 		}
+		ui = std::make_unique<UILayer>(vg);
+		ui->createFont("sans-bold", "./nanovg/example//Roboto-Bold.ttf");
 		glfwSwapInterval(0);
 	}
 
@@ -137,7 +194,10 @@ struct Context
 		programs.clear();
 		glfwSetKeyCallback(window, nullptr);
 		glfwSetFramebufferSizeCallback(window, nullptr);
+		// the layer's font atlas lives in vg's renderer
+		ui.reset();
 		nvgDeleteGL3(vg);
+		gl_trace_stop();
 		glfwSetErrorCallback(nullptr);
 	}
 
@@ -146,13 +206,132 @@ struct Context
 		return glfwWindowShouldClose(window);
 	}
 
+	// counts of the last finished frame
+	const RenderStats &stats() const
+	{
+		return statsOverlay.latest();
+	}
+
+	// the fixed function state NanoVG sets up for itself and leaves as it likes
+	struct OverlayState
+	{
+		static constexpr GLenum CAPS[] = {GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_SCISSOR_TEST, GL_STENCIL_TEST};
+		static constexpr GLenum STENCIL[] = {GL_STENCIL_FUNC, GL_STENCIL_REF, GL_STENCIL_VALUE_MASK, GL_STENCIL_WRITEMASK,
+		                                     GL_STENCIL_FAIL, GL_STENCIL_PASS_DEPTH_FAIL, GL_STENCIL_PASS_DEPTH_PASS};
+		static constexpr GLenum STENCIL_BACK[] = {GL_STENCIL_BACK_FUNC, GL_STENCIL_BACK_REF, GL_STENCIL_BACK_VALUE_MASK, GL_STENCIL_BACK_WRITEMASK,
+		                                          GL_STENCIL_BACK_FAIL, GL_STENCIL_BACK_PASS_DEPTH_FAIL, GL_STENCIL_BACK_PASS_DEPTH_PASS};
+
+		GLboolean enabled[std::size(CAPS)];
+		GLint cullFace, frontFace;
+		GLint blendSrcRGB, blendDstRGB, blendSrcAlpha, blendDstAlpha;
+		/* per face: func, ref, value mask, write mask, then the three ops */
+		GLint stencil[2][std::size(STENCIL)];
+		GLboolean colourMask[4];
+		/* NanoVG's fragment uniforms go through binding 0, which uniform_block_binding hands out too */
+		GLint uniformBuffer;
+		GLint64 uniformStart, uniformSize;
+
+		void save()
+		{
+			for (size_t i = 0; i < std::size(CAPS); ++i)
+			{
+				enabled[i] = gl_exec(glIsEnabled, CAPS[i]);
+			}
+			gl_exec(glGetIntegerv, GL_CULL_FACE_MODE, &cullFace);
+			gl_exec(glGetIntegerv, GL_FRONT_FACE, &frontFace);
+			gl_exec(glGetIntegerv, GL_BLEND_SRC_RGB, &blendSrcRGB);
+			gl_exec(glGetIntegerv, GL_BLEND_DST_RGB, &blendDstRGB);
+			gl_exec(glGetIntegerv, GL_BLEND_SRC_ALPHA, &blendSrcAlpha);
+			gl_exec(glGetIntegerv, GL_BLEND_DST_ALPHA, &blendDstAlpha);
+			for (size_t i = 0; i < std::size(STENCIL); ++i)
+			{
+				gl_exec(glGetIntegerv, STENCIL[i], &stencil[0][i]);
+				gl_exec(glGetIntegerv, STENCIL_BACK[i], &stencil[1][i]);
+			}
+			gl_exec(glGetBooleanv, GL_COLOR_WRITEMASK, colourMask);
+			gl_exec(glGetIntegeri_v, GL_UNIFORM_BUFFER_BINDING, 0u, &uniformBuffer);
+			gl_exec(glGetInteger64i_v, GL_UNIFORM_BUFFER_START, 0u, &uniformStart);
+			gl_exec(glGetInteger64i_v, GL_UNIFORM_BUFFER_SIZE, 0u, &uniformSize);
+		}
+
+		void restore() const
+		{
+			for (size_t i = 0; i < std::size(CAPS); ++i)
+			{
+				gl_exec(enabled[i] ? glEnable : glDisable, CAPS[i]);
+			}
+			gl_exec(glCullFace, GLenum(cullFace));
+			gl_exec(glFrontFace, GLenum(frontFace));
+			gl_exec(glBlendFuncSeparate, GLenum(blendSrcRGB), GLenum(blendDstRGB), GLenum(blendSrcAlpha), GLenum(blendDstAlpha));
+			const GLenum faces[2] = {GL_FRONT, GL_BACK};
+			for (size_t face = 0; face < 2; ++face)
+			{
+				const GLint *s = stencil[face];
+				gl_exec(glStencilFuncSeparate, faces[face], GLenum(s[0]), s[1], GLuint(s[2]));
+				gl_exec(glStencilMaskSeparate, faces[face], GLuint(s[3]));
+				gl_exec(glStencilOpSeparate, faces[face], GLenum(s[4]), GLenum(s[5]), GLenum(s[6]));
+			}
+			gl_exec(glColorMask, colourMask[0], colourMask[1], colourMask[2], colourMask[3]);
+			// a size of 0 means the whole buffer was bound
+			if (uniformSize > 0)
+				gl_exec(glBindBufferRange, GL_UNIFORM_BUFFER, 0u, GLuint(uniformBuffer), GLintptr(uniformStart), GLsizeiptr(uniformSize));
+			else
+				gl_exec(glBindBufferBase, GL_UNIFORM_BUFFER, 0u, GLuint(uniformBuffer));
+		}
+	};
+
+	// the UI panels and, with showStats, the stats overlay, in one NanoVG frame
+	void drawOverlay()
+	{
+		int winWidth, winHeight, fbWidth, fbHeight;
+		glfwGetWindowSize(window, &winWidth, &winHeight);
+		glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+		OverlayState state;
+		state.save();
+		const float pixelRatio = float(fbWidth) / float(std::max(winWidth, 1));
+		nvgBeginFrame(vg, float(winWidth), float(winHeight), pixelRatio);
+		ui->draw(float(winWidth), float(winHeight), pixelRatio);
+		if (showStats)
+		{
+			statsOverlay.draw(vg, 8.0f, 8.0f);
+		}
+		nvgEndFrame(vg);
+		// NanoVG binds its own textures, so the cache no longer knows what is bound
+		state_cache().invalidate();
+		state.restore();
+	}
+
 	void draw()
 	{
 		// Check if any events have been activated (key pressed, mouse moved etc.) and call corresponding response functions
 		glfwPollEvents();
-		drawcb(*this, 0.0f);
+		const auto now = std::chrono::steady_clock::now();
+		if (frameStart != std::chrono::steady_clock::time_point{})
+		{
+			statsOverlay.push(gl_render_stats(), std::chrono::duration<float, std::milli>(now - frameStart).count());
+		}
+		frameStart = now;
+		gl_render_stats().beginFrame();
+		// finish any GL work handed back by the workers before drawing
+		jobs.pump_main();
+		{
+			GLDebugScope scope("streaming");
+			streaming.update();
+		}
+		uniforms.beginFrame();
+		{
+			GLDebugScope scope("drawcb");
+			drawcb(*this, 0.0f);
+		}
+		uniforms.endFrame();
+		if (showStats || (ui->panelCount() > 0))
+		{
+			GLDebugScope scope("overlay");
+			drawOverlay();
+		}
 		// Swap the screen buffers
 		glfwSwapBuffers(window);
+		gl_end_frame();
 		return;
 	}
 
@@ -0,0 +1,65 @@
+#pragma once
+
+/**
+ * View frustum culling of many objects at once. Bounds are kept structure of
+ * arrays style, one float stream per component, so the SSE2 and AVX2 kernels
+ * test 4 or 8 objects against a plane with each instruction. Each object is
+ * a box and a sphere sharing a centre (see BufferBuilder::boundingSphere);
+ * against each plane the tighter of the two is used.
+ */
+
+#include <vector>
+#include "boundingbox.h"
+
+struct Frustum
+{
+    /* inside is dot(xyz, p) + w >= 0, with xyz normalised; left, right, bottom, top, near, far */
+    Vector4 planes[6];
+
+    /* the planes of a GL style (-1..1 depth) view projection matrix */
+    static Frustum from_matrix(const Matrix4 &viewProjection);
+};
+
+class CullingSet
+{
+public:
+    /* add an object, returning the index cull reports it by */
+    size_t add(const BoundingBox &box, const BoundingSphere &sphere);
+    size_t add(const BoundingBox &box);
+
+    /* move an object, eg. its model's box and sphere transformed to world space */
+    void set(size_t index, const BoundingBox &box, const BoundingSphere &sphere);
+
+    size_t size() const
+    {
+        return mCount;
+    }
+
+    void clear();
+
+    /**
+     * Fill visible with the indices of the objects at least partly inside the
+     * frustum, in ascending order, ready to index the draw list with.
+     * @return number of visible objects
+     */
+    size_t cull(const Frustum &frustum, std::vector<GLuint> &visible) const;
+
+private:
+    /* streams are padded to the widest batch so the kernels never need a tail */
+    static constexpr size_t BATCH = 8;
+
+    enum Stream
+    {
+        eCENTRE_X = 0,
+        eCENTRE_Y,
+        eCENTRE_Z,
+        eEXTENT_X,
+        eEXTENT_Y,
+        eEXTENT_Z,
+        eRADIUS,
+        eSTREAM_COUNT
+    };
+
+    std::vector<GLfloat> mStreams[eSTREAM_COUNT];
+    size_t mCount = 0;
+};
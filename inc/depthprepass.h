@@ -0,0 +1,292 @@
+#pragma once
+
+/**
+ * Draws a frame's opaque DrawCalls in two passes when that pays. The first
+ * pass writes depth only, through a variant of each program with just its
+ * vertex stages (ShaderProgram::depth_only) on the draw's own VAO. The
+ * second draws colour with the depth test at GL_EQUAL, so the fragment
+ * shader runs once per covered pixel however deep the scene is.
+ * Translucent draws go last, back to front, tested against the opaque depth
+ * without writing it.
+ *
+ * The prepass is a second trip through the vertex stages, so in eAUTO it is
+ * only on while the measured overdraw is above a threshold, with some
+ * hysteresis. Overdraw here is opaque fragments passing the depth test per
+ * pixel, counted with a GL_SAMPLES_PASSED query and read a few frames late
+ * so it never stalls.
+ *
+ * Uniforms have to be set again for the depth program, so a draw's bind
+ * runs before each of its draws, with that pass's program in use. Vertex
+ * shaders should declare "invariant gl_Position;", or the two passes may
+ * not agree on depth and GL_EQUAL drops pixels.
+ */
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+class DepthPrepass
+{
+public:
+	enum Mode : GLuint
+	{
+		eAUTO = 0,
+		eALWAYS,
+		eNEVER
+	};
+
+	using Bind = std::function<void(ShaderProgram &program)>;
+
+	/* frames between a query and reading it back */
+	static constexpr GLuint QUERY_FRAMES = 3;
+
+	DepthPrepass() = default;
+	DepthPrepass(const DepthPrepass &other) = delete;
+	DepthPrepass &operator=(const DepthPrepass &other) = delete;
+
+	~DepthPrepass()
+	{
+		for (GLuint query : mQueries)
+		{
+			if (query != 0)
+			{
+				gl_exec(glDeleteQueries, 1, &query);
+			}
+		}
+	}
+
+	void setMode(Mode mode)
+	{
+		mMode = mode;
+	}
+
+	/* overdraw above enableAbove turns the prepass on, and below disableBelow off again */
+	void setThresholds(GLfloat enableAbove, GLfloat disableBelow)
+	{
+		mEnableAbove = enableAbove;
+		mDisableBelow = std::min(disableBelow, enableAbove);
+	}
+
+	/* best queued roughly front to back, which keeps the depth-only pass cheap too */
+	void opaque(DrawCall &call, Bind bind = {}, GLenum mode = GL_TRIANGLES)
+	{
+		mOpaque.push_back(Queued{&call, std::move(bind), mode, 0.0f});
+	}
+
+	/* drawn furthest first, by distance from the eye */
+	void translucent(DrawCall &call, GLfloat distance, Bind bind = {}, GLenum mode = GL_TRIANGLES)
+	{
+		mTranslucent.push_back(Queued{&call, std::move(bind), mode, distance});
+	}
+
+	/**
+	 * Draw and forget everything queued, into the bound framebuffer with its
+	 * depth already cleared.
+	 * @param width, height The framebuffer's size, to measure overdraw against
+	 */
+	void flush(GLsizei width, GLsizei height)
+	{
+		readQueries();
+		const bool prepass = (mMode == eALWAYS) || ((mMode == eAUTO) && mEnabled);
+
+		// whichever pass first tests the opaque draws against depth shades what a single pass would
+		GLuint &query = mQueries[mNextQuery];
+		const bool measure = !mOpaque.empty() && !mPending[mNextQuery];
+		if (measure)
+		{
+			if (query == 0)
+			{
+				gl_exec(glGenQueries, 1, &query);
+			}
+			GLint samples = 0;
+			gl_exec(glGetIntegerv, GL_SAMPLES, &samples);
+			mPixels[mNextQuery] = GLuint64(width) * GLuint64(height) * GLuint64(std::max(samples, 1));
+		}
+
+		const GLboolean depthTest = gl_exec(glIsEnabled, GL_DEPTH_TEST);
+		const GLboolean blend = gl_exec(glIsEnabled, GL_BLEND);
+		gl_exec(glEnable, GL_DEPTH_TEST);
+		gl_exec(glDisable, GL_BLEND);
+		gl_exec(glDepthFunc, GL_LESS);
+		gl_exec(glDepthMask, GL_TRUE);
+
+		if (prepass && !mOpaque.empty())
+		{
+			GLDebugScope scope("depth prepass");
+			gl_exec(glColorMask, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			if (measure)
+				gl_exec(glBeginQuery, GL_SAMPLES_PASSED, query);
+			for (Queued &draw : mOpaque)
+			{
+				run(draw, depthProgram(*draw.call->program));
+			}
+			if (measure)
+				gl_exec(glEndQuery, GL_SAMPLES_PASSED);
+			gl_exec(glColorMask, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			gl_exec(glDepthFunc, GL_EQUAL);
+			gl_exec(glDepthMask, GL_FALSE);
+		}
+
+		{
+			GLDebugScope scope("opaque");
+			// with the depth already laid down the order no longer matters, so save program changes
+			if (prepass)
+			{
+				std::stable_sort(mOpaque.begin(), mOpaque.end(),
+								 [](const Queued &a, const Queued &b) { return a.call->program.get() < b.call->program.get(); });
+			}
+			if (measure && !prepass)
+				gl_exec(glBeginQuery, GL_SAMPLES_PASSED, query);
+			for (Queued &draw : mOpaque)
+			{
+				run(draw, *draw.call->program);
+			}
+			if (measure && !prepass)
+				gl_exec(glEndQuery, GL_SAMPLES_PASSED);
+		}
+
+		if (!mTranslucent.empty())
+		{
+			GLDebugScope scope("translucent");
+			std::stable_sort(mTranslucent.begin(), mTranslucent.end(), [](const Queued &a, const Queued &b) { return a.distance > b.distance; });
+			gl_exec(glDepthFunc, GL_LESS);
+			gl_exec(glDepthMask, GL_FALSE);
+			gl_exec(glEnable, GL_BLEND);
+			gl_exec(glBlendFunc, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			for (Queued &draw : mTranslucent)
+			{
+				run(draw, *draw.call->program);
+			}
+		}
+
+		gl_exec(glDepthFunc, GL_LESS);
+		gl_exec(glDepthMask, GL_TRUE);
+		gl_exec(depthTest ? glEnable : glDisable, GL_DEPTH_TEST);
+		gl_exec(blend ? glEnable : glDisable, GL_BLEND);
+		gl_exec(glUseProgram, 0);
+
+		if (measure)
+		{
+			mPending[mNextQuery] = true;
+			mNextQuery = (mNextQuery + 1) % QUERY_FRAMES;
+		}
+		mOpaque.clear();
+		mTranslucent.clear();
+		// only flushes that used them say anything about which are still wanted; aged while eAUTO has the
+		// prepass off, they would all be compiled again in the middle of the frame that turns it back on
+		if (prepass)
+			releaseVariants();
+	}
+
+	/* whether the last flush ran the prepass */
+	bool prepassEnabled() const
+	{
+		return (mMode == eALWAYS) || ((mMode == eAUTO) && mEnabled);
+	}
+
+	/* smoothed opaque fragments shaded per pixel without a prepass; 0 until the first query comes back */
+	GLfloat overdraw() const
+	{
+		return mOverdraw;
+	}
+
+private:
+	struct Queued
+	{
+		DrawCall *call;
+		Bind bind;
+		GLenum mode;
+		GLfloat distance;
+	};
+
+	struct Variant
+	{
+		std::unique_ptr<ShaderProgram> program;
+		GLuint unusedFlushes = 0;
+	};
+
+	/* prepass flushes a depth program may go unused, its program likely gone, before it is freed */
+	static constexpr GLuint VARIANT_FLUSHES = 60;
+
+	ShaderProgram &depthProgram(ShaderProgram &program)
+	{
+		Variant &variant = mVariants[program.id()];
+		if (!variant.program)
+		{
+			variant.program = program.depth_only();
+		}
+		variant.unusedFlushes = 0;
+		return *variant.program;
+	}
+
+	void releaseVariants()
+	{
+		for (auto it = mVariants.begin(); it != mVariants.end();)
+		{
+			if (++it->second.unusedFlushes > VARIANT_FLUSHES)
+				it = mVariants.erase(it);
+			else
+				++it;
+		}
+	}
+
+	void run(Queued &draw, ShaderProgram &program)
+	{
+		program.use();
+		if (draw.bind)
+		{
+			draw.bind(program);
+		}
+		draw.call->draw(draw.mode);
+	}
+
+	/* fold in whichever earlier queries have finished, without waiting on any */
+	void readQueries()
+	{
+		for (GLuint slot = 0; slot < QUERY_FRAMES; ++slot)
+		{
+			if (!mPending[slot])
+				continue;
+			GLint available = GL_FALSE;
+			gl_exec(glGetQueryObjectiv, mQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+			GLuint passed = 0;
+			gl_exec(glGetQueryObjectuiv, mQueries[slot], GL_QUERY_RESULT, &passed);
+			mPending[slot] = false;
+			const GLfloat overdraw = GLfloat(double(passed) / double(std::max<GLuint64>(mPixels[slot], 1)));
+			mOverdraw = (mOverdraw == 0.0f) ? overdraw : mOverdraw + SMOOTHING * (overdraw - mOverdraw);
+		}
+		if (!mEnabled && (mOverdraw > mEnableAbove))
+		{
+			mEnabled = true;
+		}
+		else if (mEnabled && (mOverdraw < mDisableBelow))
+		{
+			mEnabled = false;
+		}
+	}
+
+	/* weight of each new measurement in the running overdraw */
+	static constexpr GLfloat SMOOTHING = 0.25f;
+
+	Mode mMode = eAUTO;
+	GLfloat mEnableAbove = 2.0f;
+	GLfloat mDisableBelow = 1.5f;
+	bool mEnabled = false;
+	GLfloat mOverdraw = 0.0f;
+
+	std::vector<Queued> mOpaque;
+	std::vector<Queued> mTranslucent;
+	/* by ShaderProgram::id */
+	std::map<GLuint64, Variant> mVariants;
+
+	std::array<GLuint, QUERY_FRAMES> mQueries{};
+	std::array<bool, QUERY_FRAMES> mPending{};
+	/* samples in the framebuffer each query measured */
+	std::array<GLuint64, QUERY_FRAMES> mPixels{};
+	GLuint mNextQuery = 0;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <iostream>
 #include <memory>
+#include <utility>
 
 
 
@@ -10,6 +11,10 @@ struct DrawCall
 	GLuint vaoID;
 	GLuint mSize;
 	GLenum mType;
+	std::shared_ptr<IndexBuffer> indices;
+	/* transform feedback primitives written query, made by the first capture */
+	GLuint queryID = 0;
+	GLuint mCaptured = 0;
 
 	static std::shared_ptr<float[]> glMat4(const Matrix4 &mat4)
 	{
@@ -35,8 +40,25 @@ struct DrawCall
 	DrawCall() = delete;
 	DrawCall(const DrawCall &other) = delete;
 	DrawCall &operator=(const DrawCall &other) = delete;
-	DrawCall(DrawCall &&other) = delete;
-	DrawCall &operator=(DrawCall &&other) = delete;
+
+	/* a moved from draw call owns nothing, and its destructor leaves GL alone */
+	DrawCall(DrawCall &&other) noexcept
+	: program(std::move(other.program)), vaoID(std::exchange(other.vaoID, 0)), mSize(other.mSize), mType(other.mType),
+	  indices(std::move(other.indices)), queryID(std::exchange(other.queryID, 0)), mCaptured(other.mCaptured)
+	{
+	}
+
+	DrawCall &operator=(DrawCall &&other) noexcept
+	{
+		std::swap(program, other.program);
+		std::swap(vaoID, other.vaoID);
+		std::swap(mSize, other.mSize);
+		std::swap(mType, other.mType);
+		std::swap(indices, other.indices);
+		std::swap(queryID, other.queryID);
+		std::swap(mCaptured, other.mCaptured);
+		return *this;
+	}
 
 
 	DrawCall(std::shared_ptr<ShaderProgram> inProgram) : program(inProgram)
@@ -45,14 +67,21 @@ struct DrawCall
 		gl_exec(glGenVertexArrays, 1, &vaoID);
 	}
 
+	/* the VAO keeps the attribute pointing at the buffer, but does not keep the buffer alive */
 	template<typename T>
-	void addBuffer(std::string name, std::shared_ptr< Buffer<T> > buffer)
+	void addBuffer(const std::string &name, Buffer<T> &buffer)
 	{
 		gl_exec(glBindVertexArray, vaoID);
-		buffer->bindAttribute(program, name);
+		buffer.bindAttribute(*program, name);
 	    gl_exec(glBindVertexArray, 0);
 	}
 
+	template<typename T>
+	void addBuffer(const std::string &name, const std::shared_ptr< Buffer<T> > &buffer)
+	{
+		addBuffer(name, *buffer);
+	}
+
 	template<typename T>
 	void addIndexBuffer(std::shared_ptr< Buffer<T> > buffer)
 	{
@@ -61,6 +90,23 @@ struct DrawCall
 		mType = buffer->getType();
 	}
 
+	void addIndexBuffer(std::shared_ptr<IndexBuffer> buffer)
+	{
+		gl_exec(glBindVertexArray, vaoID);
+		buffer->bindIndices();
+		gl_exec(glBindVertexArray, 0);
+		mSize = buffer->getSize();
+		mType = buffer->getType();
+		indices = buffer;
+	}
+
+	/* per draw std140 block: copied into the frame's ring and range bound, in place of an addUniform per value */
+	template<typename Block>
+	void addUniformBlock(UniformRing &ring, const Block &block)
+	{
+		ring.bind(block);
+	}
+
 	template<typename T>
 	void addUniform(std::string uniformName, T &data);
 
@@ -69,7 +115,7 @@ struct DrawCall
 	{
 		GLuint location = program->uniform_location(uniformName);
 	    std::shared_ptr<float[]> m4 = glMat4(data);    
-		glUniformMatrix4fv(location, 1, GL_FALSE, m4.get());
+		gl_exec(glUniformMatrix4fv, location, 1, GL_FALSE, m4.get());
 	}
 
 	template<>
@@ -77,14 +123,14 @@ struct DrawCall
 	{
 		GLuint location = program->uniform_location(uniformName);
 	    std::shared_ptr<float[]> m3 = glMat3(data);    
-		glUniformMatrix3fv(location, 1, GL_FALSE, m3.get());
+		gl_exec(glUniformMatrix3fv, location, 1, GL_FALSE, m3.get());
 	}
 
 	template<>
 	void addUniform(std::string uniformName, GLfloat& v)
 	{
 		GLuint location = program->uniform_location(uniformName);
-	  	glUniform1f(location, v);
+	  	gl_exec(glUniform1f, location, v);
 	}
 
 	template<>
@@ -93,7 +139,7 @@ struct DrawCall
 		static GLfloat v3[3];
 		GLuint location = program->uniform_location(uniformName);
 		storeXYZ(p, v3);
-	  	glUniform3fv(location, 1, v3);
+	  	gl_exec(glUniform3fv, location, 1, v3);
 	}
 
 	template<>
@@ -102,14 +148,14 @@ struct DrawCall
 		static GLfloat v3[3];
 		GLuint location = program->uniform_location(uniformName);
 		storeXYZ(v, v3);
-	  	glUniform3fv(location, 1, v3);
+	  	gl_exec(glUniform3fv, location, 1, v3);
 	}
 
 	template<>
 	void addUniform(std::string uniformName, Vec<GLfloat, 3>& v)
 	{
 		GLuint location = program->uniform_location(uniformName);
-	  	glUniform3fv(location, 1, &v.x);
+	  	gl_exec(glUniform3fv, location, 1, &v.x);
 	}
 
 	template<>
@@ -118,14 +164,14 @@ struct DrawCall
 		static GLfloat v4[4];
 		GLuint location = program->uniform_location(uniformName);
 		storeXYZW(v, v4);
-	  	glUniform4fv(location, 1, v4);
+	  	gl_exec(glUniform4fv, location, 1, v4);
 	}
 
 	template<>
 	void addUniform(std::string uniformName, Vec<GLfloat, 4>& v)
 	{
 		GLuint location = program->uniform_location(uniformName);
-	  	glUniform4fv(location, 1, &v.x);
+	  	gl_exec(glUniform4fv, location, 1, &v.x);
 	}
 
 	template<>
@@ -134,24 +180,105 @@ struct DrawCall
 		static GLfloat v4[4];
 		GLuint location = program->uniform_location(uniformName);
 		storeXYZW(q, v4);
-	  	glUniform4fv(location, 1, v4);
+	  	gl_exec(glUniform4fv, location, 1, v4);
 	}
 
 	void draw(GLenum mode = GL_TRIANGLES)
 	{
 		gl_exec(glBindVertexArray, vaoID);
-		gl_exec(glDrawElements, mode, mSize, mType, (void*) 0);
+		if (indices)
+		{
+			indices->draw(mode);
+		}
+		else
+		{
+			gl_exec(glDrawElements, mode, mSize, mType, (void*) 0);
+		}
+		gl_exec(glBindVertexArray, 0);
+	}
+
+	/* the indices as patches of verticesPerPatch control points, through the program's tessellation stages */
+	void drawPatches(GLint verticesPerPatch)
+	{
+		gl_exec(glPatchParameteri, GL_PATCH_VERTICES, verticesPerPatch);
+		draw(GL_PATCHES);
+	}
+
+	/**
+	 * Run the program's vertex stage once over every vertex, capturing its
+	 * varyings (see ShaderProgram::capture_varyings) into target instead of
+	 * rasterising. Vertices go through as points, so target lines up with
+	 * the inputs and later passes can draw it with the same index buffer.
+	 * @param target Room for one captured element per vertex
+	 * @param vertexCount Vertices to capture, by default as many as target holds
+	 */
+	template<typename T>
+	void capture(Buffer<T> &target, GLsizei vertexCount = -1)
+	{
+		if (vertexCount < 0)
+		{
+			vertexCount = GLsizei(target.getSize());
+		}
+		if (queryID == 0)
+		{
+			gl_exec(glGenQueries, 1, &queryID);
+		}
+		program->use();
+		gl_exec(glBindVertexArray, vaoID);
+		gl_exec(glEnable, GL_RASTERIZER_DISCARD);
+		target.bindFeedback(0);
+		gl_exec(glBeginQuery, GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, queryID);
+		gl_exec(glBeginTransformFeedback, GL_POINTS);
+		gl_exec(glDrawArrays, GL_POINTS, 0, vertexCount);
+		gl_exec(glEndTransformFeedback);
+		gl_exec(glEndQuery, GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+		gl_exec(glBindBufferBase, GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		gl_exec(glDisable, GL_RASTERIZER_DISCARD);
 		gl_exec(glBindVertexArray, 0);
 	}
 
+	template<typename T>
+	void capture(const std::shared_ptr< Buffer<T> > &target, GLsizei vertexCount = -1)
+	{
+		capture(*target, vertexCount);
+	}
+
+	/**
+	 * Primitives written by the last capture; one per vertex, so fewer than
+	 * asked for means target was too small.
+	 * @param wait Block until the GPU has the answer, else return the last one known
+	 */
+	GLuint capturedPrimitives(bool wait = true)
+	{
+		if (queryID != 0)
+		{
+			GLint available = GL_TRUE;
+			if (!wait)
+			{
+				gl_exec(glGetQueryObjectiv, queryID, GL_QUERY_RESULT_AVAILABLE, &available);
+			}
+			if (available)
+			{
+				gl_exec(glGetQueryObjectuiv, queryID, GL_QUERY_RESULT, &mCaptured);
+			}
+		}
+		return mCaptured;
+	}
+
 	~DrawCall()
 	{
+		if (vaoID == 0)
+			return;
 		for(auto& attribute : program->attributes)
 		{
 		   GLint location = program->attribute_location(attribute.name);
 		   gl_exec(glDisableVertexAttribArray, location);
 		}
 		program->unuse();
+		if (queryID != 0)
+		{
+			gl_exec(glDeleteQueries, 1, &queryID);
+		}
 		gl_exec(glDeleteVertexArrays, 1, &vaoID);
 	}
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <utility>
 
 class Framebuffer
 {
@@ -6,21 +7,63 @@ class Framebuffer
 public:
 	Framebuffer()
 	{
-		glGenFramebuffers(1, &fbo);
+		gl_exec(glGenFramebuffers, 1, &fbo);
 	};
 
+	Framebuffer(const Framebuffer &other) = delete;
+	Framebuffer &operator=(const Framebuffer &other) = delete;
+
+	Framebuffer(Framebuffer &&other) noexcept : fbo(std::exchange(other.fbo, 0))
+	{
+	}
+
+	Framebuffer &operator=(Framebuffer &&other) noexcept
+	{
+		std::swap(fbo, other.fbo);
+		return *this;
+	}
+
 	void activate()
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);  
+		gl_exec(glBindFramebuffer, GL_FRAMEBUFFER, fbo);
 	}
 
 	void deactivate()
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);  
+		gl_exec(glBindFramebuffer, GL_FRAMEBUFFER, 0);
+	}
+
+	// level of a 2D texture as attachment (GL_COLOR_ATTACHMENTn, GL_DEPTH_ATTACHMENT or GL_DEPTH_STENCIL_ATTACHMENT), while active
+	void attach(GLenum attachment, GLuint texture, GLint level = 0)
+	{
+		gl_exec(glFramebufferTexture2D, GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, level);
 	}
-	
+
+	// draw into the first count colour attachments, while active
+	void drawBuffers(GLsizei count)
+	{
+		static const GLenum attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3,
+											 GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5, GL_COLOR_ATTACHMENT6, GL_COLOR_ATTACHMENT7};
+		if (count == 0)
+			gl_exec(glDrawBuffer, GL_NONE);
+		else
+			gl_exec(glDrawBuffers, count, attachments);
+	}
+
+	// while active
+	bool complete()
+	{
+		return gl_exec(glCheckFramebufferStatus, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	GLuint getFramebuffer() const
+	{
+		return fbo;
+	}
+
 	~Framebuffer()
 	{
-		glDeleteFramebuffers(1, &fbo);
+		if (fbo != 0)
+			gl_exec(glDeleteFramebuffers, 1, &fbo);
 	}
 };
@@ -1,13 +1,266 @@
+#pragma once
 
-template<typename Function, typename... Args>
-void gl_exec(Function func, Args... args) {
-    func(args...);
-#ifndef NDEBUG    
+/**
+ * Every GL call goes through gl_exec. In debug builds it notes the call in
+ * this thread's GLCallSite and then looks for errors however gl_check_mode
+ * says: glGetError after every call, after every Nth call, after every call
+ * of every Nth frame, or not at all and leave it to a KHR_debug callback.
+ * glGetError is a round trip to the driver, so the last two are the ones to
+ * profile with; on a synchronous debug context the callback runs inside the
+ * offending call, where GLCallSite and GLDebugScope still describe it.
+ */
+
+#include <iostream>
+#include <type_traits>
+#include "gltrace.h"
+#include "renderstats.h"
+
+enum GLCheckMode : GLuint
+{
+    eGL_CHECK_NONE           = 0,
+    /* exact, and slow */
+    eGL_CHECK_EVERY_CALL     = 1,
+    /* an error shows up against the next sampled call, not the one that made it */
+    eGL_CHECK_SAMPLED_CALLS  = 2,
+    /* every call of every Nth frame, so errors that happen every frame are still pinned down */
+    eGL_CHECK_SAMPLED_FRAMES = 3,
+    /* glDebugMessageCallback; needs KHR_debug, and a debug context to say much */
+    eGL_CHECK_DEBUG_OUTPUT   = 4
+};
+
+/* the latest GL call made on this thread */
+struct GLCallSite
+{
+    /* the entry point called */
+    const void *function = nullptr;
+    /* innermost GLDebugScope, if any */
+    const char *label = nullptr;
+    /* calls made on this thread so far */
+    unsigned long long call = 0;
+};
+
+inline GLCallSite &gl_call_site()
+{
+    static thread_local GLCallSite site;
+    return site;
+}
+
+struct GLCheckState
+{
+    GLCheckMode mode = eGL_CHECK_EVERY_CALL;
+    GLuint interval = 1;
+    GLuint frame = 0;
+    /* whether this frame's calls are checked in eGL_CHECK_SAMPLED_FRAMES */
+    bool frameChecked = true;
+};
+
+inline GLCheckState &gl_check_state()
+{
+    static GLCheckState state;
+    return state;
+}
+
+inline void gl_report(const char *what, GLuint code, const GLchar *message = nullptr)
+{
+    const GLCallSite &site = gl_call_site();
+    std::cerr << "GL " << what << " " << code;
+    if (message != nullptr)
+        std::cerr << ": " << message;
+    std::cerr << " (call " << site.call << ", to ";
+    if (const char *name = gl_function_name(site.function))
+        std::cerr << name;
+    else
+        std::cerr << site.function;
+    if (site.label != nullptr)
+        std::cerr << ", in " << site.label;
+    std::cerr << ")" << std::endl;
+}
+
+inline void gl_check_error()
+{
     GLenum err = glGetError();
     if (err != GL_NO_ERROR) 
     {
-       	std::cerr << "GL error " << err << std::endl;
+        gl_report("error", err);
+        __debugbreak();
+    }
+}
+
+inline bool gl_should_check(const GLCallSite &site)
+{
+    const GLCheckState &state = gl_check_state();
+    switch (state.mode)
+    {
+    case eGL_CHECK_EVERY_CALL:
+        return true;
+    case eGL_CHECK_SAMPLED_CALLS:
+        return (site.call % state.interval) == 0;
+    case eGL_CHECK_SAMPLED_FRAMES:
+        return state.frameChecked;
+    default:
+        return false;
+    }
+}
+
+inline void APIENTRY gl_debug_callback(GLenum /*source*/, GLenum type, GLuint id, GLenum severity, GLsizei /*length*/, const GLchar *message, const void * /*userParam*/)
+{
+    const bool error = (type == GL_DEBUG_TYPE_ERROR);
+    gl_report(error ? "error" : "debug message", id, message);
+    if (error || (severity == GL_DEBUG_SEVERITY_HIGH))
+    {
         __debugbreak();
     }
+}
+
+/**
+ * Choose how gl_exec looks for errors; takes effect from the next call
+ * @param interval N, for the sampled modes
+ * @param minSeverity Least severe debug message reported in eGL_CHECK_DEBUG_OUTPUT; the driver drops the rest
+ * @return false if eGL_CHECK_DEBUG_OUTPUT was asked for without KHR_debug, in which case every call is checked
+ */
+inline bool gl_check_mode(GLCheckMode mode, GLuint interval = 1, GLenum minSeverity = GL_DEBUG_SEVERITY_MEDIUM)
+{
+    const bool supported = (mode != eGL_CHECK_DEBUG_OUTPUT) || GLAD_GL_KHR_debug;
+    if (!supported)
+    {
+        mode = eGL_CHECK_EVERY_CALL;
+    }
+    if (GLAD_GL_KHR_debug)
+    {
+        if (mode == eGL_CHECK_DEBUG_OUTPUT)
+        {
+            glEnable(GL_DEBUG_OUTPUT);
+            // called back from inside the guilty call, on its thread
+            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            glDebugMessageCallback(gl_debug_callback, nullptr);
+            glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+            const GLenum severities[] = { GL_DEBUG_SEVERITY_HIGH, GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_NOTIFICATION };
+            for (GLenum severity : severities)
+            {
+                glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, GL_TRUE);
+                if (severity == minSeverity)
+                    break;
+            }
+        }
+        else
+        {
+            glDebugMessageCallback(nullptr, nullptr);
+            glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            glDisable(GL_DEBUG_OUTPUT);
+        }
+    }
+    GLCheckState &state = gl_check_state();
+    state.mode = mode;
+    state.interval = (interval > 0) ? interval : 1;
+    state.frameChecked = true;
+    return supported;
+}
+
+/* once a frame, after the swap; picks out the frames eGL_CHECK_SAMPLED_FRAMES checks */
+inline void gl_end_frame()
+{
+    GLCheckState &state = gl_check_state();
+    ++state.frame;
+    const bool checked = (state.mode != eGL_CHECK_SAMPLED_FRAMES) || ((state.frame % state.interval) == 0);
+    if (checked && !state.frameChecked)
+    {
+        // left over from the frames in between, so not to be pinned on the first call checked
+        for (GLenum err = glGetError(); err != GL_NO_ERROR; err = glGetError())
+        {
+            std::cerr << "GL error " << err << " in an unchecked frame" << std::endl;
+        }
+    }
+    state.frameChecked = checked;
+    if (GLTraceWriter *trace = gl_trace())
+    {
+        if (!trace->endFrame())
+            gl_trace_stop();
+    }
+}
+
+/**
+ * Names the GL calls made while it lives, in error reports and, in
+ * eGL_CHECK_DEBUG_OUTPUT, as a debug group that GL debuggers show too.
+ * label must outlive it.
+ */
+class GLDebugScope
+{
+public:
+    explicit GLDebugScope(const char *label) : mPrevious(gl_call_site().label), mGrouped(false)
+    {
+#ifndef NDEBUG
+        gl_call_site().label = label;
+        mGrouped = GLAD_GL_KHR_debug && (gl_check_state().mode == eGL_CHECK_DEBUG_OUTPUT);
+        if (mGrouped)
+        {
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, label);
+        }
+#endif
+    }
+
+    ~GLDebugScope()
+    {
+        if (mGrouped)
+        {
+            glPopDebugGroup();
+        }
+        gl_call_site().label = mPrevious;
+    }
+
+    GLDebugScope(const GLDebugScope &other) = delete;
+    GLDebugScope &operator=(const GLDebugScope &other) = delete;
+
+private:
+    const char *mPrevious;
+    bool mGrouped;
+};
+
+/* the checks, counts and capture after each call; result is the call's own, as gl_trace_value has it */
+template<typename Function, typename... Args>
+void gl_exec_done(Function func, std::uint64_t result, Args... args)
+{
+#ifndef NDEBUG    
+    if (gl_should_check(gl_call_site()))
+    {
+        gl_check_error();
+    }
+#endif    
+    gl_stats_record(func, args...);
+    if (GLTraceWriter *trace = gl_trace())
+    {
+        trace->record(func, result, args...);
+    }
+}
+
+template<typename Function, typename... Args>
+auto gl_exec(Function func, Args... args) -> decltype(func(args...)) {
+    using Result = decltype(func(args...));
+#ifndef NDEBUG    
+    GLCallSite &site = gl_call_site();
+    site.function = reinterpret_cast<const void*>(func);
+    ++site.call;
 #endif    
+    if constexpr (std::is_void<Result>::value)
+    {
+        func(args...);
+        gl_exec_done(func, 0, args...);
+    }
+    else
+    {
+        Result result = func(args...);
+        gl_exec_done(func, gl_trace_value(result), args...);
+        return result;
+    }
+}
+
+/* wait until the GPU has passed fence, if there is one, then delete it */
+inline void gl_wait_fence(GLsync &fence)
+{
+    if (fence == nullptr)
+        return;
+    GLenum status = gl_exec(glClientWaitSync, fence, GLbitfield(GL_SYNC_FLUSH_COMMANDS_BIT), GLuint64(0));
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = gl_exec(glClientWaitSync, fence, GLbitfield(GL_SYNC_FLUSH_COMMANDS_BIT), GLuint64(1000000));
+    gl_exec(glDeleteSync, fence);
+    fence = nullptr;
 }
\ No newline at end of file
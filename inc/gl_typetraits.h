@@ -118,3 +118,108 @@ struct GL_element_type
     using element = typename GL_type<T>::type;
     using type = element[C];
 };
+
+/**
+ * Compressed vertex attribute formats. Each wraps the raw storage type so
+ * it can be told apart from a plain scalar of the same width.
+ */
+
+/* IEEE 754 binary16, stored as its raw bit pattern */
+struct GLhalfbits
+{
+    GLhalf bits;
+};
+
+/* fixed point value, normalised to [0,1] (unsigned) or [-1,1] (signed) on fetch */
+template <typename T>
+struct GLnorm
+{
+    T value;
+};
+
+/* integer value read by the shader as int/uint instead of being converted to float */
+template <typename T>
+struct GLinteger
+{
+    T value;
+};
+
+/* four signed components packed 10:10:10:2 into one word, x in the low bits */
+struct GLpacked_2_10_10_10
+{
+    GLuint bits;
+};
+
+template <>
+struct GL_type<GL_HALF_FLOAT>
+{
+    using type = GLhalfbits;
+};
+
+template <>
+struct GL_enum<GLhalfbits>
+{
+    static constexpr GLenum value = GL_HALF_FLOAT;
+};
+
+template <>
+struct GL_type<GL_INT_2_10_10_10_REV>
+{
+    using type = GLpacked_2_10_10_10;
+};
+
+template <>
+struct GL_enum<GLpacked_2_10_10_10>
+{
+    static constexpr GLenum value = GL_INT_2_10_10_10_REV;
+};
+
+template <typename T>
+struct GL_enum<GLnorm<T>>
+{
+    static constexpr GLenum value = GL_enum<T>::value;
+};
+
+template <typename T>
+struct GL_enum<GLinteger<T>>
+{
+    static constexpr GLenum value = GL_enum<T>::value;
+};
+
+/**
+ * How a component type is presented to the vertex shader
+ */
+template <typename T>
+struct GL_attribute
+{
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr bool integer = false;
+    /* components the shader sees for an element of the given dimension */
+    static constexpr GLint size(GLint dim) { return dim; }
+};
+
+template <typename T>
+struct GL_attribute<GLnorm<T>>
+{
+    static constexpr GLboolean normalized = GL_TRUE;
+    static constexpr bool integer = false;
+    static constexpr GLint size(GLint dim) { return GL_attribute<T>::size(dim); }
+};
+
+template <typename T>
+struct GL_attribute<GLinteger<T>>
+{
+    static_assert(std::is_integral<T>::value, "Integer attributes need an integral storage type!");
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr bool integer = true;
+    static constexpr GLint size(GLint dim) { return dim; }
+};
+
+template <>
+struct GL_attribute<GLpacked_2_10_10_10>
+{
+    static constexpr GLboolean normalized = GL_FALSE;
+    static constexpr bool integer = false;
+    /* always four components in one word, so the element dimension must be 1 */
+    static constexpr GLint size(GLint dim) { return 4; }
+};
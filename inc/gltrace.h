@@ -0,0 +1,229 @@
+#pragma once
+
+/**
+ * Capture and replay of the GL calls made through gl_exec. While a
+ * GLTraceWriter is installed (gl_trace), each call is written to a compact
+ * binary trace along with the client memory it reads: buffer and texture
+ * data, shader sources, uniform arrays, and the ranges of mapped buffers
+ * flushed with glFlushMappedBufferRange, or the whole mapping at unmap when
+ * it was not mapped for explicit flushes. Frames before the chosen
+ * range keep only the calls that build state, so the trace can set the
+ * scene up without carrying their draws; the range itself is kept whole.
+ * GLTraceReplay plays a trace back (see tools/replay.cpp) timing each call
+ * and frame.
+ *
+ * Replay assumes a fresh context hands out object names in the same order
+ * as the captured one did, as drivers do; any difference is counted. Calls
+ * made around gl_exec, NanoVG's included, are not captured, and fences are
+ * left out.
+ *
+ * FULGUROUS_TRACE=file and optionally FULGUROUS_TRACE_FRAMES=first-last
+ * capture from Context creation without touching the application.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* one argument or result as the trace stores it; pointers by address, floats by their double's bits */
+template <typename T>
+std::uint64_t gl_trace_value(T value)
+{
+    if constexpr (std::is_pointer<T>::value)
+    {
+        return std::uint64_t(reinterpret_cast<std::uintptr_t>(value));
+    }
+    else if constexpr (std::is_floating_point<T>::value)
+    {
+        const double wide = double(value);
+        std::uint64_t bits;
+        std::memcpy(&bits, &wide, sizeof(bits));
+        return bits;
+    }
+    else
+    {
+        return std::uint64_t(std::int64_t(value));
+    }
+}
+
+enum GLTraceArgType : std::uint8_t
+{
+    eTRACE_INTEGER = 0,
+    eTRACE_FLOAT   = 1,
+    eTRACE_POINTER = 2
+};
+
+template <typename T>
+constexpr GLTraceArgType gl_trace_type()
+{
+    return std::is_pointer<T>::value ? eTRACE_POINTER : (std::is_floating_point<T>::value ? eTRACE_FLOAT : eTRACE_INTEGER);
+}
+
+class GLTraceWriter
+{
+public:
+    /**
+     * Start a trace; every call from here on is considered
+     * @param firstFrame First frame kept whole, counting gl_end_frame calls from now
+     * @param lastFrame Last frame kept; the trace closes itself after it
+     */
+    GLTraceWriter(const std::filesystem::path &file, GLuint firstFrame = 0, GLuint lastFrame = ~0u);
+    ~GLTraceWriter();
+
+    GLTraceWriter(const GLTraceWriter &other) = delete;
+    GLTraceWriter &operator=(const GLTraceWriter &other) = delete;
+
+    bool isOpen() const
+    {
+        return mFile.is_open();
+    }
+
+    /* called by gl_exec once func has returned result */
+    template <typename Function, typename... Args>
+    void record(Function func, std::uint64_t result, Args... args)
+    {
+        const std::uint64_t values[] = {gl_trace_value(args)..., 0};
+        const GLTraceArgType types[] = {gl_trace_type<Args>()..., eTRACE_INTEGER};
+        recordCall(reinterpret_cast<const void *>(func), GLuint(sizeof...(Args)), values, types, result);
+    }
+
+    /* called by gl_end_frame; false once past the last frame */
+    bool endFrame();
+
+private:
+    struct Mapping
+    {
+        const GLubyte *data;
+        GLsizeiptr length;
+        /* GL_MAP_FLUSH_EXPLICIT_BIT: only the ranges flushed count as written */
+        bool explicitFlush;
+    };
+
+    void recordCall(const void *function, GLuint argCount, const std::uint64_t *values, const GLTraceArgType *types, std::uint64_t result);
+    void writeVarint(std::uint64_t value);
+    void writeBlob(const void *data, size_t size);
+    void writeMappedWrite(std::uint64_t target, GLintptr offset, const GLubyte *data, GLsizeiptr length);
+    void flush();
+
+    std::ofstream mFile;
+    std::vector<GLubyte> mBuffer;
+    GLuint mFrame;
+    GLuint mFirstFrame;
+    GLuint mLastFrame;
+    /* entry point address to its index in the trace's function table */
+    std::unordered_map<const void *, GLuint> mIndices;
+    std::unordered_set<const void *> mUnknown;
+    /* buffers mapped for writing, by target, to be copied into the trace as they are flushed or unmapped */
+    std::unordered_map<std::uint64_t, Mapping> mMappings;
+};
+
+/* the trace gl_exec writes to, if any */
+inline GLTraceWriter *&gl_trace()
+{
+    static GLTraceWriter *trace = nullptr;
+    return trace;
+}
+
+/* an entry point the trace knows, how its pointer arguments are read, and how to call it back */
+struct GLTraceFunction;
+
+/* install a writer for FULGUROUS_TRACE if it is set */
+void gl_trace_from_environment();
+
+/* close and remove the installed writer */
+void gl_trace_stop();
+
+/* the name of an entry point the trace knows, for error reports; null for any other */
+const char *gl_function_name(const void *function);
+
+class GLTraceReplay
+{
+public:
+    struct CallStats
+    {
+        std::string name;
+        std::uint64_t calls;
+        double seconds;
+    };
+
+    struct FrameStats
+    {
+        GLuint frame;
+        std::uint64_t calls;
+        /* spent issuing the frame's calls */
+        double cpuSeconds;
+        /* until the GPU had finished them too */
+        double wallSeconds;
+    };
+
+    bool open(const std::filesystem::path &file);
+
+    /**
+     * Play the trace against the current context: the setup once, then the
+     * kept frames loops times, timed
+     */
+    void run(GLuint loops = 1);
+
+    const std::vector<FrameStats> &frames() const
+    {
+        return mFrames;
+    }
+
+    /* per entry point, over the timed frames, most expensive first */
+    std::vector<CallStats> calls() const;
+
+    /* objects that came back with a different name than at capture */
+    std::uint64_t nameMismatches() const
+    {
+        return mMismatches;
+    }
+
+private:
+    /* parse the record at offset, and with execute play it, moving offset past it; false if it runs off the end or makes no sense */
+    bool step(size_t &offset, bool execute, bool timed);
+    /* false if the varint runs off the end */
+    bool readVarint(size_t &offset, std::uint64_t &value) const;
+    /* whether length bytes from offset are in the trace */
+    bool fits(size_t offset, size_t length) const
+    {
+        return (offset <= mTrace.size()) && (length <= mTrace.size() - offset);
+    }
+
+    std::vector<GLubyte> mTrace;
+    /* trace function index to the entry point this build knows by that name, or null */
+    std::vector<const GLTraceFunction *> mFunctions;
+    std::vector<std::string> mNames;
+    size_t mFirstRecord = 0;
+    /* where the kept frames start, and where the last of them ends */
+    size_t mKeptStart = 0;
+    size_t mKeptEnd = 0;
+    /* the frame marker step last passed, if it was one */
+    bool mAtMarker = false;
+    GLuint mMarkerFrame = 0;
+    bool mMarkerKept = false;
+    std::vector<FrameStats> mFrames;
+    std::vector<std::uint64_t> mCallCounts;
+    std::vector<double> mCallSeconds;
+    struct Mapped
+    {
+        GLubyte *data;
+        GLsizeiptr length;
+    };
+
+    std::unordered_map<std::uint64_t, Mapped> mMapped;
+    std::vector<GLubyte> mScratch;
+    std::vector<const GLchar *> mStrings;
+    std::vector<GLint> mLengths;
+    std::uint64_t mMismatches = 0;
+    /* names only line up with the capture's on the first pass */
+    bool mCheckNames = true;
+    std::uint64_t mCalls = 0;
+    double mCpuSeconds = 0.0;
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+/**
+ * Immediate mode lines, points and triangles for debug drawing, gizmos and
+ * other shapes that only last a frame. Vertices are appended to CPU side
+ * staging, one list per program and primitive type. flush copies every
+ * list into one streaming vertex buffer and draws each with a single
+ * glDrawArrays, so a frame's worth of debug shapes costs a draw per group
+ * rather than a Buffer and a draw per shape.
+ *
+ * The vertex buffer is persistently mapped where ARB_buffer_storage exists,
+ * split into a segment per flush in flight and fenced like UniformRing.
+ * Elsewhere it is orphaned with glBufferData and refilled on each flush.
+ * Programs read the position and colour through the attribute names given
+ * to the constructor, and have to live until the flush after they were
+ * appended with. Their uniforms are whatever is set on them when flush
+ * runs.
+ *
+ *   batcher.line(program, a, b, ImmediateBatcher::rgba(255, 0, 0));
+ *   batcher.box(program, lower, upper, ImmediateBatcher::rgba(0, 255, 0));
+ *   batcher.flush();
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class ImmediateBatcher
+{
+public:
+    struct Vertex
+    {
+        GLfloat x, y, z;
+        /* RGBA8, red in the lowest byte */
+        GLuint colour;
+    };
+
+    static constexpr GLuint rgba(GLubyte r, GLubyte g, GLubyte b, GLubyte a = 255)
+    {
+        return GLuint(r) | (GLuint(g) << 8) | (GLuint(b) << 16) | (GLuint(a) << 24);
+    }
+
+    explicit ImmediateBatcher(GLsizeiptr bytesPerFlush = 1 << 20, GLuint flushesInFlight = 3, const std::string &positionName = "vVertex",
+                              const std::string &colourName = "vColor");
+    ~ImmediateBatcher();
+
+    ImmediateBatcher(const ImmediateBatcher &other) = delete;
+    ImmediateBatcher &operator=(const ImmediateBatcher &other) = delete;
+
+    /**
+     * Room for count more vertices of mode primitives drawn with program,
+     * to be filled in before the next append or flush.
+     * @param mode GL_POINTS, GL_LINES or GL_TRIANGLES, as strips and fans do not join
+     */
+    Vertex *append(ShaderProgram &program, GLenum mode, GLsizei count)
+    {
+        Group *group = mLast;
+        if ((group == nullptr) || (group->id != program.id()) || (group->mode != mode))
+        {
+            group = &findGroup(program, mode);
+            mLast = group;
+        }
+        group->program = &program;
+        const size_t first = group->vertices.size();
+        group->vertices.resize(first + size_t(count));
+        return &group->vertices[first];
+    }
+
+    void point(ShaderProgram &program, const Point3 &p, GLuint colour)
+    {
+        Vertex *v = append(program, GL_POINTS, 1);
+        v[0] = vertex(p, colour);
+    }
+
+    void line(ShaderProgram &program, const Point3 &a, const Point3 &b, GLuint colour)
+    {
+        Vertex *v = append(program, GL_LINES, 2);
+        v[0] = vertex(a, colour);
+        v[1] = vertex(b, colour);
+    }
+
+    void triangle(ShaderProgram &program, const Point3 &a, const Point3 &b, const Point3 &c, GLuint colour)
+    {
+        Vertex *v = append(program, GL_TRIANGLES, 3);
+        v[0] = vertex(a, colour);
+        v[1] = vertex(b, colour);
+        v[2] = vertex(c, colour);
+    }
+
+    /* the twelve edges of an axis aligned box */
+    void box(ShaderProgram &program, const Point3 &lower, const Point3 &upper, GLuint colour);
+
+    /* a line along each axis through p, reaching size either side */
+    void cross(ShaderProgram &program, const Point3 &p, GLfloat size, GLuint colour);
+
+    /* upload and draw everything appended since the last flush, a draw per group, then empty the staging */
+    void flush();
+
+    /* vertices appended and not yet flushed */
+    size_t pending() const;
+
+    /* draws the last flush made */
+    GLuint groupsDrawn() const
+    {
+        return mGroupsDrawn;
+    }
+
+private:
+    struct Group
+    {
+        /* where the program was at the last append, and its ShaderProgram::id */
+        ShaderProgram *program;
+        GLuint64 id;
+        GLenum mode;
+        std::vector<Vertex> vertices;
+        GLuint unusedFlushes;
+    };
+
+    struct VertexArray
+    {
+        GLuint64 id;
+        GLuint vao;
+        GLuint unusedFlushes;
+    };
+
+    /* flushes a group or vertex array may go unused, its program likely gone, before it is freed */
+    static constexpr GLuint UNUSED_FLUSHES = 60;
+
+    static Vertex vertex(const Point3 &p, GLuint colour)
+    {
+        return Vertex{p.getX(), p.getY(), p.getZ(), colour};
+    }
+
+    Group &findGroup(ShaderProgram &program, GLenum mode);
+    /* the buffer, big enough for size bytes a flush, and mapped unless a trace is running */
+    void reserve(GLsizeiptr size);
+    /* the program's attributes pointed at the buffer */
+    GLuint vertexArray(ShaderProgram &program);
+    void releaseVertexArrays();
+    /* the buffer, its fences and the vertex arrays reading it */
+    void release();
+
+    std::string mPositionName;
+    std::string mColourName;
+    /* in the order they first appeared, kept between flushes so their storage is reused */
+    std::vector<std::unique_ptr<Group>> mGroups;
+    Group *mLast;
+    std::vector<VertexArray> mVertexArrays;
+
+    GLuint mBuffer;
+    GLsizeiptr mSegmentSize;
+    GLuint mSegmentCount;
+    GLuint mSegment;
+    GLubyte *mMapped;
+    std::vector<GLsync> mFences;
+    GLuint mGroupsDrawn;
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+/**
+ * Index buffer whose element type is chosen when it is built, from the
+ * largest index it holds: GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or
+ * GL_UNSIGNED_INT. If 32 bit indices are not allowed, triangle lists with
+ * more than 65536 vertices are split into 16 bit chunks drawn with a base
+ * vertex. Anything that cannot be split that way stays 32 bit.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+class IndexBuffer {
+public:
+	/* a run of triangles drawn with one call */
+	struct Chunk
+	{
+		GLsizei count;
+		/* byte offset into the buffer */
+		GLsizeiptr offset;
+		GLint baseVertex;
+	};
+
+private:
+	GLuint	mBuffer;
+	GLenum	mType;
+	GLsizei mSize;
+	std::vector<Chunk> mChunks;
+
+	template <typename I>
+	static void narrow(std::vector<GLubyte> &bytes, const GLuint *indices, size_t count, GLuint base)
+	{
+		const size_t start = bytes.size();
+		bytes.resize(start + count * sizeof(I));
+		I *dst = reinterpret_cast<I *>(&bytes[start]);
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = I(indices[i] - base);
+	}
+
+	static GLsizei typeSize(GLenum type)
+	{
+		return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+	}
+
+	/* grow each chunk a triangle at a time while its vertex range fits in 16 bits; false if some triangle cannot fit */
+	bool split(std::vector<GLubyte> &bytes, const GLuint *indices, GLsizei count)
+	{
+		if (count % 3 != 0)
+			return false;
+		GLsizei first = 0;
+		while (first < count)
+		{
+			GLuint lo = ~0u, hi = 0;
+			GLsizei last = first;
+			while (last + 3 <= count)
+			{
+				GLuint triangleLo = std::min({indices[last], indices[last + 1], indices[last + 2]});
+				GLuint triangleHi = std::max({indices[last], indices[last + 1], indices[last + 2]});
+				if (std::max(hi, triangleHi) - std::min(lo, triangleLo) > 0xffff)
+					break;
+				lo = std::min(lo, triangleLo);
+				hi = std::max(hi, triangleHi);
+				last += 3;
+			}
+			if (last == first)
+				return false;
+			mChunks.push_back(Chunk{last - first, GLsizeiptr(bytes.size()), GLint(lo)});
+			narrow<GLushort>(bytes, indices + first, last - first, lo);
+			first = last;
+		}
+		return true;
+	}
+
+public:
+
+	/**
+	 * Construct an index buffer of the narrowest type that fits
+	 * @param indices Indices of mode primitives
+	 * @param count Number of indices
+	 * @param maxIndex Largest value in indices
+	 * @param usage Usage hint
+	 * @param allow32Bit Use GL_UNSIGNED_INT for big meshes rather than splitting them
+	 * @param mode The primitives drawn from it; only GL_TRIANGLES can be split
+	 */
+	IndexBuffer(const GLuint *indices,
+				GLsizei count,
+				GLuint maxIndex,
+				GLenum usage,
+				bool allow32Bit = true,
+				GLenum mode = GL_TRIANGLES) : mSize(count)
+	{
+		std::vector<GLubyte> bytes;
+		// 8 bit indices halve the bandwidth again, but some hardware widens them in the driver
+		if (maxIndex <= 0xff)
+		{
+			mType = GL_UNSIGNED_BYTE;
+			narrow<GLubyte>(bytes, indices, count, 0);
+		}
+		else if (maxIndex <= 0xffff)
+		{
+			mType = GL_UNSIGNED_SHORT;
+			narrow<GLushort>(bytes, indices, count, 0);
+		}
+		else if (!allow32Bit && (mode == GL_TRIANGLES) && split(bytes, indices, count))
+		{
+			mType = GL_UNSIGNED_SHORT;
+		}
+		else
+		{
+			// a triangle spanning more than 16 bits of vertices has no chunk to go in
+			mType = GL_UNSIGNED_INT;
+			mChunks.clear();
+			bytes.clear();
+			narrow<GLuint>(bytes, indices, count, 0);
+		}
+
+		gl_exec(glGenBuffers, 1, &mBuffer);
+		gl_exec(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, mBuffer);
+		gl_exec(glBufferData, GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(bytes.size()), bytes.empty() ? nullptr : &bytes[0], usage);
+		gl_exec(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	~IndexBuffer()
+	{
+		if (mBuffer != 0)
+			gl_exec(glDeleteBuffers, 1, &mBuffer);
+	}
+
+	IndexBuffer(const IndexBuffer &other) = delete;
+	IndexBuffer &operator=(const IndexBuffer &other) = delete;
+
+	IndexBuffer(IndexBuffer &&other) noexcept
+	: mBuffer(std::exchange(other.mBuffer, 0)), mType(other.mType), mSize(std::exchange(other.mSize, 0)), mChunks(std::move(other.mChunks))
+	{
+	}
+
+	IndexBuffer &operator=(IndexBuffer &&other) noexcept
+	{
+		std::swap(mBuffer, other.mBuffer);
+		std::swap(mType, other.mType);
+		std::swap(mSize, other.mSize);
+		std::swap(mChunks, other.mChunks);
+		return *this;
+	}
+
+	GLuint getSize() const {
+		return mSize;
+	}
+
+	GLenum getType() const {
+		return mType;
+	}
+
+	const std::vector<Chunk> &getChunks() const {
+		return mChunks;
+	}
+
+	GLsizeiptr byteSize() const {
+		return GLsizeiptr(mSize) * typeSize(mType);
+	}
+
+	void bindIndices()
+	{
+		gl_exec(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, mBuffer);
+	}
+
+	void unbindIndices()
+	{
+		gl_exec(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	/**
+	 * Draw the whole buffer with the type it was built with, one call per chunk
+	 * @param mode Primitive type to draw eg GL_TRIANGLES, which chunks have to be
+	 */
+	void draw(GLenum mode) const
+	{
+		if (mChunks.empty())
+		{
+			gl_exec(glDrawElements, mode, mSize, mType, (void*) 0);
+			return;
+		}
+		// chunks end on whole triangles, and would cut strips, fans and other patch sizes apart
+		assert(mode == GL_TRIANGLES);
+		for (const Chunk &chunk : mChunks)
+		{
+			gl_exec(glDrawElementsBaseVertex, mode, chunk.count, mType, (void*) chunk.offset, chunk.baseVertex);
+		}
+	}
+
+	/* draw as GL_PATCHES of verticesPerPatch control points, for the tessellation stages; never chunked, so build it with mode GL_PATCHES */
+	void drawPatches(GLint verticesPerPatch) const
+	{
+		gl_exec(glPatchParameteri, GL_PATCH_VERTICES, verticesPerPatch);
+		draw(GL_PATCHES);
+	}
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Counts outstanding jobs. Jobs can be made to wait for a counter to reach
+ * zero (see JobSystem::run_after), and any thread can wait on one while
+ * helping to run other jobs.
+ */
+class JobCounter
+{
+    friend class JobSystem;
+
+public:
+    bool done() const
+    {
+        return pending.load() == 0;
+    }
+
+private:
+    std::atomic<int> pending{0};
+    std::mutex mutex;
+    std::vector<std::function<void()>> continuations;
+};
+
+/**
+ * Work stealing job system shared by everything that wants CPU parallelism.
+ * Each worker owns a deque: it pushes and pops at the back, idle workers
+ * steal from the front of the others. Jobs that must touch GL go on a
+ * separate main thread queue, drained by pump_main (Context::draw does this
+ * once a frame).
+ */
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+    using Counter = std::shared_ptr<JobCounter>;
+
+    struct WorkerStats
+    {
+        /* fraction of the time since the last reset spent running jobs */
+        float utilisation;
+        std::uint64_t jobs;
+        std::uint64_t steals;
+    };
+
+    /* workerCount of 0 means one worker per hardware thread, less the main thread */
+    explicit JobSystem(unsigned workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem &other) = delete;
+    JobSystem &operator=(const JobSystem &other) = delete;
+
+    unsigned size() const
+    {
+        return unsigned(workers.size());
+    }
+
+    Counter make_counter() const
+    {
+        return std::make_shared<JobCounter>();
+    }
+
+    /* queue a job on any worker; counter, if given, is held up until it finishes */
+    void run(Job job, const Counter &counter = nullptr);
+
+    /* queue a job once dependency reaches zero */
+    void run_after(const Counter &dependency, Job job, const Counter &counter = nullptr);
+
+    /* queue a job for the main (GL) thread */
+    void run_on_main(Job job, const Counter &counter = nullptr);
+
+    /* run queued main thread jobs on the calling thread, returning how many ran */
+    size_t pump_main(size_t maxJobs = SIZE_MAX);
+
+    /* block until counter reaches zero, running other jobs meanwhile and sleeping when there are none */
+    void wait(const Counter &counter);
+
+    /**
+     * Run body(begin, end) over [0, count) in ranges of grain items and wait
+     * for all of them to finish.
+     */
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body);
+
+    bool is_main_thread() const
+    {
+        return std::this_thread::get_id() == mainThread;
+    }
+
+    std::vector<WorkerStats> stats() const;
+    void reset_stats();
+
+private:
+    struct Task
+    {
+        Job job;
+        Counter counter;
+    };
+
+    struct Worker
+    {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::atomic<std::uint64_t> busyNanoseconds{0};
+        std::atomic<std::uint64_t> jobs{0};
+        std::atomic<std::uint64_t> steals{0};
+    };
+
+    void worker_loop(unsigned index);
+    void schedule(Task task);
+    bool try_run_one(int workerIndex);
+    void execute(Task &task, Worker *worker);
+    void finish(const Counter &counter);
+    static void add(const Counter &counter);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<unsigned> nextWorker{0};
+    std::atomic<size_t> queued{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    std::thread::id mainThread;
+    std::mutex mainMutex;
+    std::deque<Task> mainTasks;
+
+    std::chrono::steady_clock::time_point statsStart;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+/**
+ * A mesh's levels of detail (see meshsimplify.h) as one index buffer per
+ * level, all drawing from the vertex buffers already in the VAO. The level
+ * for a draw is the coarsest whose error covers no more than a pixel budget
+ * once projected to the screen.
+ */
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "meshsimplify.h"
+
+/* pixels per unit at unit distance, for a perspective projection of the given vertical field of view */
+inline GLfloat projection_scale(GLfloat fovY, GLfloat viewportHeight)
+{
+	return viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+}
+
+class LODChain {
+public:
+	struct Level
+	{
+		std::shared_ptr<IndexBuffer> indices;
+		GLfloat error;
+	};
+
+private:
+	std::vector<Level> mLevels;
+
+public:
+	LODChain(const std::vector<LODLevel> &levels, GLenum usage = GL_STATIC_DRAW, bool allow32Bit = true)
+	{
+		for (const LODLevel &level : levels)
+		{
+			GLuint maxIndex = 0;
+			for (GLuint index : level.indices)
+				maxIndex = std::max(maxIndex, index);
+			mLevels.push_back(Level{std::make_shared<IndexBuffer>(level.indices.data(), GLsizei(level.indices.size()), maxIndex, usage, allow32Bit),
+									level.error});
+		}
+	}
+
+	size_t size() const {
+		return mLevels.size();
+	}
+
+	const Level &level(size_t index) const {
+		return mLevels[index];
+	}
+
+	/**
+	 * Coarsest level whose error projects to no more than pixelError pixels
+	 * @param distance From the eye to the nearest point of the object
+	 * @param projectionScale See projection_scale
+	 */
+	size_t select(GLfloat distance, GLfloat projectionScale, GLfloat pixelError = 1.0f) const
+	{
+		distance = std::max(distance, std::numeric_limits<GLfloat>::min());
+		size_t chosen = 0;
+		for (size_t i = 1; i < mLevels.size(); ++i)
+		{
+			if (mLevels[i].error * projectionScale / distance > pixelError)
+				break;
+			chosen = i;
+		}
+		return chosen;
+	}
+
+	/* the same, measured to the surface of the object's world space bounding sphere */
+	size_t select(const BoundingSphere &bounds, const Point3 &eye, GLfloat projectionScale, GLfloat pixelError = 1.0f) const
+	{
+		return select(length(bounds.centre - eye) - bounds.radius, projectionScale, pixelError);
+	}
+
+	/* bind a level's indices into the bound VAO and draw them */
+	void draw(size_t index, GLenum mode = GL_TRIANGLES) const
+	{
+		mLevels[index].indices->bindIndices();
+		mLevels[index].indices->draw(mode);
+	}
+};
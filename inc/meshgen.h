@@ -0,0 +1,279 @@
+#pragma once
+
+/**
+ * Procedural meshes: planes, spheres, boxes and cylinders. Builders are
+ * sized once up front and rows of vertices and triangles are then written
+ * in place, split across the JobSystem when one is given. Each generator
+ * sets the position bounds from its dimensions rather than rescanning.
+ */
+
+#include <cmath>
+#include "jobsystem.h"
+
+struct ProceduralMesh
+{
+	BufferBuilder<Vec<GLfloat, 3>> positions;
+	BufferBuilder<Vec<GLfloat, 3>> normals;
+	BufferBuilder<Vec<GLfloat, 2>> uvs;
+	BufferBuilder<Vec<GLuint, 1>> indices;
+
+	void resize(size_t vertexCount, size_t indexCount)
+	{
+		positions.mBuffer.resize(vertexCount);
+		normals.mBuffer.resize(vertexCount);
+		uvs.mBuffer.resize(vertexCount);
+		indices.mBuffer.resize(indexCount);
+	}
+
+	void setBounds(const Point3 &lower, const Point3 &upper)
+	{
+		positions.mBounds.lower = lower;
+		positions.mBounds.upper = upper;
+	}
+
+	void setVertex(size_t index, const Point3 &position, const Vector3 &normal, GLfloat u, GLfloat v)
+	{
+		positions.mBuffer[index] = {position.getX(), position.getY(), position.getZ()};
+		normals.mBuffer[index] = {normal.getX(), normal.getY(), normal.getZ()};
+		uvs.mBuffer[index] = {u, v};
+	}
+
+	void setTriangle(size_t index, GLuint i0, GLuint i1, GLuint i2)
+	{
+		indices.mBuffer[index] = i0;
+		indices.mBuffer[index + 1] = i1;
+		indices.mBuffer[index + 2] = i2;
+	}
+
+	/* two triangles for the quad a b / c d, alternating the diagonal like a checkerboard */
+	void setQuad(size_t index, GLuint a, GLuint b, GLuint c, GLuint d, bool flip)
+	{
+		if (flip)
+		{
+			setTriangle(index, a, c, b);
+			setTriangle(index + 3, b, c, d);
+		}
+		else
+		{
+			setTriangle(index, a, c, d);
+			setTriangle(index + 3, a, d, b);
+		}
+	}
+};
+
+/* run body(begin, end) over rows, on the job system if there is one, in blocks of roughly 4k vertices */
+inline void for_each_row(JobSystem *jobs, size_t rows, size_t verticesPerRow, const std::function<void(size_t, size_t)> &body)
+{
+	if (jobs == nullptr)
+	{
+		body(0, rows);
+		return;
+	}
+	const size_t grain = std::max<size_t>(1, 4096 / std::max<size_t>(verticesPerRow, 1));
+	jobs->parallel_for(rows, grain, body);
+}
+
+/**
+ * Write a (quadsU + 1) x (quadsV + 1) grid of vertices and its triangles,
+ * starting at firstVertex / firstIndex, for rows [rowBegin, rowEnd).
+ * Position is origin + u * uAxis + v * vAxis for u, v in [0, 1].
+ */
+inline void write_grid_rows(ProceduralMesh &mesh, size_t firstVertex, size_t firstIndex, unsigned quadsU, unsigned quadsV,
+							const Point3 &origin, const Vector3 &uAxis, const Vector3 &vAxis, const Vector3 &normal,
+							size_t rowBegin, size_t rowEnd)
+{
+	const GLuint stride = quadsU + 1;
+	for (size_t row = rowBegin; row < rowEnd; ++row)
+	{
+		const GLfloat v = GLfloat(row) / GLfloat(quadsV);
+		for (unsigned column = 0; column <= quadsU; ++column)
+		{
+			const GLfloat u = GLfloat(column) / GLfloat(quadsU);
+			mesh.setVertex(firstVertex + row * stride + column, origin + uAxis * u + vAxis * v, normal, u, v);
+		}
+		if (row < quadsV)
+		{
+			for (unsigned column = 0; column < quadsU; ++column)
+			{
+				GLuint a = GLuint(firstVertex + row * stride + column);
+				mesh.setQuad(firstIndex + (row * quadsU + column) * 6, a, a + 1, a + stride, a + stride + 1, (row + column) % 2 != 0);
+			}
+		}
+	}
+}
+
+/**
+ * Flat grid on the XZ plane, centred on the origin, facing +Y
+ */
+inline void generate_plane(ProceduralMesh &mesh, GLfloat sizeX, GLfloat sizeZ, unsigned quadsX, unsigned quadsZ, JobSystem *jobs = nullptr)
+{
+	mesh.resize(size_t(quadsX + 1) * (quadsZ + 1), size_t(quadsX) * quadsZ * 6);
+	const Point3 origin(-sizeX / 2.0f, 0.0f, -sizeZ / 2.0f);
+	mesh.setBounds(origin, Point3(sizeX / 2.0f, 0.0f, sizeZ / 2.0f));
+	for_each_row(jobs, quadsZ + 1, quadsX + 1, [&](size_t begin, size_t end) {
+		write_grid_rows(mesh, 0, 0, quadsX, quadsZ, origin, Vector3(sizeX, 0.0f, 0.0f), Vector3(0.0f, 0.0f, sizeZ), Vector3::yAxis(), begin, end);
+	});
+}
+
+/**
+ * Axis aligned box centred on the origin, each face a segments x segments grid
+ */
+inline void generate_box(ProceduralMesh &mesh, const Vector3 &halfExtents, unsigned segments, JobSystem *jobs = nullptr)
+{
+	/* grid triangles face along cross(v, u) */
+	struct Face
+	{
+		Vector3 normal, u, v;
+	};
+	const Face faces[6] = {
+		{Vector3::xAxis(), Vector3::zAxis(), Vector3::yAxis()},
+		{-Vector3::xAxis(), -Vector3::zAxis(), Vector3::yAxis()},
+		{Vector3::yAxis(), Vector3::xAxis(), Vector3::zAxis()},
+		{-Vector3::yAxis(), Vector3::xAxis(), -Vector3::zAxis()},
+		{Vector3::zAxis(), -Vector3::xAxis(), Vector3::yAxis()},
+		{-Vector3::zAxis(), Vector3::xAxis(), Vector3::yAxis()},
+	};
+	const size_t faceVertices = size_t(segments + 1) * (segments + 1);
+	const size_t faceIndices = size_t(segments) * segments * 6;
+	mesh.resize(faceVertices * 6, faceIndices * 6);
+	mesh.setBounds(Point3(-halfExtents), Point3(halfExtents));
+	const size_t rowsPerFace = segments + 1;
+	for_each_row(jobs, rowsPerFace * 6, segments + 1, [&](size_t begin, size_t end) {
+		// ranges may straddle faces, so split them back up
+		while (begin < end)
+		{
+			const size_t f = begin / rowsPerFace;
+			const size_t faceEnd = std::min(end, (f + 1) * rowsPerFace);
+			const Face &face = faces[f];
+			const Vector3 u = mulPerElem(face.u, halfExtents) * 2.0f;
+			const Vector3 v = mulPerElem(face.v, halfExtents) * 2.0f;
+			const Point3 origin = Point3(mulPerElem(face.normal, halfExtents)) - (u + v) * 0.5f;
+			write_grid_rows(mesh, f * faceVertices, f * faceIndices, segments, segments, origin, u, v, face.normal,
+							begin - f * rowsPerFace, faceEnd - f * rowsPerFace);
+			begin = faceEnd;
+		}
+	});
+}
+
+/**
+ * UV sphere centred on the origin. The seam column is duplicated so the
+ * texture wraps, and the pole rows emit one triangle per quad.
+ */
+inline void generate_sphere(ProceduralMesh &mesh, GLfloat radius, unsigned slices, unsigned stacks, JobSystem *jobs = nullptr)
+{
+	slices = std::max(slices, 3u);
+	stacks = std::max(stacks, 2u);
+	const GLuint stride = slices + 1;
+	mesh.resize(size_t(stride) * (stacks + 1), size_t(slices) * (stacks - 1) * 6);
+	mesh.setBounds(Point3(-radius, -radius, -radius), Point3(radius, radius, radius));
+	// the first pole row only has one triangle per quad
+	auto rowIndex = [slices](size_t row) { return row == 0 ? 0 : size_t(slices) * 3 + (row - 1) * slices * 6; };
+	const GLfloat pi = 3.14159265358979f;
+	for_each_row(jobs, stacks + 1, stride, [&](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; ++row)
+		{
+			const GLfloat v = GLfloat(row) / GLfloat(stacks);
+			const GLfloat phi = v * pi;
+			for (unsigned column = 0; column <= slices; ++column)
+			{
+				const GLfloat u = GLfloat(column) / GLfloat(slices);
+				const GLfloat theta = u * 2.0f * pi;
+				const Vector3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), -std::sin(phi) * std::sin(theta));
+				mesh.setVertex(row * stride + column, Point3(normal * radius), normal, u, v);
+			}
+			if (row < stacks)
+			{
+				size_t index = rowIndex(row);
+				for (unsigned column = 0; column < slices; ++column)
+				{
+					GLuint a = GLuint(row * stride + column);
+					GLuint b = a + 1, c = a + stride, d = c + 1;
+					if (row == 0)
+					{
+						mesh.setTriangle(index, a, c, d);
+						index += 3;
+					}
+					else if (row == stacks - 1)
+					{
+						mesh.setTriangle(index, a, c, b);
+						index += 3;
+					}
+					else
+					{
+						mesh.setQuad(index, a, b, c, d, false);
+						index += 6;
+					}
+				}
+			}
+		}
+	});
+}
+
+/**
+ * Cylinder around the Y axis, centred on the origin, with optional end caps
+ */
+inline void generate_cylinder(ProceduralMesh &mesh, GLfloat radius, GLfloat height, unsigned slices, unsigned stacks, bool caps = true, JobSystem *jobs = nullptr)
+{
+	slices = std::max(slices, 3u);
+	stacks = std::max(stacks, 1u);
+	const GLuint stride = slices + 1;
+	const size_t sideVertices = size_t(stride) * (stacks + 1);
+	const size_t sideIndices = size_t(slices) * stacks * 6;
+	// each cap is a centre vertex plus its own ring, so the normals stay flat
+	const size_t capVertices = caps ? size_t(stride + 1) * 2 : 0;
+	const size_t capIndices = caps ? size_t(slices) * 3 * 2 : 0;
+	mesh.resize(sideVertices + capVertices, sideIndices + capIndices);
+	const GLfloat pi = 3.14159265358979f;
+	const GLfloat bottom = -height / 2.0f;
+	mesh.setBounds(Point3(-radius, bottom, -radius), Point3(radius, -bottom, radius));
+
+	for_each_row(jobs, stacks + 1, stride, [&](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; ++row)
+		{
+			const GLfloat v = GLfloat(row) / GLfloat(stacks);
+			for (unsigned column = 0; column <= slices; ++column)
+			{
+				const GLfloat u = GLfloat(column) / GLfloat(slices);
+				const GLfloat theta = u * 2.0f * pi;
+				const Vector3 normal(std::cos(theta), 0.0f, -std::sin(theta));
+				mesh.setVertex(row * stride + column, Point3(normal * radius) + Vector3(0.0f, bottom + v * height, 0.0f), normal, u, v);
+			}
+			if (row < stacks)
+			{
+				for (unsigned column = 0; column < slices; ++column)
+				{
+					// rows run up the side, so swap the quad's corners to keep it facing out
+					GLuint a = GLuint(row * stride + column);
+					mesh.setQuad((row * slices + column) * 6, a, a + stride, a + 1, a + stride + 1, false);
+				}
+			}
+		}
+	});
+
+	if (caps)
+	{
+		for (int cap = 0; cap < 2; ++cap)
+		{
+			const bool top = cap == 1;
+			const GLfloat y = top ? -bottom : bottom;
+			const Vector3 normal = top ? Vector3::yAxis() : -Vector3::yAxis();
+			const GLuint centre = GLuint(sideVertices + cap * (stride + 1));
+			mesh.setVertex(centre, Point3(0.0f, y, 0.0f), normal, 0.5f, 0.5f);
+			for (unsigned column = 0; column <= slices; ++column)
+			{
+				const GLfloat theta = GLfloat(column) / GLfloat(slices) * 2.0f * pi;
+				const GLfloat x = std::cos(theta), z = -std::sin(theta);
+				mesh.setVertex(centre + 1 + column, Point3(x * radius, y, z * radius), normal, 0.5f + x * 0.5f, 0.5f + z * 0.5f);
+			}
+			for (unsigned column = 0; column < slices; ++column)
+			{
+				const size_t index = sideIndices + (cap * slices + column) * 3;
+				const GLuint a = centre + 1 + column;
+				if (top)
+					mesh.setTriangle(index, centre, a, a + 1);
+				else
+					mesh.setTriangle(index, centre, a + 1, a);
+			}
+		}
+	}
+}
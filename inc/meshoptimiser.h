@@ -0,0 +1,127 @@
+#pragma once
+
+/**
+ * Offline mesh optimisation for indexed triangle lists: triangle order for
+ * the post-transform vertex cache (Forsyth) and for overdraw, and vertex
+ * order for fetch locality.
+ */
+
+#include <vector>
+
+/* default FIFO size used to measure cache efficiency */
+static constexpr unsigned DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats
+{
+    /* average cache miss ratio: vertex shader invocations per triangle, 0.5 - 3.0 */
+    float acmr;
+    /* average transform to vertex ratio: invocations per vertex, 1.0 is ideal */
+    float atvr;
+    size_t transforms;
+};
+
+struct MeshOptimiserReport
+{
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+/* simulate a FIFO post-transform cache over a triangle list */
+VertexCacheStats analyse_vertex_cache(const GLuint *indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+/* reorder triangles for vertex cache hits (Tom Forsyth's linear speed algorithm); dst may equal indices */
+void optimise_vertex_cache(GLuint *dst, const GLuint *indices, size_t indexCount, size_t vertexCount);
+
+/**
+ * Reorder cache optimised triangles so clusters facing away from the mesh
+ * centre are drawn first, trading at most threshold times the ACMR for less
+ * overdraw. dst may equal indices.
+ * @param positions xyz floats, positionStride floats apart
+ */
+void optimise_overdraw(GLuint *dst, const GLuint *indices, size_t indexCount, const GLfloat *positions, size_t vertexCount, size_t positionStride, float threshold = 1.05f);
+
+/**
+ * Build a vertex remap table putting vertices in first use order, so fetches
+ * walk memory linearly. Unreferenced vertices go to the end.
+ * @return number of referenced vertices
+ */
+size_t optimise_vertex_fetch_remap(GLuint *remap, const GLuint *indices, size_t indexCount, size_t vertexCount);
+
+/* move each vertex of a builder to remap[old index] */
+template <typename Builder>
+void remap_vertices(Builder &builder, const std::vector<GLuint> &remap)
+{
+    auto &source = builder.mBuffer;
+    std::vector<typename Builder::element_type> remapped(source.size());
+    for (size_t i = 0; i < source.size(); ++i)
+        remapped[remap[i]] = source[i];
+    source.swap(remapped);
+}
+
+template <typename IndexBuilder>
+std::vector<GLuint> read_indices(const IndexBuilder &builder)
+{
+    static_assert(IndexBuilder::element_type::dim == 1, "Index buffers have one component per element!");
+    std::vector<GLuint> result;
+    result.reserve(builder.mBuffer.size());
+    for (const auto &index : builder.mBuffer)
+        result.push_back(GLuint(index.x));
+    return result;
+}
+
+template <typename IndexBuilder>
+void write_indices(IndexBuilder &builder, const std::vector<GLuint> &indices)
+{
+    using element_type = typename IndexBuilder::element_type;
+    using component_type = typename IndexBuilder::component_type;
+    for (size_t i = 0; i < indices.size(); ++i)
+        builder.mBuffer[i] = element_type(component_type(indices[i]));
+}
+
+/* vertex cache reordering only, for any index builder */
+template <typename IndexBuilder>
+MeshOptimiserReport optimise_vertex_cache(IndexBuilder &indexBuilder, size_t vertexCount)
+{
+    std::vector<GLuint> indices = read_indices(indexBuilder);
+    MeshOptimiserReport report;
+    report.before = analyse_vertex_cache(indices.data(), indices.size(), vertexCount);
+    optimise_vertex_cache(indices.data(), indices.data(), indices.size(), vertexCount);
+    report.after = analyse_vertex_cache(indices.data(), indices.size(), vertexCount);
+    write_indices(indexBuilder, indices);
+    return report;
+}
+
+/**
+ * Full optimisation of an indexed mesh: triangles for the vertex cache, then
+ * for overdraw, then every vertex builder reordered for fetch locality.
+ * @param positions Vec<GLfloat, 3> builder used for the overdraw ordering
+ * @param vertices Any other per-vertex builders, remapped with the positions
+ */
+template <typename IndexBuilder, typename PositionBuilder, typename... VertexBuilders>
+MeshOptimiserReport optimise_mesh(IndexBuilder &indexBuilder, PositionBuilder &positions, VertexBuilders &... vertices)
+{
+    static_assert(std::is_same<typename PositionBuilder::component_type, GLfloat>::value && PositionBuilder::element_type::dim == 3,
+                  "Positions must be three floats per vertex!");
+    const size_t vertexCount = positions.mBuffer.size();
+    std::vector<GLuint> indices = read_indices(indexBuilder);
+    MeshOptimiserReport report;
+    report.before = analyse_vertex_cache(indices.data(), indices.size(), vertexCount);
+    if (indices.empty() || vertexCount == 0)
+    {
+        report.after = report.before;
+        return report;
+    }
+    optimise_vertex_cache(indices.data(), indices.data(), indices.size(), vertexCount);
+    optimise_overdraw(indices.data(), indices.data(), indices.size(), &positions.mBuffer[0].x, vertexCount, 3);
+
+    std::vector<GLuint> remap(vertexCount);
+    optimise_vertex_fetch_remap(remap.data(), indices.data(), indices.size(), vertexCount);
+    for (GLuint &index : indices)
+        index = remap[index];
+    remap_vertices(positions, remap);
+    (remap_vertices(vertices, remap), ...);
+
+    report.after = analyse_vertex_cache(indices.data(), indices.size(), vertexCount);
+    write_indices(indexBuilder, indices);
+    return report;
+}
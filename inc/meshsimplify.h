@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+ * Level of detail by quadric error simplification (Garland & Heckbert).
+ * Edges collapse onto one of their existing vertices, cheapest first, so
+ * every level indexes the same vertex buffer and only the index buffer
+ * changes with distance. Open edges slide only along themselves, and
+ * vertices on UV or normal seams stay put, so outlines and texturing hold.
+ * LODChain (lodchain.h) uploads the levels and picks one per draw.
+ */
+
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "meshoptimiser.h"
+
+/**
+ * Simplify a triangle list towards a target size
+ * @param dst Room for indexCount indices; may equal indices
+ * @param positions xyz floats, positionStride floats apart
+ * @param targetIndexCount Stop once the list is no longer than this
+ * @param maxError Stop before any collapse that would move the surface further than this, in position units
+ * @param resultError If not null, set to the largest error of the collapses made
+ * @return number of indices written
+ */
+size_t simplify_mesh(GLuint *dst, const GLuint *indices, size_t indexCount, const GLfloat *positions, size_t vertexCount, size_t positionStride,
+                     size_t targetIndexCount, GLfloat maxError = std::numeric_limits<GLfloat>::max(), GLfloat *resultError = nullptr);
+
+struct LODLevel
+{
+    std::vector<GLuint> indices;
+    /* how far this level may be from the full mesh, in position units */
+    GLfloat error;
+};
+
+/**
+ * Level 0 is the mesh as given; each level after it aims for ratio times its
+ * predecessor's triangles. The chain ends early once a level will not shrink
+ * by at least a tenth, or would pass maxError.
+ */
+std::vector<LODLevel> build_lod_chain(const GLuint *indices, size_t indexCount, const GLfloat *positions, size_t vertexCount, size_t positionStride,
+                                      size_t maxLevels = 5, GLfloat ratio = 0.5f, GLfloat maxError = std::numeric_limits<GLfloat>::max());
+
+/* the same from a mesh's index and Vec<GLfloat, 3> position builders */
+template <typename IndexBuilder, typename PositionBuilder>
+std::vector<LODLevel> build_lod_chain(const IndexBuilder &indexBuilder, const PositionBuilder &positions, size_t maxLevels = 5, GLfloat ratio = 0.5f,
+                                      GLfloat maxError = std::numeric_limits<GLfloat>::max())
+{
+    static_assert(std::is_same<typename PositionBuilder::component_type, GLfloat>::value && PositionBuilder::element_type::dim == 3,
+                  "Positions must be three floats per vertex!");
+    std::vector<GLuint> indices = read_indices(indexBuilder);
+    if (indices.empty() || positions.mBuffer.empty())
+        return {LODLevel{std::move(indices), 0.0f}};
+    return build_lod_chain(indices.data(), indices.size(), &positions.mBuffer[0].x, positions.mBuffer.size(), 3, maxLevels, ratio, maxError);
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+/**
+ * A frame's passes, each declaring the textures it reads and the ones it
+ * draws into, compiled before they run: ordered so every texture is
+ * written before it is read and read before it is overwritten, culled of
+ * passes that nothing kept depends on, and with transient textures whose
+ * lifetimes do not overlap put on the same GL texture. Framebuffers, and
+ * the textures behind transients, are pooled across frames, so declaring
+ * the graph again every frame costs no GL objects once it settles.
+ *
+ * Writing a resource gives a new version of it, which later passes read;
+ * a pass that writes the backbuffer or an imported texture is always kept.
+ *
+ *   RenderGraph::Resource colour, depth;
+ *   graph.addPass("scene", [&](RenderGraph::Builder &pass) {
+ *       colour = pass.write(pass.create("colour", {w, h, GL_RGBA16F}), true);
+ *       depth = pass.write(pass.create("depth", {w, h, GL_DEPTH_COMPONENT24}), true);
+ *   }, [&](const RenderGraph &graph) { ... });
+ *   graph.addPass("present", [&](RenderGraph::Builder &pass) {
+ *       pass.read(colour);
+ *       pass.write(graph.backbuffer(w, h));
+ *   }, [&](const RenderGraph &graph) { graph.texture(colour).bind(0); ... });
+ *   graph.compile();
+ *   graph.execute();
+ *   graph.reset();
+ */
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include "framebuffer.h"
+
+class RenderGraph
+{
+public:
+    /* a version of a texture */
+    using Resource = GLuint;
+    static constexpr Resource NONE = ~0u;
+
+    struct TextureDesc
+    {
+        GLsizei width;
+        GLsizei height;
+        GLenum internalFormat;
+    };
+
+    using Execute = std::function<void(const RenderGraph &graph)>;
+
+    /* what addPass's setup declares the pass's resources through */
+    class Builder
+    {
+    public:
+        /* a texture that lives only as long as the passes using it */
+        Resource create(const char *name, const TextureDesc &desc);
+        /* sampled by the pass */
+        Resource read(Resource resource);
+        /**
+         * Drawn into, as the next colour attachment or, for a depth format,
+         * the depth attachment. Unless cleared, what was there is kept, so
+         * the pass depends on it.
+         * @return the version the pass leaves, for later passes to use
+         */
+        Resource write(Resource resource, bool clear = false);
+        /* run the pass even if nothing uses what it writes */
+        void keep();
+
+    private:
+        friend class RenderGraph;
+        Builder(RenderGraph &graph, GLuint pass) : mGraph(graph), mPass(pass)
+        {
+        }
+
+        RenderGraph &mGraph;
+        GLuint mPass;
+    };
+
+    RenderGraph() = default;
+    ~RenderGraph() = default;
+
+    RenderGraph(const RenderGraph &other) = delete;
+    RenderGraph &operator=(const RenderGraph &other) = delete;
+
+    /* the default framebuffer, this size */
+    Resource backbuffer(GLsizei width, GLsizei height);
+    /* a texture owned elsewhere */
+    Resource import(const char *name, const Texture &texture);
+
+    void addPass(const char *name, const std::function<void(Builder &pass)> &setup, Execute execute);
+
+    void compile();
+    /* run the compiled passes, each with its framebuffer bound, viewport set and attachments cleared as asked */
+    void execute();
+    /* forget this frame's passes and resources; pooled textures unused for a few frames are freed */
+    void reset();
+
+    /* the texture behind a resource, once compiled; not the backbuffer's */
+    const Texture &texture(Resource resource) const;
+
+    /* the passes that will run, in order */
+    std::vector<const char *> order() const;
+
+    GLuint culledPasses() const
+    {
+        return mCulled;
+    }
+
+    /* transient textures declared this frame, and the GL textures they were put on */
+    GLuint transientCount() const
+    {
+        return mTransients;
+    }
+
+    GLuint physicalCount() const
+    {
+        return mPhysical;
+    }
+
+    /* render target memory the aliasing saved this frame */
+    size_t savedBytes() const
+    {
+        return mSavedBytes;
+    }
+
+private:
+    struct Attachment
+    {
+        /* the version drawn over, and the one the pass leaves */
+        Resource input;
+        Resource output;
+        bool clear;
+    };
+
+    struct Pass
+    {
+        const char *name;
+        Execute execute;
+        std::vector<Resource> reads;
+        std::vector<Attachment> writes;
+        bool keep = false;
+        bool culled = false;
+        /* versions written that something still uses, while culling */
+        GLuint refs = 0;
+    };
+
+    struct Entry
+    {
+        const char *name;
+        TextureDesc desc;
+        /* set for imports */
+        const Texture *imported = nullptr;
+        bool backbuffer = false;
+        /* the newest version, which the next write takes over */
+        Resource latest = NONE;
+        /* where the compiled order first and last uses it */
+        GLuint firstUse = NONE;
+        GLuint lastUse = 0;
+        /* index into mPool, for transients */
+        GLuint physical = NONE;
+    };
+
+    struct Version
+    {
+        GLuint entry;
+        GLuint producer = NONE;
+        /* the pass that writes this version into the next, if any */
+        GLuint overwriter = NONE;
+        std::vector<GLuint> readers;
+        /* readers, and an overwriter that keeps the contents, still running, while culling */
+        GLuint refs = 0;
+    };
+
+    struct Pooled
+    {
+        TextureDesc desc;
+        std::unique_ptr<Texture> texture;
+        bool inUse = false;
+        GLuint unusedFrames = 0;
+    };
+
+    Resource addVersion(GLuint entry, GLuint producer);
+    /* warn, as a pass declares a read or write of entry, if it both samples and draws into it */
+    void checkFeedback(GLuint pass, GLuint entry, bool reading) const;
+    void cull();
+    void sort();
+    void allocate();
+    Framebuffer &framebuffer(const std::vector<GLuint> &colour, GLuint depth, GLenum depthAttachment);
+
+    std::vector<Pass> mPasses;
+    std::vector<Entry> mEntries;
+    std::vector<Version> mVersions;
+    std::vector<GLuint> mOrder;
+    std::vector<Pooled> mPool;
+    /* by colour attachment textures then depth texture */
+    std::map<std::vector<GLuint>, std::unique_ptr<Framebuffer>> mFramebuffers;
+    GLuint mCulled = 0;
+    GLuint mTransients = 0;
+    GLuint mPhysical = 0;
+    size_t mSavedBytes = 0;
+};
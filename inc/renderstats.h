@@ -0,0 +1,248 @@
+#pragma once
+
+/**
+ * Counters of what each frame asks of GL. gl_exec keeps them from the calls
+ * it makes, so they cover everything the library draws but nothing NanoVG
+ * does. Context::draw starts every frame's counts afresh and hands the
+ * finished frame to its RenderStatsOverlay, which Context::stats reads and
+ * which draws them, with rolling graphs, when Context::showStats is set.
+ */
+
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+struct NVGcontext;
+
+struct RenderStats
+{
+    std::uint64_t drawCalls = 0;
+    /* of drawCalls, the instanced ones */
+    std::uint64_t instancedDraws = 0;
+    /* as submitted, over every instance; patches are not counted */
+    std::uint64_t triangles = 0;
+    std::uint64_t dispatches = 0;
+    std::uint64_t programBinds = 0;
+    std::uint64_t vertexArrayBinds = 0;
+    /* glBindBuffer, glBindBufferBase and glBindBufferRange */
+    std::uint64_t bufferBinds = 0;
+    /* glUniform calls and uniform ring pushes */
+    std::uint64_t uniformUploads = 0;
+    /* buffer data, uniform values and streamed assets; texture pixels are not counted */
+    std::uint64_t bytesUploaded = 0;
+    /* these two carry on from frame to frame */
+    std::int64_t buffersAlive = 0;
+    std::int64_t programsAlive = 0;
+
+    /* zero the per frame counts */
+    void beginFrame()
+    {
+        const std::int64_t buffers = buffersAlive;
+        const std::int64_t programs = programsAlive;
+        *this = RenderStats();
+        buffersAlive = buffers;
+        programsAlive = programs;
+    }
+};
+
+/* the frame being counted */
+inline RenderStats &gl_render_stats()
+{
+    static RenderStats stats;
+    return stats;
+}
+
+inline std::uint64_t gl_triangle_count(GLenum mode, std::int64_t count)
+{
+    switch (mode)
+    {
+    case GL_TRIANGLES:
+        return std::uint64_t(count / 3);
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+        return (count > 2) ? std::uint64_t(count - 2) : 0;
+    case GL_TRIANGLES_ADJACENCY:
+        return std::uint64_t(count / 6);
+    case GL_TRIANGLE_STRIP_ADJACENCY:
+        return (count > 4) ? std::uint64_t((count - 4) / 2) : 0;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Count a call gl_exec made. Entry points are told apart by type first, so
+ * a call no counter cares about costs nothing, and by address only among
+ * those sharing a type.
+ */
+template <typename Function, typename... Args>
+void gl_stats_record(Function func, Args... args)
+{
+    RenderStats &stats = gl_render_stats();
+    const std::tuple<Args...> values(args...);
+    if constexpr (std::is_same<Function, PFNGLDRAWARRAYSPROC>::value)
+    {
+        if (func == glad_glDrawArrays)
+        {
+            stats.drawCalls++;
+            stats.triangles += gl_triangle_count(GLenum(std::get<0>(values)), std::int64_t(std::get<2>(values)));
+        }
+    }
+    else if constexpr (std::is_same<Function, PFNGLDRAWELEMENTSPROC>::value)
+    {
+        if (func == glad_glDrawElements)
+        {
+            stats.drawCalls++;
+            stats.triangles += gl_triangle_count(GLenum(std::get<0>(values)), std::int64_t(std::get<1>(values)));
+        }
+    }
+    else if constexpr (std::is_same<Function, PFNGLDRAWELEMENTSBASEVERTEXPROC>::value)
+    {
+        if (func == glad_glDrawElementsBaseVertex)
+        {
+            stats.drawCalls++;
+            stats.triangles += gl_triangle_count(GLenum(std::get<0>(values)), std::int64_t(std::get<1>(values)));
+        }
+    }
+    else if constexpr (std::is_same<Function, PFNGLDRAWARRAYSINSTANCEDPROC>::value)
+    {
+        if (func == glad_glDrawArraysInstanced)
+        {
+            stats.drawCalls++;
+            stats.instancedDraws++;
+            stats.triangles += gl_triangle_count(GLenum(std::get<0>(values)), std::int64_t(std::get<2>(values))) * std::uint64_t(std::get<3>(values));
+        }
+    }
+    else if constexpr (std::is_same<Function, PFNGLDRAWELEMENTSINSTANCEDPROC>::value)
+    {
+        if (func == glad_glDrawElementsInstanced)
+        {
+            stats.drawCalls++;
+            stats.instancedDraws++;
+            stats.triangles += gl_triangle_count(GLenum(std::get<0>(values)), std::int64_t(std::get<1>(values))) * std::uint64_t(std::get<4>(values));
+        }
+    }
+    else if constexpr (std::is_same<Function, PFNGLDISPATCHCOMPUTEPROC>::value)
+    {
+        if (func == glad_glDispatchCompute)
+            stats.dispatches++;
+    }
+    else if constexpr (std::is_same<Function, PFNGLUSEPROGRAMPROC>::value)
+    {
+        // glBindVertexArray and glDeleteProgram share the type
+        if (func == glad_glUseProgram)
+            stats.programBinds++;
+        else if (func == glad_glBindVertexArray)
+            stats.vertexArrayBinds++;
+        else if (func == glad_glDeleteProgram)
+            stats.programsAlive--;
+    }
+    else if constexpr (std::is_same<Function, PFNGLCREATEPROGRAMPROC>::value)
+    {
+        if (func == glad_glCreateProgram)
+            stats.programsAlive++;
+    }
+    else if constexpr (std::is_same<Function, PFNGLBINDBUFFERPROC>::value)
+    {
+        if (func == glad_glBindBuffer)
+            stats.bufferBinds++;
+    }
+    else if constexpr (std::is_same<Function, PFNGLBINDBUFFERBASEPROC>::value)
+    {
+        if (func == glad_glBindBufferBase)
+            stats.bufferBinds++;
+    }
+    else if constexpr (std::is_same<Function, PFNGLBINDBUFFERRANGEPROC>::value)
+    {
+        if (func == glad_glBindBufferRange)
+            stats.bufferBinds++;
+    }
+    else if constexpr (std::is_same<Function, PFNGLGENBUFFERSPROC>::value)
+    {
+        if (func == glad_glGenBuffers)
+            stats.buffersAlive += std::int64_t(std::get<0>(values));
+    }
+    else if constexpr (std::is_same<Function, PFNGLDELETEBUFFERSPROC>::value)
+    {
+        if (func == glad_glDeleteBuffers)
+            stats.buffersAlive -= std::int64_t(std::get<0>(values));
+    }
+    else if constexpr (std::is_same<Function, PFNGLBUFFERDATAPROC>::value)
+    {
+        // a null pointer only sizes the store
+        if ((func == glad_glBufferData) && (std::get<2>(values) != nullptr))
+            stats.bytesUploaded += std::uint64_t(std::get<1>(values));
+    }
+    else if constexpr (std::is_same<Function, PFNGLBUFFERSUBDATAPROC>::value)
+    {
+        if (func == glad_glBufferSubData)
+            stats.bytesUploaded += std::uint64_t(std::get<2>(values));
+    }
+    else if constexpr (std::is_same<Function, PFNGLUNIFORM1FPROC>::value)
+    {
+        if (func == glad_glUniform1f)
+        {
+            stats.uniformUploads++;
+            stats.bytesUploaded += 4;
+        }
+    }
+    else if constexpr (std::is_same<Function, PFNGLUNIFORM1IPROC>::value)
+    {
+        if (func == glad_glUniform1i)
+        {
+            stats.uniformUploads++;
+            stats.bytesUploaded += 4;
+        }
+    }
+    else if constexpr (std::is_same<Function, PFNGLUNIFORM3FVPROC>::value)
+    {
+        // glUniform4fv too, and the other vector forms
+        const std::uint64_t count = std::uint64_t(std::get<1>(values));
+        stats.uniformUploads++;
+        stats.bytesUploaded += count * ((func == glad_glUniform4fv) ? 16 : (func == glad_glUniform3fv) ? 12 : (func == glad_glUniform2fv) ? 8 : 4);
+    }
+    else if constexpr (std::is_same<Function, PFNGLUNIFORMMATRIX4FVPROC>::value)
+    {
+        const std::uint64_t count = std::uint64_t(std::get<1>(values));
+        stats.uniformUploads++;
+        stats.bytesUploaded += count * ((func == glad_glUniformMatrix4fv) ? 64 : (func == glad_glUniformMatrix3fv) ? 36 : 16);
+    }
+}
+
+/**
+ * The last frames' stats, and a panel showing the latest with graphs of
+ * frame time, draw calls and bytes uploaded across the rest
+ */
+class RenderStatsOverlay
+{
+public:
+    static constexpr size_t HISTORY = 120;
+
+    /* a finished frame and how long it took, start to start */
+    void push(const RenderStats &stats, float frameMilliseconds);
+
+    const RenderStats &latest() const
+    {
+        return mStats[(mNext + HISTORY - 1) % HISTORY];
+    }
+
+    float latestMilliseconds() const
+    {
+        return mMilliseconds[(mNext + HISTORY - 1) % HISTORY];
+    }
+
+    /* between nvgBeginFrame and nvgEndFrame, with the "sans-bold" font Context loads; x, y is the top left */
+    void draw(NVGcontext *vg, float x, float y) const;
+
+private:
+    /* one graph of value(stats, milliseconds) over the history, scaled to its peak */
+    template <typename Value>
+    void drawGraph(NVGcontext *vg, float x, float y, const char *label, const char *unit, Value value) const;
+
+    std::array<RenderStats, HISTORY> mStats{};
+    std::array<float, HISTORY> mMilliseconds{};
+    /* where the next frame goes */
+    size_t mNext = 0;
+    size_t mCount = 0;
+};
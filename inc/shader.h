@@ -6,7 +6,12 @@ enum ShaderKind : GLuint
     eVERTEX_SHADER  =  0,
     eFRAGMENT_SHADER = 1,
     eGEOMETRY_SHADER = 2,
-    eSHADER_COUNT    = 3  
+    /* GL 4.3 or ARB_compute_shader; links alone */
+    eCOMPUTE_SHADER  = 3,
+    /* GL 4.0 or ARB_tessellation_shader; draw with GL_PATCHES */
+    eTESS_CONTROL_SHADER    = 4,
+    eTESS_EVALUATION_SHADER = 5,
+    eSHADER_COUNT    = 6  
 };
 
 class Shader
@@ -20,6 +25,6 @@ public:
     bool verify();
 protected:
     ShaderKind kind;
-    const GLuint glShaderConstants[ShaderKind::eSHADER_COUNT] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+    const GLuint glShaderConstants[ShaderKind::eSHADER_COUNT] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER, GL_COMPUTE_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER };
 
 };
\ No newline at end of file
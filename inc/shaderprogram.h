@@ -9,9 +9,38 @@ public:
         GLuint location;
         std::string name;
     };
+    struct UniformBlock
+    {
+        struct Member
+        {
+            std::string name;
+            GLint offset;
+        };
+        std::string name;
+        GLuint index;
+        GLint dataSize;
+        GLuint binding;
+        std::vector<Member> members;
+
+        /* byte offset of a member, by its plain or block qualified name, or -1 */
+        GLint member_offset(const std::string& memberName) const;
+    };
+    struct StorageBlock
+    {
+        std::string name;
+        GLuint index;
+        GLuint binding;
+    };
     ShaderProgram(); 
     ~ShaderProgram();
 
+    ShaderProgram(const ShaderProgram& other) = delete;
+    ShaderProgram& operator=(const ShaderProgram& other) = delete;
+
+    /* a moved from program owns nothing, and has an id of its own */
+    ShaderProgram(ShaderProgram&& other) noexcept;
+    ShaderProgram& operator=(ShaderProgram&& other) noexcept;
+
     void use();    
     void unuse();
 
@@ -20,19 +49,67 @@ public:
 
     void compile(ShaderKind kind);
 
+    /**
+     * Capture these vertex shader outputs into transform feedback buffers;
+     * call before link. A program that captures may leave out its fragment shader.
+     * @param bufferMode GL_INTERLEAVED_ATTRIBS for one buffer, GL_SEPARATE_ATTRIBS for one each
+     */
+    void capture_varyings(const std::vector<std::string>& names, GLenum bufferMode = GL_INTERLEAVED_ATTRIBS);
+
     void link();
 
+    /**
+     * A program with this one's vertex, tessellation and geometry stages and
+     * an empty fragment shader, for passes that only write depth. Attributes
+     * are bound to this program's locations, so it draws from the same
+     * vertex arrays; call after link.
+     */
+    std::unique_ptr<ShaderProgram> depth_only() const;
+
+    /* run a compute program over x * y * z work groups */
+    void dispatch(GLuint x, GLuint y = 1, GLuint z = 1);
+    /* enough work groups to cover x * y * z invocations; the shader skips any past the end */
+    void dispatch_invocations(GLuint x, GLuint y = 1, GLuint z = 1);
+
     GLint attribute_location(const std::string& name);
     GLint uniform_location(const std::string& name);
+    const UniformBlock* uniform_block(const std::string& name) const;
+    const StorageBlock* storage_block(const std::string& name) const;
+
+    /* unlike GL's program names this is never reused, so caches of per program objects can key on it */
+    GLuint64 id() const
+    {
+        return program_id;
+    }
     
     std::vector<ShaderParameter> uniforms;
     std::vector<ShaderParameter> attributes;
+    std::vector<UniformBlock> uniform_blocks;
+    std::vector<StorageBlock> storage_blocks;
+    /* local_size_x/y/z of a compute program */
+    GLint work_group_size[3];
     
 private:
 
+    void swap(ShaderProgram& other) noexcept;
     void gather_attributes();
     void gather_uniforms();
+    void gather_uniform_blocks();
+    void gather_storage_blocks();
 
     GLuint shaders[eSHADER_COUNT];
+    /* kept for depth_only, as the shaders go once linked */
+    std::string sources[eSHADER_COUNT];
     GLuint program;
-};
\ No newline at end of file
+    GLuint64 program_id;
+    /* locations to bind attributes to before linking */
+    std::vector<ShaderParameter> attribute_bindings;
+    std::vector<std::string> feedback_varyings;
+    GLenum feedback_mode;
+};
+
+/* the binding point shared by every block of this name, handed out on first use */
+GLuint uniform_block_binding(const std::string& blockName);
+
+/* the same for shader storage blocks, which have binding points of their own */
+GLuint storage_block_binding(const std::string& blockName);
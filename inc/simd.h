@@ -0,0 +1,22 @@
+#pragma once
+
+/**
+ * Compile time detection of the SIMD instruction sets the CPU side kernels
+ * may use. Each kernel keeps a scalar path for when none are available.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FULGUROUS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define FULGUROUS_AVX2 1
+#include <immintrin.h>
+#endif
+
+/* MSVC has no F16C macro, but every AVX2 part has it */
+#if defined(__F16C__) || defined(__AVX2__)
+#define FULGUROUS_F16C 1
+#include <immintrin.h>
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+/**
+ * Shadow copy of the GL bindings we change most often, so redundant binds
+ * never reach the driver. Everything here is GL thread only. Call
+ * invalidate() after handing control to code that binds behind our back
+ * (NanoVG, for one).
+ */
+
+#include <array>
+#include <cassert>
+
+class StateCache
+{
+public:
+	static constexpr GLuint MAX_TEXTURE_UNITS = 32;
+
+	GLuint activeTextureUnit() const
+	{
+		return mActiveUnit;
+	}
+
+	void activeTexture(GLuint unit)
+	{
+		assert(unit < MAX_TEXTURE_UNITS);
+		if (unit != mActiveUnit)
+		{
+			gl_exec(glActiveTexture, GL_TEXTURE0 + unit);
+			mActiveUnit = unit;
+		}
+	}
+
+	void bindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		TextureBinding &binding = mTextures[unit];
+		if (binding.target == target && binding.texture == texture)
+			return;
+		activeTexture(unit);
+		gl_exec(glBindTexture, target, texture);
+		binding = {target, texture};
+	}
+
+	/* a deleted texture name can be reused, so it must not look bound any more */
+	void forgetTexture(GLuint texture)
+	{
+		for (TextureBinding &binding : mTextures)
+		{
+			if (binding.texture == texture)
+				binding = {};
+		}
+	}
+
+	void invalidate()
+	{
+		mActiveUnit = INVALID;
+		mTextures.fill({});
+	}
+
+private:
+	static constexpr GLuint INVALID = ~0u;
+
+	struct TextureBinding
+	{
+		GLenum target = 0;
+		GLuint texture = INVALID;
+	};
+
+	GLuint mActiveUnit = INVALID;
+	std::array<TextureBinding, MAX_TEXTURE_UNITS> mTextures;
+};
+
+/* the cache for the one GL context we drive */
+inline StateCache &state_cache()
+{
+	static StateCache cache;
+	return cache;
+}
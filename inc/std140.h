@@ -0,0 +1,255 @@
+#pragma once
+
+/**
+ * std140 uniform block layout, worked out at compile time. A block is an
+ * ordinary C++ struct built from the types below, which carry the std140
+ * alignments, plus a list of its member types:
+ *
+ *	struct FrameBlock
+ *	{
+ *		std140::mat4 MVP;
+ *		GLfloat time;
+ *
+ *		static constexpr const char *name = "Frame";
+ *		static constexpr const char *fields[] = {"MVP", "time"};
+ *		using members = std140::members<std140::mat4, GLfloat>;
+ *	};
+ *
+ * std140::verify<FrameBlock>() is a constant expression checking that the
+ * member types listed in members, laid out in order as C++ lays out a
+ * struct (by their alignof and sizeof), land at the std140 offsets, and that
+ * sizeof the struct matches that layout. It fails for the classic mistakes,
+ * like a scalar straight after a vec3 (std140 packs it into the vec3's last
+ * 4 bytes, C++ does not) or scalar arrays (std140 pads every element to 16
+ * bytes; use std140::array). It does not see the struct's own members, so
+ * it trusts members to list them in declaration order; a missing or extra
+ * member usually shows in the sizeof check, a reordered one does not.
+ * UniformBuffer checks it with a static_assert, then checks the names and
+ * the std140 offsets against what the driver reflects for each program
+ * (see UniformBuffer::verify).
+ */
+
+#include <array>
+#include <cstddef>
+
+namespace std140
+{
+	struct alignas(8) vec2
+	{
+		GLfloat x, y;
+	};
+
+	/* 16 byte aligned but only 12 bytes of data: do not follow it with a scalar */
+	struct alignas(16) vec3
+	{
+		GLfloat x, y, z;
+
+		vec3 &operator=(const Vector3 &v)
+		{
+			x = v.getX(); y = v.getY(); z = v.getZ();
+			return *this;
+		}
+
+		vec3 &operator=(const Point3 &p)
+		{
+			x = p.getX(); y = p.getY(); z = p.getZ();
+			return *this;
+		}
+	};
+
+	struct alignas(16) vec4
+	{
+		GLfloat x, y, z, w;
+
+		vec4 &operator=(const Vector4 &v)
+		{
+			x = v.getX(); y = v.getY(); z = v.getZ(); w = v.getW();
+			return *this;
+		}
+	};
+
+	struct alignas(16) ivec4
+	{
+		GLint x, y, z, w;
+	};
+
+	/* column major, each column padded out to a vec4 */
+	struct alignas(16) mat3
+	{
+		vec4 columns[3];
+
+		mat3 &operator=(const Matrix3 &m)
+		{
+			for (int i = 0; i < 3; ++i)
+				columns[i] = Vector4(m.getCol(i), 0.0f);
+			return *this;
+		}
+	};
+
+	struct alignas(16) mat4
+	{
+		vec4 columns[4];
+
+		mat4 &operator=(const Matrix4 &m)
+		{
+			for (int i = 0; i < 4; ++i)
+				columns[i] = m.getCol(i);
+			return *this;
+		}
+	};
+
+	/* arrays have every element rounded up to 16 bytes */
+	template <typename T, size_t N>
+	struct alignas(16) array
+	{
+		struct alignas(16) element
+		{
+			T value;
+		};
+		element elements[N];
+
+		T &operator[](size_t i)
+		{
+			return elements[i].value;
+		}
+
+		const T &operator[](size_t i) const
+		{
+			return elements[i].value;
+		}
+	};
+
+	/* the std140 base alignment and size of each type */
+	template <typename T>
+	struct traits
+	{
+		static_assert(sizeof(T) == 4, "Only 4 byte scalars and the std140 types can go in a uniform block!");
+		static constexpr size_t alignment = 4;
+		static constexpr size_t size = 4;
+	};
+
+	template <>
+	struct traits<vec2>
+	{
+		static constexpr size_t alignment = 8;
+		static constexpr size_t size = 8;
+	};
+
+	template <>
+	struct traits<vec3>
+	{
+		static constexpr size_t alignment = 16;
+		static constexpr size_t size = 12;
+	};
+
+	template <>
+	struct traits<vec4>
+	{
+		static constexpr size_t alignment = 16;
+		static constexpr size_t size = 16;
+	};
+
+	template <>
+	struct traits<ivec4> : traits<vec4>
+	{
+	};
+
+	template <>
+	struct traits<mat3>
+	{
+		static constexpr size_t alignment = 16;
+		static constexpr size_t size = 48;
+	};
+
+	template <>
+	struct traits<mat4>
+	{
+		static constexpr size_t alignment = 16;
+		static constexpr size_t size = 64;
+	};
+
+	template <typename T, size_t N>
+	struct traits<array<T, N>>
+	{
+		static constexpr size_t stride = (traits<T>::size + 15) & ~size_t(15);
+		static constexpr size_t alignment = 16;
+		static constexpr size_t size = stride * N;
+	};
+
+	constexpr size_t align(size_t offset, size_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	/* member offsets, both as std140 lays them out and as C++ would in a struct of these types in order */
+	template <typename... Ts>
+	struct members
+	{
+		static constexpr size_t count = sizeof...(Ts);
+
+		static constexpr std::array<size_t, sizeof...(Ts)> offsets()
+		{
+			std::array<size_t, sizeof...(Ts)> result{};
+			const size_t alignments[] = {traits<Ts>::alignment...};
+			const size_t sizes[] = {traits<Ts>::size...};
+			size_t offset = 0;
+			for (size_t i = 0; i < sizeof...(Ts); ++i)
+			{
+				offset = align(offset, alignments[i]);
+				result[i] = offset;
+				offset += sizes[i];
+			}
+			return result;
+		}
+
+		static constexpr std::array<size_t, sizeof...(Ts)> cpp_offsets()
+		{
+			std::array<size_t, sizeof...(Ts)> result{};
+			const size_t alignments[] = {alignof(Ts)...};
+			const size_t sizes[] = {sizeof(Ts)...};
+			size_t offset = 0;
+			for (size_t i = 0; i < sizeof...(Ts); ++i)
+			{
+				offset = align(offset, alignments[i]);
+				result[i] = offset;
+				offset += sizes[i];
+			}
+			return result;
+		}
+
+		/* what sizeof the struct should be if these really are its members */
+		static constexpr size_t cpp_size()
+		{
+			const size_t alignments[] = {alignof(Ts)...};
+			const size_t sizes[] = {sizeof(Ts)...};
+			size_t alignment = 1;
+			for (size_t a : alignments)
+				alignment = a > alignment ? a : alignment;
+			return align(cpp_offsets()[sizeof...(Ts) - 1] + sizes[sizeof...(Ts) - 1], alignment);
+		}
+	};
+
+	template <typename Block>
+	constexpr size_t offset(size_t member)
+	{
+		return Block::members::offsets()[member];
+	}
+
+	/* true when the listed member types fall at their std140 offsets in C++ too, and sizeof(Block) agrees */
+	template <typename Block>
+	constexpr bool verify()
+	{
+		using Members = typename Block::members;
+		static_assert(std::size(Block::fields) == Members::count, "Every block member needs a name in fields!");
+		if (sizeof(Block) != Members::cpp_size())
+			return false;
+		const auto expected = Members::offsets();
+		const auto actual = Members::cpp_offsets();
+		for (size_t i = 0; i < Members::count; ++i)
+		{
+			if (expected[i] != actual[i])
+				return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+/**
+ * 2D textures and 2D texture arrays. Storage is immutable (glTexStorage2D) wherever the driver
+ * has ARB_texture_storage, and binding goes through the state cache. Mips
+ * come from the GPU or from a CPU filter that runs on the job system; see
+ * AssetStreamer::stream_texture for loading one off the main thread.
+ */
+
+#include <filesystem>
+#include <utility>
+#include <vector>
+#include "jobsystem.h"
+#include "statecache.h"
+
+enum MipFilter : GLuint
+{
+    eMIP_NONE   = 0,
+    /* glGenerateMipmap once the base level is up */
+    eMIP_GPU    = 1,
+    /* 2x2 average; fast, but soft and prone to aliasing */
+    eMIP_BOX    = 2,
+    /* windowed sinc, keeps more detail in the small levels */
+    eMIP_KAISER = 3
+};
+
+/* 8 bit pixels, 1 to 4 channels, rows tightly packed */
+struct Image
+{
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLint channels = 0;
+    std::vector<GLubyte> pixels;
+
+    bool empty() const
+    {
+        return pixels.empty();
+    }
+
+    size_t rowSize() const
+    {
+        return size_t(width) * channels;
+    }
+};
+
+/* decode a png/jpg/tga etc with stb_image; empty on failure */
+Image load_image(const std::filesystem::path &filename);
+
+/* number of levels in a full chain down to 1x1 */
+GLsizei mip_count(GLsizei width, GLsizei height);
+
+/**
+ * Fill out levels[1..] from levels[0] down to 1x1. sRGB images are filtered
+ * in linear space. Rows are split across jobs when it is given.
+ */
+void build_mip_chain(std::vector<Image> &levels, MipFilter filter, bool srgb, JobSystem *jobs = nullptr);
+
+class Texture
+{
+public:
+    /**
+     * Allocate a 2D texture
+     * @param width Width of the base level
+     * @param height Height of the base level
+     * @param internalFormat Sized format eg. GL_SRGB8_ALPHA8
+     * @param levels Number of mip levels, 0 for a full chain
+     */
+    Texture(GLsizei width, GLsizei height, GLenum internalFormat, GLsizei levels = 0);
+    ~Texture();
+
+    Texture(const Texture &other) = delete;
+    Texture &operator=(const Texture &other) = delete;
+
+    /* a moved from texture owns nothing */
+    Texture(Texture &&other) noexcept;
+    Texture &operator=(Texture &&other) noexcept;
+
+    /* sized internal format and client format for 8 bit images of this many channels */
+    static GLenum internalFormat(GLint channels, bool srgb);
+    static GLenum pixelFormat(GLint channels);
+
+    /**
+     * Replace rows [y, y + rows) of a level. With a buffer bound to
+     * GL_PIXEL_UNPACK_BUFFER pixels is an offset into it.
+     */
+    void upload(GLint level, GLint y, GLsizei rows, GLenum format, const void *pixels);
+    void upload(GLint level, const Image &image);
+
+    void generateMipmaps();
+    void setFilter(GLenum minFilter, GLenum magFilter);
+    void setWrap(GLenum wrapS, GLenum wrapT);
+    void setAnisotropy(GLfloat anisotropy);
+
+    void bind(GLuint unit) const
+    {
+        state_cache().bindTexture(unit, GL_TEXTURE_2D, mTexture);
+    }
+
+    /* for image loads and stores in a shader (see compute.h); access is GL_READ_ONLY, GL_WRITE_ONLY or GL_READ_WRITE */
+    void bindImage(GLuint unit, GLenum access = GL_READ_WRITE, GLint level = 0) const
+    {
+        gl_exec(glBindImageTexture, unit, mTexture, level, GL_FALSE, 0, access, mInternalFormat);
+    }
+
+    GLuint getTexture() const
+    {
+        return mTexture;
+    }
+
+    GLsizei getWidth() const
+    {
+        return mWidth;
+    }
+
+    GLsizei getHeight() const
+    {
+        return mHeight;
+    }
+
+    GLsizei getLevels() const
+    {
+        return mLevels;
+    }
+
+    GLenum getInternalFormat() const
+    {
+        return mInternalFormat;
+    }
+
+    bool isImmutable() const
+    {
+        return mImmutable;
+    }
+
+private:
+    /* bind on whichever unit is active, to edit the texture */
+    void bindForUpdate() const
+    {
+        bind(state_cache().activeTextureUnit() < StateCache::MAX_TEXTURE_UNITS ? state_cache().activeTextureUnit() : 0);
+    }
+
+    GLuint mTexture;
+    GLsizei mWidth;
+    GLsizei mHeight;
+    GLsizei mLevels;
+    GLenum mInternalFormat;
+    bool mImmutable;
+};
+
+/* GL_TEXTURE_2D_ARRAY of same sized layers, eg. atlas pages (see texturepacker.h) */
+class TextureArray
+{
+public:
+    TextureArray(GLsizei width, GLsizei height, GLsizei layers, GLenum internalFormat, GLsizei levels = 0);
+    ~TextureArray();
+
+    TextureArray(const TextureArray &other) = delete;
+    TextureArray &operator=(const TextureArray &other) = delete;
+
+    TextureArray(TextureArray &&other) noexcept;
+    TextureArray &operator=(TextureArray &&other) noexcept;
+
+    void upload(GLint level, GLint layer, const Image &image);
+    void generateMipmaps();
+    void setFilter(GLenum minFilter, GLenum magFilter);
+    void setWrap(GLenum wrapS, GLenum wrapT);
+
+    void bind(GLuint unit) const
+    {
+        state_cache().bindTexture(unit, GL_TEXTURE_2D_ARRAY, mTexture);
+    }
+
+    /* every layer as an image2DArray, or with a layer, just that one as an image2D */
+    void bindImage(GLuint unit, GLenum access = GL_READ_WRITE, GLint level = 0, GLint layer = -1) const
+    {
+        gl_exec(glBindImageTexture, unit, mTexture, level, layer < 0 ? GL_TRUE : GL_FALSE, layer < 0 ? 0 : layer, access, mInternalFormat);
+    }
+
+    GLuint getTexture() const
+    {
+        return mTexture;
+    }
+
+    GLsizei getWidth() const
+    {
+        return mWidth;
+    }
+
+    GLsizei getHeight() const
+    {
+        return mHeight;
+    }
+
+    GLsizei getLayers() const
+    {
+        return mLayers;
+    }
+
+    GLsizei getLevels() const
+    {
+        return mLevels;
+    }
+
+private:
+    void bindForUpdate() const
+    {
+        bind(state_cache().activeTextureUnit() < StateCache::MAX_TEXTURE_UNITS ? state_cache().activeTextureUnit() : 0);
+    }
+
+    GLuint mTexture;
+    GLsizei mWidth;
+    GLsizei mHeight;
+    GLsizei mLayers;
+    GLsizei mLevels;
+    GLenum mInternalFormat;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+/**
+ * Packing many small images into a few textures, so a batch of sprites or
+ * UI quads needs one bind instead of one per image. Images go either into
+ * atlas pages (skyline or maxrects packing), or one per layer of a texture
+ * array; pages of an atlas are themselves the layers of an array, so one
+ * TextureArray serves either way. The UV remap table that comes back says
+ * where each image went, and BufferBuilder::remap_uvs applies it.
+ *
+ * The packers are plain CPU code, so they run equally at load time or in an
+ * offline tool that saves the pages and table (save_uv_table).
+ */
+
+#include <filesystem>
+#include <vector>
+#include "texture.h"
+#include "uvremap.h"
+
+struct PackRect
+{
+    GLsizei x;
+    GLsizei y;
+    GLsizei width;
+    GLsizei height;
+};
+
+/**
+ * Bottom left skyline packer. Cheap and incremental, so good for things
+ * filled in at runtime like glyph caches, at some cost in wasted space.
+ */
+class SkylinePacker
+{
+public:
+    SkylinePacker(GLsizei width, GLsizei height);
+
+    /* false if there is no room */
+    bool insert(GLsizei width, GLsizei height, PackRect &placed);
+    float occupancy() const;
+
+private:
+    struct Segment
+    {
+        GLsizei x;
+        GLsizei y;
+        GLsizei width;
+    };
+
+    /* lowest y a rect can sit at on segment index, or -1 if it does not fit there */
+    GLsizei fit(size_t index, GLsizei width, GLsizei height) const;
+
+    GLsizei mWidth;
+    GLsizei mHeight;
+    size_t mUsed;
+    std::vector<Segment> mSkyline;
+};
+
+/**
+ * Maxrects packer with the best short side fit heuristic. Slower than the
+ * skyline but packs tighter, which suits offline atlas builds.
+ */
+class MaxRectsPacker
+{
+public:
+    MaxRectsPacker(GLsizei width, GLsizei height);
+
+    bool insert(GLsizei width, GLsizei height, PackRect &placed);
+    float occupancy() const;
+
+private:
+    void split(const PackRect &used);
+    void prune();
+
+    GLsizei mWidth;
+    GLsizei mHeight;
+    size_t mUsed;
+    std::vector<PackRect> mFree;
+};
+
+enum PackMethod : GLuint
+{
+    ePACK_SKYLINE  = 0,
+    ePACK_MAXRECTS = 1
+};
+
+/* same sized pages, each a layer of the final texture */
+struct PackedAtlas
+{
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLint channels = 0;
+    std::vector<Image> pages;
+    /* one per source image, in the order they were given */
+    UVRemapTable remaps;
+};
+
+/**
+ * Pack images into as many pageSize x pageSize pages as they need. Each image
+ * is surrounded by padding pixels copied from its edges, so filtering and the
+ * smaller mips do not bleed neighbours in.
+ */
+PackedAtlas pack_atlas(const std::vector<Image> &images, GLsizei pageSize, GLsizei padding = 2, PackMethod method = ePACK_MAXRECTS);
+
+/* one image per layer; layers are the size of the largest image and smaller ones sit in the corner */
+PackedAtlas pack_layers(const std::vector<Image> &images);
+
+/* upload the pages, with mips from filter (see Texture) */
+std::shared_ptr<TextureArray> make_texture_array(const PackedAtlas &atlas, MipFilter filter, bool srgb, JobSystem *jobs = nullptr);
+
+/* the remap table as text, one image per line, for offline packing */
+bool save_uv_table(const UVRemapTable &table, const std::filesystem::path &filename);
+UVRemapTable load_uv_table(const std::filesystem::path &filename);
@@ -0,0 +1,124 @@
+#pragma once
+
+/**
+ * Retained NanoVG panels. Each panel's build function runs against a
+ * recording NanoVG context whose renderer keeps what NanoVG hands it (the
+ * tessellated fills, strokes and glyph quads, with their paints and
+ * scissors) instead of drawing it. Every frame after that, draw passes the
+ * kept geometry straight to the target context's GL renderer, so an
+ * unchanged panel costs no path building, tessellation or text layout;
+ * only panels marked dirty are built again.
+ *
+ * The recording context shares the target's renderer for textures, so
+ * images made on the target work in panels, and the recorder's own font
+ * atlas lives on the target too. Fonts have to be added through
+ * createFont to be usable in panels. The geometry is in window
+ * coordinates, so a panel that moves, or a change of window size or pixel
+ * ratio, needs it built again; draw does the latter itself.
+ */
+
+#include <functional>
+#include <vector>
+
+class UILayer
+{
+public:
+    using Build = std::function<void(NVGcontext *vg)>;
+
+    /* target must outlive the layer */
+    explicit UILayer(NVGcontext *target);
+    ~UILayer();
+
+    UILayer(const UILayer &other) = delete;
+    UILayer &operator=(const UILayer &other) = delete;
+
+    /* as nvgCreateFont, for the panels */
+    int createFont(const char *name, const char *filename);
+
+    /* panels draw in the order they were added; returns the panel's index */
+    size_t addPanel(Build build);
+    void setPanel(size_t panel, Build build);
+    /* build the panel again on the next draw */
+    void invalidate(size_t panel);
+    void invalidateAll();
+
+    size_t panelCount() const
+    {
+        return mPanels.size();
+    }
+
+    /* panels built by the last draw, rather than redrawn from their geometry */
+    size_t rebuilt() const
+    {
+        return mRebuilt;
+    }
+
+    /* between nvgBeginFrame and nvgEndFrame on the target, with the same size and ratio */
+    void draw(float windowWidth, float windowHeight, float devicePixelRatio);
+
+private:
+    enum CommandKind : GLuint
+    {
+        eFILL = 0,
+        eSTROKE,
+        eTRIANGLES
+    };
+
+    struct Command
+    {
+        CommandKind kind;
+        NVGpaint paint;
+        NVGcompositeOperationState composite;
+        NVGscissor scissor;
+        float fringe;
+        float strokeWidth;
+        float bounds[4];
+        /* into the panel's paths for fills and strokes, its vertices for triangles */
+        size_t first;
+        size_t count;
+    };
+
+    struct Panel
+    {
+        Build build;
+        bool dirty = true;
+        std::vector<Command> commands;
+        std::vector<NVGpath> paths;
+        /* where each path's fill and stroke start in vertices, set into paths once recording ends */
+        std::vector<size_t> fillStarts;
+        std::vector<size_t> strokeStarts;
+        std::vector<NVGvertex> vertices;
+        /* the images the commands use, so a deleted one marks the panel dirty */
+        std::vector<int> images;
+    };
+
+    void record(Panel &panel, float windowWidth, float windowHeight, float devicePixelRatio);
+    void recordImage(int image);
+
+    /* the recorder's renderer callbacks; uptr is the UILayer */
+    static int renderCreate(void *uptr);
+    static int renderCreateTexture(void *uptr, int type, int w, int h, int imageFlags, const unsigned char *data);
+    static int renderDeleteTexture(void *uptr, int image);
+    static int renderUpdateTexture(void *uptr, int image, int x, int y, int w, int h, const unsigned char *data);
+    static int renderGetTextureSize(void *uptr, int image, int *w, int *h);
+    static void renderViewport(void *uptr, float width, float height, float devicePixelRatio);
+    static void renderCancel(void *uptr);
+    static void renderFlush(void *uptr);
+    static void renderFill(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor, float fringe,
+                           const float *bounds, const NVGpath *paths, int npaths);
+    static void renderStroke(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor, float fringe,
+                             float strokeWidth, const NVGpath *paths, int npaths);
+    static void renderTriangles(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor,
+                                const NVGvertex *verts, int nverts, float fringe);
+    static void renderDelete(void *uptr);
+
+    NVGcontext *mTarget;
+    NVGcontext *mRecorder;
+    std::vector<Panel> mPanels;
+    /* the panel being built, if any */
+    Panel *mRecording;
+    float mWidth;
+    float mHeight;
+    float mRatio;
+    size_t mRebuilt;
+};
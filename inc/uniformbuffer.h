@@ -0,0 +1,114 @@
+#pragma once
+
+/**
+ * Uniform buffer holding one std140 block (see std140.h). Each block name
+ * owns a binding point shared by every program (uniform_block_binding),
+ * and ShaderProgram::link hooks a program's block of that name up to it, so
+ * data like the camera is uploaded once a frame and seen by everything drawn
+ * afterwards.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include "std140.h"
+
+template <typename Block>
+class UniformBuffer {
+	static_assert(std140::verify<Block>(), "Block members are not where std140 puts them; check for scalars after a vec3 and use std140::array for arrays");
+
+	GLuint mBuffer;
+	GLuint mBinding;
+
+public:
+	/* CPU copy; fill it in, then upload() */
+	Block data;
+
+	UniformBuffer(GLenum usage = GL_DYNAMIC_DRAW) : mBinding(uniform_block_binding(Block::name)), data{}
+	{
+		gl_exec(glGenBuffers, 1, &mBuffer);
+		gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, mBuffer);
+		gl_exec(glBufferData, GL_UNIFORM_BUFFER, GLsizeiptr(sizeof(Block)), nullptr, usage);
+		gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, 0);
+		bind();
+	}
+
+	~UniformBuffer()
+	{
+		if (mBuffer != 0)
+			gl_exec(glDeleteBuffers, 1, &mBuffer);
+	}
+
+	UniformBuffer(const UniformBuffer &other) = delete;
+	UniformBuffer &operator=(const UniformBuffer &other) = delete;
+
+	UniformBuffer(UniformBuffer &&other) noexcept : mBuffer(std::exchange(other.mBuffer, 0)), mBinding(other.mBinding), data(other.data)
+	{
+	}
+
+	UniformBuffer &operator=(UniformBuffer &&other) noexcept
+	{
+		std::swap(mBuffer, other.mBuffer);
+		std::swap(mBinding, other.mBinding);
+		std::swap(data, other.data);
+		return *this;
+	}
+
+	GLuint getBuffer() const {
+		return mBuffer;
+	}
+
+	GLuint getBindingPoint() const {
+		return mBinding;
+	}
+
+	/* attach to the block's binding point; the constructor already does this */
+	void bind() const
+	{
+		gl_exec(glBindBufferBase, GL_UNIFORM_BUFFER, mBinding, mBuffer);
+	}
+
+	/* send data to the GPU, once per change rather than once per program */
+	void upload()
+	{
+		gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, mBuffer);
+		gl_exec(glBufferSubData, GL_UNIFORM_BUFFER, 0, GLsizeiptr(sizeof(Block)), &data);
+		gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, 0);
+	}
+
+	/**
+	 * Check the block against what the driver reflects for a program: every
+	 * listed member must be at the offset std140 gives it, going by the
+	 * member types in Block::members. Programs without the block pass.
+	 */
+	bool verify(const ShaderProgram &program) const
+	{
+		const ShaderProgram::UniformBlock *reflected = program.uniform_block(Block::name);
+		if (reflected == nullptr)
+			return true;
+		bool ok = true;
+		const auto offsets = Block::members::offsets();
+		for (size_t i = 0; i < Block::members::count; ++i)
+		{
+			const GLint offset = reflected->member_offset(Block::fields[i]);
+			if (offset >= 0 && GLuint(offset) != offsets[i])
+			{
+				std::cerr << "Uniform block " << Block::name << " member " << Block::fields[i] << " is at " << offset
+						  << " in the shader but " << offsets[i] << " by Block::members" << std::endl;
+				ok = false;
+			}
+			else if (offset < 0)
+			{
+				// unused members are dropped by the linker, which is fine, so this is only a warning
+				std::cerr << "Uniform block " << Block::name << " member " << Block::fields[i] << " is not active in the shader" << std::endl;
+			}
+		}
+		if (GLsizeiptr(reflected->dataSize) > GLsizeiptr(sizeof(Block)))
+		{
+			std::cerr << "Uniform block " << Block::name << " is " << reflected->dataSize << " bytes in the shader but "
+					  << sizeof(Block) << " in C++" << std::endl;
+			ok = false;
+		}
+		return ok;
+	}
+};
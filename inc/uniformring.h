@@ -0,0 +1,97 @@
+#pragma once
+
+/**
+ * Per draw uniform data through one big uniform buffer. Each frame owns a
+ * segment of the buffer; blocks are copied in one after another at the
+ * driver's offset alignment and bound with glBindBufferRange, so per object
+ * data costs a memcpy and a range bind rather than a glUniform call per
+ * value. A fence at the end of each frame stops a segment being reused
+ * while the GPU may still read it.
+ *
+ * The buffer is persistently mapped where ARB_buffer_storage exists;
+ * elsewhere, and while a GL trace runs, each block goes up with
+ * glBufferSubData instead of the memcpy.
+ * A frame that outgrows its segment moves to a new buffer with segments
+ * twice the size; the old one lives until the frame ends, as draws queued
+ * earlier in it may still have ranges of it bound.
+ */
+
+#include <vector>
+#include "std140.h"
+
+class UniformRing
+{
+public:
+    struct Range
+    {
+        /* the ring's buffer when it was pushed, which growing can change */
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    explicit UniformRing(GLsizeiptr bytesPerFrame = 1 << 20, GLuint framesInFlight = 3);
+    ~UniformRing();
+
+    UniformRing(const UniformRing &other) = delete;
+    UniformRing &operator=(const UniformRing &other) = delete;
+
+    /* Context::draw calls these around drawcb */
+    void beginFrame();
+    void endFrame();
+
+    /* copy bytes into this frame's segment */
+    Range push(const void *data, GLsizeiptr size);
+
+    /* copy a std140 block in and bind it to the binding point its name owns */
+    template <typename Block>
+    Range bind(const Block &block)
+    {
+        static_assert(std140::verify<Block>(), "Block members are not where std140 puts them");
+        return bind(block, uniform_block_binding(Block::name));
+    }
+
+    template <typename Block>
+    Range bind(const Block &block, GLuint binding)
+    {
+        Range range = push(&block, GLsizeiptr(sizeof(Block)));
+        gl_exec(glBindBufferRange, GL_UNIFORM_BUFFER, binding, range.buffer, range.offset, range.size);
+        return range;
+    }
+
+    GLuint getBuffer() const
+    {
+        return mBuffer;
+    }
+
+    /* bytes pushed so far this frame, including alignment padding */
+    GLsizeiptr used() const
+    {
+        return mHead - GLsizeiptr(mSegment) * mSegmentSize;
+    }
+
+private:
+    struct Retired
+    {
+        GLuint buffer;
+        GLubyte *mapped;
+    };
+
+    void create();
+    /* drop the buffer for create() to replace; it is released at the end of the frame */
+    void retire();
+    /* room for at least size bytes a frame, in a new buffer */
+    void grow(GLsizeiptr size);
+    static void release(GLuint buffer, GLubyte *mapped);
+
+    GLuint mBuffer;
+    GLsizeiptr mSegmentSize;
+    GLuint mSegmentCount;
+    GLuint mSegment;
+    GLsizeiptr mHead;
+    GLint mAlignment;
+    GLubyte *mMapped;
+    std::vector<GLsync> mFences;
+    /* outgrown this frame */
+    std::vector<Retired> mRetired;
+};
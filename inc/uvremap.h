@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * Where one source image ended up in an atlas or texture array: texture
+ * coordinates that addressed the whole image become uv * scale + offset on
+ * the given layer.
+ */
+struct UVRemap
+{
+	GLfloat scaleU = 1.0f;
+	GLfloat scaleV = 1.0f;
+	GLfloat offsetU = 0.0f;
+	GLfloat offsetV = 0.0f;
+	GLfloat layer = 0.0f;
+
+	void apply(GLfloat &u, GLfloat &v) const
+	{
+		u = u * scaleU + offsetU;
+		v = v * scaleV + offsetV;
+	}
+};
+
+/* indexed by source image */
+using UVRemapTable = std::vector<UVRemap>;
@@ -12,6 +12,7 @@ struct Vec<T, 1> {
     using type = T;
     static constexpr int dim = 1;
     T x;
+    Vec<T, 1>() = default;
     Vec<T, 1>(const T& e) : x(e)
     {}
     Vec<T, 1>  operator- ()                   const {return {-x};}
@@ -27,6 +28,7 @@ struct Vec<T, 2> {
     static constexpr int dim = 2;
     union {T x, u;};
     union {T y, v;};
+    Vec<T, 2>() = default;
     Vec<T, 2>(const T& e1, const T& e2) : x(e1), y(e2)
     {}
     Vec<T, 2>  operator- ()                   const {return {-x, -y};}
@@ -43,6 +45,7 @@ struct Vec<T, 3> {
     union {T x, r;};
     union {T y, g;};
     union {T z, b;};
+    Vec<T, 3>() = default;
     Vec<T, 3>(const T& e1, const T& e2, const T& e3) : x(e1), y(e2), z(e3)
     {}
     Vec<T, 3>  operator- ()                   const {return {-x, -y, -z};}
@@ -62,6 +65,7 @@ struct Vec<T, 4> {
     union {T y, g;};
     union {T z, b;};
     union {T w, a;};
+    Vec<T, 4>() = default;
     Vec<T, 4>(const T& e1, const T& e2, const T& e3, const T& e4) : x(e1), y(e2), z(e3), w(e4)
     {}
     Vec<T, 4>  operator- ()                   const {return {-x, -y, -z, -w};}
@@ -0,0 +1,256 @@
+#pragma once
+
+/**
+ * Kernels converting float vertex data to the compressed attribute formats
+ * in gl_typetraits.h. Every pack_components overload converts `count`
+ * destination components; only GL_INT_2_10_10_10_REV consumes more than
+ * one float (four) per component.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "gl_typetraits.h"
+#include "simd.h"
+
+/* float to binary16, round to nearest even (after Fabian Giesen) */
+inline GLhalf float_to_half(GLfloat value)
+{
+	const GLuint f32infinity = 255u << 23;
+	const GLuint f16max = (127u + 16u) << 23;
+	const GLuint denormMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+	GLuint bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const GLuint sign = bits & 0x80000000u;
+	bits ^= sign;
+	GLuint result;
+	if (bits >= f16max)
+	{
+		/* Inf stays Inf, NaN becomes a quiet NaN */
+		result = (bits > f32infinity) ? 0x7e00u : 0x7c00u;
+	}
+	else if (bits < (113u << 23))
+	{
+		/* subnormal or zero: let the FPU round the mantissa into place */
+		GLfloat magnitude, denormMagic;
+		std::memcpy(&magnitude, &bits, sizeof(bits));
+		std::memcpy(&denormMagic, &denormMagicBits, sizeof(bits));
+		magnitude += denormMagic;
+		std::memcpy(&bits, &magnitude, sizeof(bits));
+		result = bits - denormMagicBits;
+	}
+	else
+	{
+		const GLuint mantissaOdd = (bits >> 13) & 1u;
+		bits += ((15u - 127u) << 23) + 0xfffu;
+		bits += mantissaOdd;
+		result = bits >> 13;
+	}
+	return GLhalf(result | (sign >> 16));
+}
+
+inline GLfloat half_to_float(GLhalf half)
+{
+	const GLuint shiftedExponent = 0x7c00u << 13;
+	const GLuint magicBits = 113u << 23;
+	GLuint bits = (GLuint(half) & 0x7fffu) << 13;
+	const GLuint exponent = bits & shiftedExponent;
+	bits += (127u - 15u) << 23;
+	GLfloat result;
+	if (exponent == shiftedExponent)
+	{
+		/* Inf or NaN */
+		bits += (128u - 16u) << 23;
+		std::memcpy(&result, &bits, sizeof(bits));
+	}
+	else if (exponent == 0)
+	{
+		/* zero or subnormal */
+		GLfloat magic;
+		bits += 1u << 23;
+		std::memcpy(&result, &bits, sizeof(bits));
+		std::memcpy(&magic, &magicBits, sizeof(bits));
+		result -= magic;
+	}
+	else
+	{
+		std::memcpy(&result, &bits, sizeof(bits));
+	}
+	return (half & 0x8000u) ? -result : result;
+}
+
+/* clamp to [lo,hi], scale and round to the nearest integer */
+inline GLint quantise(GLfloat value, GLfloat lo, GLfloat hi, GLfloat scale)
+{
+	return GLint(std::lrint(std::min(std::max(value, lo), hi) * scale));
+}
+
+#ifdef FULGUROUS_SSE2
+inline __m128i quantise4(const GLfloat *src, __m128 lo, __m128 hi, __m128 scale)
+{
+	return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), lo), hi), scale));
+}
+#endif
+
+/* plain components are a straight conversion */
+template <typename T>
+void pack_components(const GLfloat *src, T *dst, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = static_cast<T>(src[i]);
+}
+
+inline void pack_components(const GLfloat *src, GLfloat *dst, size_t count)
+{
+	std::memcpy(dst, src, count * sizeof(GLfloat));
+}
+
+template <typename T>
+void pack_components(const GLfloat *src, GLinteger<T> *dst, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		dst[i].value = static_cast<T>(std::lrint(src[i]));
+}
+
+inline void pack_components(const GLfloat *src, GLhalfbits *dst, size_t count)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_F16C
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), halves);
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i].bits = float_to_half(src[i]);
+}
+
+inline void pack_components(const GLfloat *src, GLnorm<GLubyte> *dst, size_t count)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	const __m128 lo = _mm_setzero_ps();
+	const __m128 hi = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(255.0f);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i ab = _mm_packs_epi32(quantise4(src + i, lo, hi, scale), quantise4(src + i + 4, lo, hi, scale));
+		__m128i cd = _mm_packs_epi32(quantise4(src + i + 8, lo, hi, scale), quantise4(src + i + 12, lo, hi, scale));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(ab, cd));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i].value = GLubyte(quantise(src[i], 0.0f, 1.0f, 255.0f));
+}
+
+inline void pack_components(const GLfloat *src, GLnorm<GLbyte> *dst, size_t count)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	const __m128 lo = _mm_set1_ps(-1.0f);
+	const __m128 hi = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(127.0f);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i ab = _mm_packs_epi32(quantise4(src + i, lo, hi, scale), quantise4(src + i + 4, lo, hi, scale));
+		__m128i cd = _mm_packs_epi32(quantise4(src + i + 8, lo, hi, scale), quantise4(src + i + 12, lo, hi, scale));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi16(ab, cd));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i].value = GLbyte(quantise(src[i], -1.0f, 1.0f, 127.0f));
+}
+
+inline void pack_components(const GLfloat *src, GLnorm<GLushort> *dst, size_t count)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	/* SSE2 only has a signed 32->16 pack, so bias into signed range and flip back */
+	const __m128 lo = _mm_setzero_ps();
+	const __m128 hi = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(65535.0f);
+	const __m128i bias = _mm_set1_epi32(32768);
+	const __m128i flip = _mm_set1_epi16(short(0x8000));
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i a = _mm_sub_epi32(quantise4(src + i, lo, hi, scale), bias);
+		__m128i b = _mm_sub_epi32(quantise4(src + i + 4, lo, hi, scale), bias);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(_mm_packs_epi32(a, b), flip));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i].value = GLushort(quantise(src[i], 0.0f, 1.0f, 65535.0f));
+}
+
+inline void pack_components(const GLfloat *src, GLnorm<GLshort> *dst, size_t count)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	const __m128 lo = _mm_set1_ps(-1.0f);
+	const __m128 hi = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i packed = _mm_packs_epi32(quantise4(src + i, lo, hi, scale), quantise4(src + i + 4, lo, hi, scale));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), packed);
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i].value = GLshort(quantise(src[i], -1.0f, 1.0f, 32767.0f));
+}
+
+/**
+ * Pack xyzw float quadruples into 2_10_10_10 words.
+ * Normalised packing maps [-1,1] onto the full signed range of each field,
+ * otherwise the floats are rounded and clamped to [-512,511] and [-2,1].
+ */
+template <bool Normalised>
+void pack_2_10_10_10(const GLfloat *src, GLuint *dst, size_t count)
+{
+	const GLfloat xyzLo = Normalised ? -1.0f : -512.0f;
+	const GLfloat xyzHi = Normalised ? 1.0f : 511.0f;
+	const GLfloat xyzScale = Normalised ? 511.0f : 1.0f;
+	const GLfloat wLo = Normalised ? -1.0f : -2.0f;
+	const GLfloat wHi = 1.0f;
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	const __m128 lo = _mm_set_ps(wLo, xyzLo, xyzLo, xyzLo);
+	const __m128 hi = _mm_set_ps(wHi, xyzHi, xyzHi, xyzHi);
+	const __m128 scale = _mm_set_ps(1.0f, xyzScale, xyzScale, xyzScale);
+	const __m128i mask = _mm_set_epi32(0x3, 0x3ff, 0x3ff, 0x3ff);
+	for (; i + 4 <= count; i += 4)
+	{
+		/* quantise four vertices, then transpose so each register holds one field */
+		__m128 v0 = _mm_castsi128_ps(_mm_and_si128(quantise4(src + i * 4, lo, hi, scale), mask));
+		__m128 v1 = _mm_castsi128_ps(_mm_and_si128(quantise4(src + i * 4 + 4, lo, hi, scale), mask));
+		__m128 v2 = _mm_castsi128_ps(_mm_and_si128(quantise4(src + i * 4 + 8, lo, hi, scale), mask));
+		__m128 v3 = _mm_castsi128_ps(_mm_and_si128(quantise4(src + i * 4 + 12, lo, hi, scale), mask));
+		_MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+		__m128i words = _mm_castps_si128(v0);
+		words = _mm_or_si128(words, _mm_slli_epi32(_mm_castps_si128(v1), 10));
+		words = _mm_or_si128(words, _mm_slli_epi32(_mm_castps_si128(v2), 20));
+		words = _mm_or_si128(words, _mm_slli_epi32(_mm_castps_si128(v3), 30));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), words);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		const GLfloat *v = src + i * 4;
+		GLuint x = GLuint(quantise(v[0], xyzLo, xyzHi, xyzScale)) & 0x3ffu;
+		GLuint y = GLuint(quantise(v[1], xyzLo, xyzHi, xyzScale)) & 0x3ffu;
+		GLuint z = GLuint(quantise(v[2], xyzLo, xyzHi, xyzScale)) & 0x3ffu;
+		GLuint w = GLuint(quantise(v[3], wLo, wHi, 1.0f)) & 0x3u;
+		dst[i] = x | (y << 10) | (z << 20) | (w << 30);
+	}
+}
+
+inline void pack_components(const GLfloat *src, GLpacked_2_10_10_10 *dst, size_t count)
+{
+	pack_2_10_10_10<false>(src, reinterpret_cast<GLuint *>(dst), count);
+}
+
+inline void pack_components(const GLfloat *src, GLnorm<GLpacked_2_10_10_10> *dst, size_t count)
+{
+	pack_2_10_10_10<true>(src, reinterpret_cast<GLuint *>(dst), count);
+}
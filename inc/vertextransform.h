@@ -0,0 +1,249 @@
+#pragma once
+
+/**
+ * Bulk kernels moving sce_vectormath AoS values into tightly packed float
+ * streams, optionally transforming or normalising them on the way. Each
+ * kernel has SSE2 and AVX2 paths and a scalar fallback.
+ */
+
+#include <cstring>
+#include "boundingbox.h"
+#include "simd.h"
+
+#ifdef FULGUROUS_SSE2
+
+/* vectormath objects are four floats wide with x,y,z(,w) first; fall back to a gather if not */
+template <typename V>
+inline __m128 load_xyzw(const V &v)
+{
+	if constexpr (sizeof(V) == 4 * sizeof(float))
+	{
+		return _mm_loadu_ps(reinterpret_cast<const float *>(&v));
+	}
+	else
+	{
+		return _mm_set_ps(0.0f, v.getZ(), v.getY(), v.getX());
+	}
+}
+
+/* write the xyz of v, touching exactly three floats */
+inline void store_xyz(GLfloat *dst, __m128 v)
+{
+	_mm_storel_pi(reinterpret_cast<__m64 *>(dst), v);
+	_mm_store_ss(dst + 2, _mm_movehl_ps(v, v));
+}
+
+template <int Lane>
+inline __m128 splat(__m128 v)
+{
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(Lane, Lane, Lane, Lane));
+}
+
+inline __m128 transform4(const __m128 cols[4], __m128 v, __m128 w)
+{
+	__m128 r = _mm_mul_ps(cols[0], splat<0>(v));
+	r = _mm_add_ps(r, _mm_mul_ps(cols[1], splat<1>(v)));
+	r = _mm_add_ps(r, _mm_mul_ps(cols[2], splat<2>(v)));
+	return _mm_add_ps(r, _mm_mul_ps(cols[3], w));
+}
+
+inline __m128 normalise3(__m128 v)
+{
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	v = _mm_and_ps(v, xyzMask);
+	__m128 sq = _mm_mul_ps(v, v);
+	__m128 dot = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+	dot = _mm_add_ps(dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_div_ps(v, _mm_sqrt_ps(dot));
+}
+
+#endif
+
+#ifdef FULGUROUS_AVX2
+
+/* two vectormath values side by side, one per 128 bit lane */
+template <typename V>
+inline __m256 load_xyzw2(const V *v)
+{
+	if constexpr (sizeof(V) == 4 * sizeof(float))
+	{
+		return _mm256_loadu_ps(reinterpret_cast<const float *>(v));
+	}
+	else
+	{
+		return _mm256_set_m128(load_xyzw(v[1]), load_xyzw(v[0]));
+	}
+}
+
+inline __m256 transform8(const __m256 cols[4], __m256 v, __m256 w)
+{
+	__m256 r = _mm256_mul_ps(cols[0], _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+	r = _mm256_add_ps(r, _mm256_mul_ps(cols[1], _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+	r = _mm256_add_ps(r, _mm256_mul_ps(cols[2], _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+	return _mm256_add_ps(r, _mm256_mul_ps(cols[3], w));
+}
+
+#endif
+
+/**
+ * Copy the xyz of count points or vectors to dst (3 floats each)
+ */
+template <typename V>
+void pack_xyz(const V *src, GLfloat *dst, size_t count)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	for (; i < count; ++i)
+		store_xyz(dst + i * 3, load_xyzw(src[i]));
+#endif
+	for (; i < count; ++i)
+		storeXYZ(src[i], dst + i * 3);
+}
+
+/**
+ * Copy count Vector4s to dst (4 floats each)
+ */
+inline void pack_xyzw(const Vector4 *src, GLfloat *dst, size_t count)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	for (; i < count; ++i)
+		_mm_storeu_ps(dst + i * 4, load_xyzw(src[i]));
+#endif
+	for (; i < count; ++i)
+		storeXYZW(src[i], dst + i * 4);
+}
+
+/**
+ * Transform count points by an affine matrix, writing xyz to dst
+ * (3 floats each) and growing bounds to fit the transformed points.
+ */
+inline void transform_points(const Matrix4 &matrix, const Point3 *src, GLfloat *dst, size_t count, BoundingBox &bounds)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	const __m128 cols[4] = {load_xyzw(matrix.getCol0()), load_xyzw(matrix.getCol1()), load_xyzw(matrix.getCol2()), load_xyzw(matrix.getCol3())};
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 lower = _mm_set1_ps(std::numeric_limits<float>::max());
+	__m128 upper = _mm_set1_ps(-std::numeric_limits<float>::max());
+#ifdef FULGUROUS_AVX2
+	const __m256 cols2[4] = {_mm256_set_m128(cols[0], cols[0]), _mm256_set_m128(cols[1], cols[1]),
+							 _mm256_set_m128(cols[2], cols[2]), _mm256_set_m128(cols[3], cols[3])};
+	const __m256 one2 = _mm256_set1_ps(1.0f);
+	__m256 lower2 = _mm256_set_m128(lower, lower);
+	__m256 upper2 = _mm256_set_m128(upper, upper);
+	for (; i + 2 <= count; i += 2)
+	{
+		__m256 r = transform8(cols2, load_xyzw2(src + i), one2);
+		lower2 = _mm256_min_ps(lower2, r);
+		upper2 = _mm256_max_ps(upper2, r);
+		store_xyz(dst + i * 3, _mm256_castps256_ps128(r));
+		store_xyz(dst + i * 3 + 3, _mm256_extractf128_ps(r, 1));
+	}
+	lower = _mm_min_ps(_mm256_castps256_ps128(lower2), _mm256_extractf128_ps(lower2, 1));
+	upper = _mm_max_ps(_mm256_castps256_ps128(upper2), _mm256_extractf128_ps(upper2, 1));
+#endif
+	for (; i < count; ++i)
+	{
+		__m128 r = transform4(cols, load_xyzw(src[i]), one);
+		lower = _mm_min_ps(lower, r);
+		upper = _mm_max_ps(upper, r);
+		store_xyz(dst + i * 3, r);
+	}
+	alignas(16) GLfloat lo[4], hi[4];
+	_mm_store_ps(lo, lower);
+	_mm_store_ps(hi, upper);
+	if (count > 0)
+	{
+		bounds.extend(Point3(lo[0], lo[1], lo[2]));
+		bounds.extend(Point3(hi[0], hi[1], hi[2]));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		Point3 p((matrix * src[i]).getXYZ());
+		bounds.extend(p);
+		storeXYZ(p, dst + i * 3);
+	}
+}
+
+/**
+ * Transform count directions by the upper 3x3 of a matrix (eg. the inverse
+ * transpose for normals), writing xyz to dst (3 floats each).
+ * @param normalise Rescale the results to unit length
+ */
+inline void transform_vectors(const Matrix3 &matrix, const Vector3 *src, GLfloat *dst, size_t count, bool normalise)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	const __m128 cols[4] = {load_xyzw(matrix.getCol0()), load_xyzw(matrix.getCol1()), load_xyzw(matrix.getCol2()), _mm_setzero_ps()};
+	const __m128 zero = _mm_setzero_ps();
+#ifdef FULGUROUS_AVX2
+	if (!normalise)
+	{
+		const __m256 cols2[4] = {_mm256_set_m128(cols[0], cols[0]), _mm256_set_m128(cols[1], cols[1]),
+								 _mm256_set_m128(cols[2], cols[2]), _mm256_setzero_ps()};
+		for (; i + 2 <= count; i += 2)
+		{
+			__m256 r = transform8(cols2, load_xyzw2(src + i), _mm256_setzero_ps());
+			store_xyz(dst + i * 3, _mm256_castps256_ps128(r));
+			store_xyz(dst + i * 3 + 3, _mm256_extractf128_ps(r, 1));
+		}
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		__m128 r = transform4(cols, load_xyzw(src[i]), zero);
+		store_xyz(dst + i * 3, normalise ? normalise3(r) : r);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		Vector3 v = matrix * src[i];
+		storeXYZ(normalise ? normalize(v) : v, dst + i * 3);
+	}
+}
+
+/**
+ * Normalise count vectors, writing xyz to dst (3 floats each)
+ */
+inline void normalise_vectors(const Vector3 *src, GLfloat *dst, size_t count)
+{
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	for (; i < count; ++i)
+		store_xyz(dst + i * 3, normalise3(load_xyzw(src[i])));
+#endif
+	for (; i < count; ++i)
+		storeXYZ(normalize(src[i]), dst + i * 3);
+}
+
+/**
+ * Bounds of count points without copying them anywhere
+ */
+inline BoundingBox compute_bounds(const Point3 *src, size_t count)
+{
+	BoundingBox bounds;
+	size_t i = 0;
+#ifdef FULGUROUS_SSE2
+	if (count > 0)
+	{
+		__m128 lower = load_xyzw(src[0]);
+		__m128 upper = lower;
+		for (i = 1; i < count; ++i)
+		{
+			__m128 p = load_xyzw(src[i]);
+			lower = _mm_min_ps(lower, p);
+			upper = _mm_max_ps(upper, p);
+		}
+		alignas(16) GLfloat lo[4], hi[4];
+		_mm_store_ps(lo, lower);
+		_mm_store_ps(hi, upper);
+		bounds.lower = Point3(lo[0], lo[1], lo[2]);
+		bounds.upper = Point3(hi[0], hi[1], hi[2]);
+	}
+#endif
+	for (; i < count; ++i)
+		bounds.extend(src[i]);
+	return bounds;
+}
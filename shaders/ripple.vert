@@ -1,14 +1,22 @@
 #version 330 core
+// already displaced, by ripple_displace.vert
 layout(location = 0) in vec3 vVertex;
-uniform mat4 MVP;
-uniform float time;
-const float amplitude = 0.125;
-const float frequency = 4;
-const float PI = 3.14159;
+// per frame values, shared with every program through one uniform buffer
+layout(std140) uniform Frame
+{
+    mat4 MVP;
+    float time;
+    vec2 viewport;
+};
+// per draw values, a range of the context's uniform ring
+layout(std140) uniform Object
+{
+    mat4 Model;
+};
+// the same depth in a depth prepass, which draws through depth_only's copy of this shader
+invariant gl_Position;
 
 void main()
 {
-    float distance = length(vVertex);
-    float y = amplitude*sin(-PI*distance*frequency+time);
-    gl_Position = MVP*vec4(vVertex.x, y, vVertex.z,1);    
+    gl_Position = MVP*Model*vec4(vVertex,1);    
 }
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+layout(location = 0) in vec3 vVertex;
+// per frame values, shared with every program through one uniform buffer
+layout(std140) uniform Frame
+{
+    mat4 MVP;
+    float time;
+    vec2 viewport;
+};
+// captured by transform feedback, once a frame, for ripple.vert to draw from
+out vec3 displaced;
+const float amplitude = 0.125;
+const float frequency = 4;
+const float PI = 3.14159;
+
+void main()
+{
+    float distance = length(vVertex);
+    float y = amplitude*sin(-PI*distance*frequency+time);
+    displaced = vec3(vVertex.x, y, vVertex.z);
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 400 core
+// the coarse plane at rest; ripple.tesc splits it up and ripple.tese displaces it
+layout(location = 0) in vec3 vVertex;
+out vec3 vPosition;
+
+void main()
+{
+    vPosition = vVertex;
+}
\ No newline at end of file
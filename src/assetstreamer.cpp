@@ -0,0 +1,218 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <gl_funcalls.h>
+#include <assetstreamer.h>
+
+AssetStreamer::AssetStreamer(JobSystem &jobs, GLsizeiptr stagingSize, GLsizeiptr bytesPerFrame)
+: jobs(jobs), queue(std::make_shared<Queue>()), staging(0), stagingSize(std::max(stagingSize, TEXTURE_BAND_SIZE)), budget(0)
+{
+    set_budget(bytesPerFrame);
+}
+
+AssetStreamer::~AssetStreamer()
+{
+    if (staging != 0)
+    {
+        gl_exec(glDeleteBuffers, 1, &staging);
+        staging = 0;
+    }
+}
+
+void AssetStreamer::set_budget(GLsizeiptr bytesPerFrame)
+{
+    // a frame can never copy more than fits in the staging buffer
+    budget = std::clamp<GLsizeiptr>(bytesPerFrame, 1, stagingSize);
+}
+
+size_t AssetStreamer::pending() const
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->incoming.size() + active.size();
+}
+
+void AssetStreamer::push(Queue &queue, Upload upload)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.incoming.push_back(std::move(upload));
+}
+
+void AssetStreamer::add_buffer_pieces(Upload &upload, std::function<GLuint()> destination)
+{
+    const GLsizeiptr size = GLsizeiptr(upload.bytes.size());
+    for (GLsizeiptr offset = 0; offset < size; offset += BUFFER_PIECE_SIZE)
+    {
+        const GLsizeiptr pieceSize = std::min(BUFFER_PIECE_SIZE, size - offset);
+        upload.pieces.push_back({offset, pieceSize, [destination, offset, pieceSize](GLintptr source) {
+                                     gl_exec(glBindBuffer, GL_COPY_WRITE_BUFFER, destination());
+                                     gl_exec(glCopyBufferSubData, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, offset, pieceSize);
+                                 }});
+    }
+}
+
+GLsizeiptr AssetStreamer::update()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        std::move(queue->incoming.begin(), queue->incoming.end(), std::back_inserter(active));
+        queue->incoming.clear();
+    }
+    if (active.empty())
+        return 0;
+
+    if (staging == 0)
+    {
+        gl_exec(glGenBuffers, 1, &staging);
+        gl_exec(glBindBuffer, GL_COPY_READ_BUFFER, staging);
+        gl_exec(glBufferData, GL_COPY_READ_BUFFER, stagingSize, nullptr, GL_STREAM_DRAW);
+    }
+    else
+    {
+        gl_exec(glBindBuffer, GL_COPY_READ_BUFFER, staging);
+    }
+
+    std::vector<std::pair<std::function<void(GLintptr)>, GLintptr>> issues;
+    std::vector<std::function<void()>> completed;
+
+    // invalidating lets the driver hand back fresh memory rather than wait for last frame's copies;
+    // flushing explicitly means only the part filled goes anywhere, traces included
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+    GLubyte *mapped = static_cast<GLubyte *>(gl_exec(glMapBufferRange, GL_COPY_READ_BUFFER, 0, stagingSize, access));
+    if (mapped == nullptr)
+    {
+        std::cerr << "Could not map the streaming buffer" << std::endl;
+        gl_exec(glBindBuffer, GL_COPY_READ_BUFFER, 0);
+        return 0;
+    }
+    GLsizeiptr used = 0;
+    bool full = false;
+    while (!active.empty() && !full)
+    {
+        Upload &upload = active.front();
+        if (!upload.created)
+        {
+            upload.create();
+            upload.created = true;
+        }
+        while (upload.next < upload.pieces.size())
+        {
+            Piece &piece = upload.pieces[upload.next];
+            // keep pieces 16 byte aligned, pixel unpacks can be picky about it
+            const GLsizeiptr start = (used + 15) & ~GLsizeiptr(15);
+            // a piece bigger than the budget still goes, on its own, so nothing starves
+            if (used > 0 && start + piece.size > budget)
+            {
+                full = true;
+                break;
+            }
+            std::memcpy(mapped + start, upload.bytes.data() + piece.offset, size_t(piece.size));
+            gl_render_stats().bytesUploaded += std::uint64_t(piece.size);
+            issues.emplace_back(std::move(piece.issue), start);
+            used = start + piece.size;
+            upload.next++;
+        }
+        if (upload.next == upload.pieces.size())
+        {
+            completed.push_back(std::move(upload.complete));
+            active.pop_front();
+        }
+    }
+    if (used > 0)
+        gl_exec(glFlushMappedBufferRange, GL_COPY_READ_BUFFER, 0, used);
+    gl_exec(glUnmapBuffer, GL_COPY_READ_BUFFER);
+
+    gl_exec(glBindBuffer, GL_PIXEL_UNPACK_BUFFER, staging);
+    for (auto &issue : issues)
+    {
+        issue.first(issue.second);
+    }
+    gl_exec(glBindBuffer, GL_PIXEL_UNPACK_BUFFER, 0);
+    gl_exec(glBindBuffer, GL_COPY_WRITE_BUFFER, 0);
+    gl_exec(glBindBuffer, GL_COPY_READ_BUFFER, 0);
+
+    // the copies are queued behind everything else, so the objects are safe to draw from now
+    for (auto &complete : completed)
+    {
+        complete();
+    }
+    return used;
+}
+
+Streamed<std::vector<GLchar>> AssetStreamer::stream_file(const std::filesystem::path &filename)
+{
+    auto promise = std::make_shared<std::promise<std::shared_ptr<std::vector<GLchar>>>>();
+    Streamed<std::vector<GLchar>> result = promise->get_future().share();
+    jobs.run([promise, filename]() {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "Could not open " << filename << std::endl;
+            promise->set_value(nullptr);
+            return;
+        }
+        auto contents = std::make_shared<std::vector<GLchar>>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        // shader sources are passed around as C strings
+        contents->push_back('\0');
+        promise->set_value(std::move(contents));
+    });
+    return result;
+}
+
+Streamed<Texture> AssetStreamer::stream_texture(const std::filesystem::path &filename, MipFilter filter, bool srgb)
+{
+    auto promise = std::make_shared<std::promise<std::shared_ptr<Texture>>>();
+    Streamed<Texture> result = promise->get_future().share();
+    std::shared_ptr<Queue> shared = queue;
+    JobSystem *workers = &jobs;
+    jobs.run([shared, promise, filename, filter, srgb, workers]() {
+        std::vector<Image> levels(1);
+        levels[0] = load_image(filename);
+        if (levels[0].empty())
+        {
+            promise->set_value(nullptr);
+            return;
+        }
+        build_mip_chain(levels, filter, srgb, workers);
+
+        Upload upload;
+        const Image &base = levels[0];
+        const GLsizei levelCount = filter == eMIP_NONE ? 1 : mip_count(base.width, base.height);
+        const GLenum internalFormat = Texture::internalFormat(base.channels, srgb);
+        const GLenum format = Texture::pixelFormat(base.channels);
+        auto texture = std::make_shared<std::shared_ptr<Texture>>();
+        upload.create = [texture, width = base.width, height = base.height, internalFormat, levelCount]() {
+            *texture = std::make_shared<Texture>(width, height, internalFormat, levelCount);
+        };
+
+        size_t total = 0;
+        for (const Image &image : levels)
+            total += image.pixels.size();
+        upload.bytes.reserve(total);
+        for (GLint level = 0; level < GLint(levels.size()); ++level)
+        {
+            const Image &image = levels[level];
+            const GLsizeiptr offset = GLsizeiptr(upload.bytes.size());
+            upload.bytes.insert(upload.bytes.end(), image.pixels.begin(), image.pixels.end());
+            // split big levels into bands of whole rows
+            const GLsizei bandRows = GLsizei(std::max<size_t>(1, size_t(TEXTURE_BAND_SIZE) / image.rowSize()));
+            for (GLsizei y = 0; y < image.height; y += bandRows)
+            {
+                const GLsizei rows = std::min(bandRows, image.height - y);
+                upload.pieces.push_back({offset + GLsizeiptr(y * image.rowSize()), GLsizeiptr(rows * image.rowSize()),
+                                         [texture, level, y, rows, format](GLintptr source) {
+                                             (*texture)->upload(level, y, rows, format, reinterpret_cast<const void *>(source));
+                                         }});
+            }
+        }
+        upload.complete = [texture, promise, filter]() {
+            if (filter == eMIP_GPU)
+                (*texture)->generateMipmaps();
+            promise->set_value(std::move(*texture));
+        };
+        push(*shared, std::move(upload));
+    });
+    return result;
+}
@@ -0,0 +1,394 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <vector>
+#include <vectormath_aos.h>
+
+using namespace Vectormath::Aos;
+
+#include <bvh.h>
+
+namespace
+{
+    constexpr int SAH_BINS = 12;
+    /* past this depth nodes are split at the median, so traversal stacks stay shallow */
+    constexpr GLuint MEDIAN_DEPTH = 48;
+    constexpr size_t STACK_SIZE = 128;
+
+    /* traversal stack on the stack, spilling to the heap in the unlikely case a tree is deeper */
+    template <typename T>
+    class TraversalStack
+    {
+    public:
+        void push(const T &value)
+        {
+            if (mSize < STACK_SIZE)
+                mFixed[mSize] = value;
+            else
+                mSpilled.push_back(value);
+            ++mSize;
+        }
+
+        T pop()
+        {
+            --mSize;
+            if (mSize < STACK_SIZE)
+                return mFixed[mSize];
+            const T value = mSpilled.back();
+            mSpilled.pop_back();
+            return value;
+        }
+
+        bool empty() const
+        {
+            return mSize == 0;
+        }
+
+    private:
+        T mFixed[STACK_SIZE];
+        std::vector<T> mSpilled;
+        size_t mSize = 0;
+    };
+
+    /* half the surface area, which is all the heuristic needs */
+    GLfloat half_area(const BoundingBox &box)
+    {
+        if (box.empty())
+            return 0.0f;
+        const Vector3 size = box.upper - box.lower;
+        return size.getX() * size.getY() + size.getY() * size.getZ() + size.getZ() * size.getX();
+    }
+
+    /* where the ray enters the box, if it does before limit */
+    bool ray_box(const GLfloat lower[3], const GLfloat upper[3], const GLfloat origin[3], const GLfloat inverse[3], GLfloat limit, GLfloat &entry)
+    {
+        GLfloat near = 0.0f;
+        GLfloat far = limit;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            GLfloat t0 = (lower[axis] - origin[axis]) * inverse[axis];
+            GLfloat t1 = (upper[axis] - origin[axis]) * inverse[axis];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            // written so a NaN from 0 * inf leaves the interval alone
+            near = t0 > near ? t0 : near;
+            far = t1 < far ? t1 : far;
+        }
+        entry = near;
+        return near <= far;
+    }
+}
+
+void BVH::build(const std::vector<BoundingBox> &boxes)
+{
+    mBoxes = boxes;
+    mNodes.clear();
+    mItems.resize(boxes.size());
+    std::iota(mItems.begin(), mItems.end(), 0u);
+    if (boxes.empty())
+        return;
+    std::vector<Point3> centres(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+        centres[i] = boxes[i].empty() ? Point3(0.0f) : boxes[i].centre();
+    // a binary tree with leaves of at least one item has fewer than 2n nodes
+    mNodes.reserve(boxes.size() * 2);
+    buildNode(0, GLuint(boxes.size()), 0, centres);
+}
+
+void BVH::fitNode(Node &node, GLuint first, GLuint count) const
+{
+    BoundingBox box;
+    for (GLuint i = first; i < first + count; ++i)
+        box.extend(mBoxes[mItems[i]]);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        node.lower[axis] = box.lower.getElem(axis);
+        node.upper[axis] = box.upper.getElem(axis);
+    }
+}
+
+GLuint BVH::buildNode(GLuint first, GLuint count, GLuint depth, std::vector<Point3> &centres)
+{
+    const GLuint index = GLuint(mNodes.size());
+    mNodes.push_back(Node{});
+    fitNode(mNodes[index], first, count);
+    mNodes[index].count = count;
+    mNodes[index].offset = first;
+    if (count <= MAX_LEAF_ITEMS)
+        return index;
+
+    BoundingBox centreBounds;
+    for (GLuint i = first; i < first + count; ++i)
+        centreBounds.extend(centres[mItems[i]]);
+
+    // binned SAH: cost of a split is each side's area times its item count
+    GLfloat bestCost = std::numeric_limits<GLfloat>::max();
+    int bestAxis = -1;
+    int bestSplit = 0;
+    for (int axis = 0; axis < 3 && depth < MEDIAN_DEPTH; ++axis)
+    {
+        const GLfloat lo = centreBounds.lower.getElem(axis);
+        const GLfloat extent = centreBounds.upper.getElem(axis) - lo;
+        if (!(extent > 0.0f))
+            continue;
+        BoundingBox bins[SAH_BINS];
+        GLuint binCounts[SAH_BINS] = {};
+        const GLfloat scale = SAH_BINS / extent;
+        for (GLuint i = first; i < first + count; ++i)
+        {
+            const GLuint item = mItems[i];
+            const int bin = std::min(SAH_BINS - 1, int((centres[item].getElem(axis) - lo) * scale));
+            bins[bin].extend(mBoxes[item]);
+            ++binCounts[bin];
+        }
+        // sweep from the right for the right hand sides, then from the left
+        GLfloat rightCost[SAH_BINS];
+        BoundingBox side;
+        GLuint sideCount = 0;
+        for (int split = SAH_BINS - 1; split > 0; --split)
+        {
+            side.extend(bins[split]);
+            sideCount += binCounts[split];
+            rightCost[split] = half_area(side) * sideCount;
+        }
+        side = BoundingBox();
+        sideCount = 0;
+        for (int split = 1; split < SAH_BINS; ++split)
+        {
+            side.extend(bins[split - 1]);
+            sideCount += binCounts[split - 1];
+            const GLfloat cost = half_area(side) * sideCount + rightCost[split];
+            if (sideCount > 0 && sideCount < count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    GLuint middle;
+    if (bestAxis >= 0)
+    {
+        const GLfloat lo = centreBounds.lower.getElem(bestAxis);
+        const GLfloat scale = SAH_BINS / (centreBounds.upper.getElem(bestAxis) - lo);
+        GLuint *split = std::partition(&mItems[first], &mItems[first] + count, [&](GLuint item) {
+            return std::min(SAH_BINS - 1, int((centres[item].getElem(bestAxis) - lo) * scale)) < bestSplit;
+        });
+        middle = GLuint(split - &mItems[0]);
+    }
+    else
+    {
+        // too deep, or every centre in the same place: halve the list along the longest axis
+        const Vector3 extent = centreBounds.upper - centreBounds.lower;
+        const int axis = extent.getX() >= extent.getY() && extent.getX() >= extent.getZ() ? 0 : extent.getY() >= extent.getZ() ? 1 : 2;
+        middle = first + count / 2;
+        std::nth_element(&mItems[first], &mItems[middle], &mItems[first] + count,
+                         [&](GLuint a, GLuint b) { return centres[a].getElem(axis) < centres[b].getElem(axis); });
+    }
+
+    buildNode(first, middle - first, depth + 1, centres);
+    const GLuint right = buildNode(middle, first + count - middle, depth + 1, centres);
+    mNodes[index].count = 0;
+    mNodes[index].offset = right;
+    return index;
+}
+
+void BVH::set(GLuint item, const BoundingBox &box)
+{
+    assert(item < mBoxes.size());
+    mBoxes[item] = box;
+}
+
+void BVH::refit()
+{
+    // children always come after their parent, so walking backwards sees them first
+    for (size_t i = mNodes.size(); i-- > 0;)
+    {
+        Node &node = mNodes[i];
+        if (node.count > 0)
+        {
+            fitNode(node, node.offset, node.count);
+            continue;
+        }
+        const Node &left = mNodes[i + 1];
+        const Node &right = mNodes[node.offset];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            node.lower[axis] = std::min(left.lower[axis], right.lower[axis]);
+            node.upper[axis] = std::max(left.upper[axis], right.upper[axis]);
+        }
+    }
+}
+
+void BVH::appendSubtree(GLuint node, std::vector<GLuint> &visible) const
+{
+    // a subtree's items are contiguous, running from its leftmost leaf to its rightmost
+    GLuint leftmost = node;
+    while (mNodes[leftmost].count == 0)
+        leftmost = leftmost + 1;
+    GLuint rightmost = node;
+    while (mNodes[rightmost].count == 0)
+        rightmost = mNodes[rightmost].offset;
+    const GLuint first = mNodes[leftmost].offset;
+    const GLuint end = mNodes[rightmost].offset + mNodes[rightmost].count;
+    for (GLuint i = first; i < end; ++i)
+    {
+        // as in a leaf straddling a plane, an item with no box is never visible
+        if (!mBoxes[mItems[i]].empty())
+            visible.push_back(mItems[i]);
+    }
+}
+
+size_t BVH::cull(const Frustum &frustum, std::vector<GLuint> &visible) const
+{
+    visible.clear();
+    if (mNodes.empty())
+        return 0;
+    GLfloat absNormals[6][3];
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+            absNormals[p][axis] = std::abs(frustum.planes[p].getElem(axis));
+    }
+
+    // clears the planes a box is wholly inside, or returns false if it is outside one
+    auto classify = [&](const GLfloat lower[3], const GLfloat upper[3], GLuint &planes) {
+        for (int p = 0; p < 6; ++p)
+        {
+            if ((planes & (1u << p)) == 0)
+                continue;
+            const Vector4 &plane = frustum.planes[p];
+            GLfloat d = plane.getW();
+            GLfloat r = 0.0f;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                d += plane.getElem(axis) * (lower[axis] + upper[axis]) * 0.5f;
+                r += absNormals[p][axis] * (upper[axis] - lower[axis]) * 0.5f;
+            }
+            if (d + r < 0.0f)
+                return false;
+            if (d - r >= 0.0f)
+                planes &= ~(1u << p);
+        }
+        return true;
+    };
+
+    // each entry carries the planes its node still straddles
+    struct Entry
+    {
+        GLuint node;
+        GLuint planes;
+    };
+    TraversalStack<Entry> stack;
+    stack.push({0, 0x3f});
+    while (!stack.empty())
+    {
+        const Entry entry = stack.pop();
+        const Node &node = mNodes[entry.node];
+        GLuint planes = entry.planes;
+        if (!classify(node.lower, node.upper, planes))
+            continue;
+        if (planes == 0)
+        {
+            appendSubtree(entry.node, visible);
+        }
+        else if (node.count > 0)
+        {
+            for (GLuint i = node.offset; i < node.offset + node.count; ++i)
+            {
+                const BoundingBox &box = mBoxes[mItems[i]];
+                if (box.empty())
+                    continue;
+                const GLfloat lower[3] = {box.lower.getX(), box.lower.getY(), box.lower.getZ()};
+                const GLfloat upper[3] = {box.upper.getX(), box.upper.getY(), box.upper.getZ()};
+                GLuint itemPlanes = planes;
+                if (classify(lower, upper, itemPlanes))
+                    visible.push_back(mItems[i]);
+            }
+        }
+        else
+        {
+            stack.push({node.offset, planes});
+            stack.push({entry.node + 1, planes});
+        }
+    }
+    return visible.size();
+}
+
+bool BVH::raycast(const Ray &ray, RayHit &hit, const ItemTest &exact) const
+{
+    if (mNodes.empty())
+        return false;
+    GLfloat origin[3], inverse[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        origin[axis] = ray.origin.getElem(axis);
+        inverse[axis] = 1.0f / ray.direction.getElem(axis);
+    }
+
+    GLfloat nearest = ray.maxDistance;
+    bool found = false;
+    TraversalStack<GLuint> stack;
+    GLfloat entry;
+    if (!ray_box(mNodes[0].lower, mNodes[0].upper, origin, inverse, nearest, entry))
+        return false;
+    stack.push(0);
+    while (!stack.empty())
+    {
+        const Node &node = mNodes[stack.pop()];
+        if (!ray_box(node.lower, node.upper, origin, inverse, nearest, entry))
+            continue;
+        if (node.count > 0)
+        {
+            for (GLuint i = node.offset; i < node.offset + node.count; ++i)
+            {
+                const GLuint item = mItems[i];
+                const BoundingBox &box = mBoxes[item];
+                if (box.empty())
+                    continue;
+                GLfloat lower[3], upper[3];
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    lower[axis] = box.lower.getElem(axis);
+                    upper[axis] = box.upper.getElem(axis);
+                }
+                if (!ray_box(lower, upper, origin, inverse, nearest, entry))
+                    continue;
+                // the box is as exact as it gets without a test
+                GLfloat distance = entry;
+                if (exact)
+                {
+                    distance = nearest;
+                    if (!exact(item, ray, distance))
+                        continue;
+                }
+                nearest = distance;
+                hit = RayHit{item, distance};
+                found = true;
+            }
+            continue;
+        }
+        // visit the nearer child first so its hits shrink the search for the other
+        const GLuint left = GLuint(&node - &mNodes[0]) + 1;
+        const GLuint right = node.offset;
+        GLfloat leftEntry, rightEntry;
+        const bool hitLeft = ray_box(mNodes[left].lower, mNodes[left].upper, origin, inverse, nearest, leftEntry);
+        const bool hitRight = ray_box(mNodes[right].lower, mNodes[right].upper, origin, inverse, nearest, rightEntry);
+        if (hitLeft && hitRight)
+        {
+            const bool leftFirst = leftEntry <= rightEntry;
+            stack.push(leftFirst ? right : left);
+            stack.push(leftFirst ? left : right);
+        }
+        else if (hitLeft)
+            stack.push(left);
+        else if (hitRight)
+            stack.push(right);
+    }
+    return found;
+}
@@ -0,0 +1,185 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <vectormath_aos.h>
+
+using namespace Vectormath::Aos;
+
+#include <simd.h>
+#include <culling.h>
+
+Frustum Frustum::from_matrix(const Matrix4 &viewProjection)
+{
+    // Gribb & Hartmann: each plane is the last row plus or minus one of the others
+    const Vector4 x = viewProjection.getRow(0);
+    const Vector4 y = viewProjection.getRow(1);
+    const Vector4 z = viewProjection.getRow(2);
+    const Vector4 w = viewProjection.getRow(3);
+    Frustum frustum;
+    frustum.planes[0] = w + x;
+    frustum.planes[1] = w - x;
+    frustum.planes[2] = w + y;
+    frustum.planes[3] = w - y;
+    frustum.planes[4] = w + z;
+    frustum.planes[5] = w - z;
+    for (Vector4 &plane : frustum.planes)
+        plane /= length(plane.getXYZ());
+    return frustum;
+}
+
+size_t CullingSet::add(const BoundingBox &box, const BoundingSphere &sphere)
+{
+    const size_t index = mCount++;
+    if (index % BATCH == 0)
+    {
+        for (std::vector<GLfloat> &stream : mStreams)
+            stream.resize(index + BATCH, 0.0f);
+    }
+    set(index, box, sphere);
+    return index;
+}
+
+size_t CullingSet::add(const BoundingBox &box)
+{
+    return add(box, BoundingSphere());
+}
+
+void CullingSet::set(size_t index, const BoundingBox &box, const BoundingSphere &sphere)
+{
+    assert(index < mCount);
+    if (box.empty())
+    {
+        // nothing to draw, so never visible
+        for (std::vector<GLfloat> &stream : mStreams)
+            stream[index] = 0.0f;
+        mStreams[eRADIUS][index] = -std::numeric_limits<GLfloat>::max();
+        return;
+    }
+    const Point3 centre = box.centre();
+    const Vector3 extents = box.extents();
+    mStreams[eCENTRE_X][index] = centre.getX();
+    mStreams[eCENTRE_Y][index] = centre.getY();
+    mStreams[eCENTRE_Z][index] = centre.getZ();
+    mStreams[eEXTENT_X][index] = extents.getX();
+    mStreams[eEXTENT_Y][index] = extents.getY();
+    mStreams[eEXTENT_Z][index] = extents.getZ();
+    // the sphere only helps if it shares the box centre; otherwise use the box's own
+    const bool concentric = !sphere.empty() && lengthSqr(sphere.centre - centre) <= 1e-6f * std::max(1.0f, lengthSqr(extents));
+    mStreams[eRADIUS][index] = concentric ? std::min(sphere.radius, length(extents)) : length(extents);
+}
+
+void CullingSet::clear()
+{
+    for (std::vector<GLfloat> &stream : mStreams)
+        stream.clear();
+    mCount = 0;
+}
+
+size_t CullingSet::cull(const Frustum &frustum, std::vector<GLuint> &visible) const
+{
+    // written branch free over whole batches, then trimmed
+    visible.resize(mStreams[eRADIUS].size());
+    size_t count = 0;
+    size_t i = 0;
+    const GLfloat *cx = mStreams[eCENTRE_X].data();
+    const GLfloat *cy = mStreams[eCENTRE_Y].data();
+    const GLfloat *cz = mStreams[eCENTRE_Z].data();
+    const GLfloat *ex = mStreams[eEXTENT_X].data();
+    const GLfloat *ey = mStreams[eEXTENT_Y].data();
+    const GLfloat *ez = mStreams[eEXTENT_Z].data();
+    const GLfloat *radius = mStreams[eRADIUS].data();
+
+#if defined(FULGUROUS_AVX2)
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 planes[6][4];
+    __m256 absNormals[6][3];
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int c = 0; c < 4; ++c)
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p].getElem(c));
+        for (int c = 0; c < 3; ++c)
+            absNormals[p][c] = _mm256_andnot_ps(signMask, planes[p][c]);
+    }
+    for (; i < mCount; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+        const __m256 hx = _mm256_loadu_ps(ex + i), hy = _mm256_loadu_ps(ey + i), hz = _mm256_loadu_ps(ez + i);
+        const __m256 r = _mm256_loadu_ps(radius + i);
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; ++p)
+        {
+            // plain multiply and add: the AVX2 build flags do not promise FMA
+            __m256 d = _mm256_add_ps(_mm256_mul_ps(planes[p][0], x), planes[p][3]);
+            d = _mm256_add_ps(d, _mm256_mul_ps(planes[p][1], y));
+            d = _mm256_add_ps(d, _mm256_mul_ps(planes[p][2], z));
+            __m256 boxRadius = _mm256_mul_ps(absNormals[p][0], hx);
+            boxRadius = _mm256_add_ps(boxRadius, _mm256_mul_ps(absNormals[p][1], hy));
+            boxRadius = _mm256_add_ps(boxRadius, _mm256_mul_ps(absNormals[p][2], hz));
+            // d < -r  <=>  d + r < 0
+            const __m256 reach = _mm256_add_ps(d, _mm256_min_ps(r, boxRadius));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(reach, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        const int mask = ~_mm256_movemask_ps(outside) & 0xff;
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            visible[count] = GLuint(i + lane);
+            count += (mask >> lane) & 1;
+        }
+    }
+#elif defined(FULGUROUS_SSE2)
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 planes[6][4];
+    __m128 absNormals[6][3];
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int c = 0; c < 4; ++c)
+            planes[p][c] = _mm_set1_ps(frustum.planes[p].getElem(c));
+        for (int c = 0; c < 3; ++c)
+            absNormals[p][c] = _mm_andnot_ps(signMask, planes[p][c]);
+    }
+    for (; i < mCount; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+        const __m128 hx = _mm_loadu_ps(ex + i), hy = _mm_loadu_ps(ey + i), hz = _mm_loadu_ps(ez + i);
+        const __m128 r = _mm_loadu_ps(radius + i);
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 d = _mm_add_ps(_mm_mul_ps(planes[p][0], x), planes[p][3]);
+            d = _mm_add_ps(d, _mm_mul_ps(planes[p][1], y));
+            d = _mm_add_ps(d, _mm_mul_ps(planes[p][2], z));
+            __m128 boxRadius = _mm_mul_ps(absNormals[p][0], hx);
+            boxRadius = _mm_add_ps(boxRadius, _mm_mul_ps(absNormals[p][1], hy));
+            boxRadius = _mm_add_ps(boxRadius, _mm_mul_ps(absNormals[p][2], hz));
+            const __m128 reach = _mm_add_ps(d, _mm_min_ps(r, boxRadius));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(reach, _mm_setzero_ps()));
+        }
+        const int mask = ~_mm_movemask_ps(outside) & 0xf;
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            visible[count] = GLuint(i + lane);
+            count += (mask >> lane) & 1;
+        }
+    }
+#endif
+    for (; i < mCount; ++i)
+    {
+        bool inside = true;
+        for (const Vector4 &plane : frustum.planes)
+        {
+            const GLfloat d = plane.getX() * cx[i] + plane.getY() * cy[i] + plane.getZ() * cz[i] + plane.getW();
+            const GLfloat boxRadius = std::abs(plane.getX()) * ex[i] + std::abs(plane.getY()) * ey[i] + std::abs(plane.getZ()) * ez[i];
+            inside = inside && d + std::min(radius[i], boxRadius) >= 0.0f;
+        }
+        visible[count] = GLuint(i);
+        count += inside ? 1 : 0;
+    }
+    // the padding lanes of the last batch can come out visible; drop them
+    while (count > 0 && visible[count - 1] >= mCount)
+        --count;
+    visible.resize(count);
+    return count;
+}
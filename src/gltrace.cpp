@@ -0,0 +1,951 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <gl_funcalls.h>
+#include <gltrace.h>
+
+namespace
+{
+    /* what a call's pointer arguments point at */
+    enum Rule : GLuint
+    {
+        /* any pointers are offsets into bound buffers */
+        eCALL,
+        /* the same, but only kept in the chosen frames */
+        eDRAW,
+        /* every pointer is written by GL; only kept in the chosen frames */
+        eQUERY,
+        /* params[0] points at params[1] (or with -1, one) * params[2] bytes; other pointers are written by GL */
+        eBLOB,
+        /* glClearBuffer*v: params[0] points at four values of params[1] bytes for GL_COLOR, one for depth or stencil */
+        eCLEAR,
+        /* params[0] names are written to params[1], recorded after the call to check replay against */
+        eGEN,
+        /* params[0] strings at params[1], lengths at params[2] if it is not -1 */
+        eSTRINGS,
+        /* params[0] points at one terminated string */
+        eSTRING,
+        /* params[0] points at pixels of width params[1], height params[2], depth params[3] if not -1, format params[4], type params[5] */
+        ePIXELS,
+        /* returns an object name to check replay against */
+        eCREATE,
+        /* glMapBufferRange; what is written through the mapping is recorded as it is flushed, or at unmap */
+        eMAP,
+        /* glFlushMappedBufferRange */
+        eFLUSH,
+        eUNMAP,
+        /* left out of traces */
+        eSKIP
+    };
+
+    /* how each argument is stored */
+    enum ArgKind : GLubyte
+    {
+        eARG_INTEGER = 0,
+        eARG_FLOAT,
+        eARG_NULL,
+        /* a pointer kept as is, being an offset */
+        eARG_ADDRESS,
+        eARG_BLOB,
+        /* somewhere for GL to write to */
+        eARG_OUTPUT,
+        eARG_STRINGS,
+        /* the lengths of the eARG_STRINGS argument */
+        eARG_LENGTHS
+    };
+
+    /* record codes below the first function's */
+    enum Code : GLuint
+    {
+        eCODE_FRAME = 0,
+        eCODE_MAPPED_WRITE = 1,
+        eCODE_FIRST_FUNCTION = 2
+    };
+
+    const GLubyte MAGIC[4] = {'F', 'G', 'L', 'T'};
+    /* 2: mapped writes carry their offset into the mapping */
+    constexpr GLuint VERSION = 2;
+    /* room replay gives GL for any query's answer or info log, and for generated names */
+    constexpr size_t SCRATCH_BYTES = 1 << 20;
+
+    template <typename T>
+    T from_value(std::uint64_t value)
+    {
+        if constexpr (std::is_pointer<T>::value)
+        {
+            return reinterpret_cast<T>(std::uintptr_t(value));
+        }
+        else if constexpr (std::is_floating_point<T>::value)
+        {
+            double wide;
+            std::memcpy(&wide, &value, sizeof(wide));
+            return T(wide);
+        }
+        else
+        {
+            return T(value);
+        }
+    }
+
+    /* calls an entry point of type Function with arguments decoded from trace values */
+    template <typename Function>
+    struct Invoker;
+
+    template <typename Result, typename... Args>
+    struct Invoker<Result (APIENTRY *)(Args...)>
+    {
+        using Function = Result (APIENTRY *)(Args...);
+
+        static std::uint64_t call(const void *address, const std::uint64_t *values)
+        {
+            return apply(reinterpret_cast<Function>(const_cast<void *>(address)), values, std::index_sequence_for<Args...>{});
+        }
+
+        template <size_t... I>
+        static std::uint64_t apply(Function function, const std::uint64_t *values, std::index_sequence<I...>)
+        {
+            if constexpr (std::is_void<Result>::value)
+            {
+                function(from_value<Args>(values[I])...);
+                return 0;
+            }
+            else
+            {
+                return gl_trace_value(function(from_value<Args>(values[I])...));
+            }
+        }
+    };
+
+    constexpr GLuint MAX_ARGS = 16;
+}
+
+struct GLTraceFunction
+{
+    const char *name;
+    Rule rule;
+    int params[6];
+    /* read when needed, as glad only fills the pointers in once there is a context */
+    const void *(*address)();
+    std::uint64_t (*invoke)(const void *address, const std::uint64_t *values);
+};
+
+#define GL_TRACE_FUNCTION(function, rule, ...) \
+    {#function, rule, {__VA_ARGS__}, []() { return reinterpret_cast<const void *>(function); }, &Invoker<decltype(function)>::call}
+
+/* every entry point the library calls through gl_exec; others are skipped with a warning */
+static const GLTraceFunction trace_functions[] = {
+    GL_TRACE_FUNCTION(glActiveTexture, eCALL),
+    GL_TRACE_FUNCTION(glAttachShader, eCALL),
+    GL_TRACE_FUNCTION(glBeginQuery, eCALL),
+    GL_TRACE_FUNCTION(glBeginTransformFeedback, eCALL),
+    GL_TRACE_FUNCTION(glBindAttribLocation, eSTRING, 2),
+    GL_TRACE_FUNCTION(glBindBuffer, eCALL),
+    GL_TRACE_FUNCTION(glBindBufferBase, eCALL),
+    GL_TRACE_FUNCTION(glBindBufferRange, eCALL),
+    GL_TRACE_FUNCTION(glBindFramebuffer, eCALL),
+    GL_TRACE_FUNCTION(glBindImageTexture, eCALL),
+    GL_TRACE_FUNCTION(glBindTexture, eCALL),
+    GL_TRACE_FUNCTION(glBindVertexArray, eCALL),
+    GL_TRACE_FUNCTION(glBlendFunc, eCALL),
+    GL_TRACE_FUNCTION(glBlendFuncSeparate, eCALL),
+    GL_TRACE_FUNCTION(glBufferData, eBLOB, 2, 1, 1),
+    GL_TRACE_FUNCTION(glBufferStorage, eBLOB, 2, 1, 1),
+    GL_TRACE_FUNCTION(glBufferSubData, eBLOB, 3, 2, 1),
+    GL_TRACE_FUNCTION(glCheckFramebufferStatus, eCALL),
+    GL_TRACE_FUNCTION(glClear, eDRAW),
+    GL_TRACE_FUNCTION(glClearBufferfi, eCALL),
+    GL_TRACE_FUNCTION(glClearBufferfv, eCLEAR, 2, 4),
+    GL_TRACE_FUNCTION(glClearColor, eCALL),
+    GL_TRACE_FUNCTION(glClientWaitSync, eSKIP),
+    GL_TRACE_FUNCTION(glColorMask, eCALL),
+    GL_TRACE_FUNCTION(glCompileShader, eCALL),
+    GL_TRACE_FUNCTION(glCopyBufferSubData, eCALL),
+    GL_TRACE_FUNCTION(glCreateProgram, eCREATE),
+    GL_TRACE_FUNCTION(glCreateShader, eCREATE),
+    GL_TRACE_FUNCTION(glCullFace, eCALL),
+    GL_TRACE_FUNCTION(glDeleteBuffers, eBLOB, 1, 0, 4),
+    GL_TRACE_FUNCTION(glDeleteFramebuffers, eBLOB, 1, 0, 4),
+    GL_TRACE_FUNCTION(glDeleteProgram, eCALL),
+    GL_TRACE_FUNCTION(glDeleteQueries, eBLOB, 1, 0, 4),
+    GL_TRACE_FUNCTION(glDeleteShader, eCALL),
+    GL_TRACE_FUNCTION(glDeleteSync, eSKIP),
+    GL_TRACE_FUNCTION(glDeleteTextures, eBLOB, 1, 0, 4),
+    GL_TRACE_FUNCTION(glDeleteVertexArrays, eBLOB, 1, 0, 4),
+    GL_TRACE_FUNCTION(glDepthFunc, eCALL),
+    GL_TRACE_FUNCTION(glDepthMask, eCALL),
+    GL_TRACE_FUNCTION(glDetachShader, eCALL),
+    GL_TRACE_FUNCTION(glDisable, eCALL),
+    GL_TRACE_FUNCTION(glDisableVertexAttribArray, eCALL),
+    GL_TRACE_FUNCTION(glDispatchCompute, eDRAW),
+    GL_TRACE_FUNCTION(glDrawArrays, eDRAW),
+    GL_TRACE_FUNCTION(glDrawBuffer, eCALL),
+    GL_TRACE_FUNCTION(glDrawBuffers, eBLOB, 1, 0, 4),
+    GL_TRACE_FUNCTION(glDrawArraysInstanced, eDRAW),
+    GL_TRACE_FUNCTION(glDrawElements, eDRAW),
+    GL_TRACE_FUNCTION(glDrawElementsBaseVertex, eDRAW),
+    GL_TRACE_FUNCTION(glDrawElementsInstanced, eDRAW),
+    GL_TRACE_FUNCTION(glEnable, eCALL),
+    GL_TRACE_FUNCTION(glEnableVertexAttribArray, eCALL),
+    GL_TRACE_FUNCTION(glEndQuery, eCALL),
+    GL_TRACE_FUNCTION(glEndTransformFeedback, eCALL),
+    GL_TRACE_FUNCTION(glFenceSync, eSKIP),
+    GL_TRACE_FUNCTION(glFlushMappedBufferRange, eFLUSH),
+    GL_TRACE_FUNCTION(glFramebufferTexture2D, eCALL),
+    GL_TRACE_FUNCTION(glFrontFace, eCALL),
+    GL_TRACE_FUNCTION(glGenBuffers, eGEN, 0, 1),
+    GL_TRACE_FUNCTION(glGenFramebuffers, eGEN, 0, 1),
+    GL_TRACE_FUNCTION(glGenQueries, eGEN, 0, 1),
+    GL_TRACE_FUNCTION(glGenTextures, eGEN, 0, 1),
+    GL_TRACE_FUNCTION(glGenVertexArrays, eGEN, 0, 1),
+    GL_TRACE_FUNCTION(glGenerateMipmap, eCALL),
+    GL_TRACE_FUNCTION(glGetActiveAttrib, eQUERY),
+    GL_TRACE_FUNCTION(glGetActiveUniform, eQUERY),
+    GL_TRACE_FUNCTION(glGetActiveUniformBlockName, eQUERY),
+    GL_TRACE_FUNCTION(glGetActiveUniformBlockiv, eQUERY),
+    GL_TRACE_FUNCTION(glGetActiveUniformName, eQUERY),
+    GL_TRACE_FUNCTION(glGetActiveUniformsiv, eBLOB, 2, 1, 4),
+    GL_TRACE_FUNCTION(glGetBooleanv, eQUERY),
+    GL_TRACE_FUNCTION(glGetFloatv, eQUERY),
+    GL_TRACE_FUNCTION(glGetInteger64i_v, eQUERY),
+    GL_TRACE_FUNCTION(glGetIntegeri_v, eQUERY),
+    GL_TRACE_FUNCTION(glGetIntegerv, eQUERY),
+    GL_TRACE_FUNCTION(glGetProgramInfoLog, eQUERY),
+    GL_TRACE_FUNCTION(glGetProgramInterfaceiv, eQUERY),
+    GL_TRACE_FUNCTION(glGetProgramResourceName, eQUERY),
+    GL_TRACE_FUNCTION(glGetProgramiv, eQUERY),
+    GL_TRACE_FUNCTION(glGetQueryObjectiv, eQUERY),
+    GL_TRACE_FUNCTION(glGetQueryObjectuiv, eQUERY),
+    GL_TRACE_FUNCTION(glGetShaderInfoLog, eQUERY),
+    GL_TRACE_FUNCTION(glGetShaderiv, eQUERY),
+    GL_TRACE_FUNCTION(glIsEnabled, eQUERY),
+    GL_TRACE_FUNCTION(glLinkProgram, eCALL),
+    GL_TRACE_FUNCTION(glMapBufferRange, eMAP),
+    GL_TRACE_FUNCTION(glMemoryBarrier, eCALL),
+    GL_TRACE_FUNCTION(glPatchParameteri, eCALL),
+    GL_TRACE_FUNCTION(glPixelStorei, eCALL),
+    GL_TRACE_FUNCTION(glScissor, eCALL),
+    GL_TRACE_FUNCTION(glShaderSource, eSTRINGS, 1, 2, 3),
+    GL_TRACE_FUNCTION(glShaderStorageBlockBinding, eCALL),
+    GL_TRACE_FUNCTION(glStencilFuncSeparate, eCALL),
+    GL_TRACE_FUNCTION(glStencilMaskSeparate, eCALL),
+    GL_TRACE_FUNCTION(glStencilOpSeparate, eCALL),
+    GL_TRACE_FUNCTION(glTexImage2D, ePIXELS, 8, 3, 4, -1, 6, 7),
+    GL_TRACE_FUNCTION(glTexImage3D, ePIXELS, 9, 3, 4, 5, 7, 8),
+    GL_TRACE_FUNCTION(glTexParameterf, eCALL),
+    GL_TRACE_FUNCTION(glTexParameteri, eCALL),
+    GL_TRACE_FUNCTION(glTexStorage2D, eCALL),
+    GL_TRACE_FUNCTION(glTexStorage3D, eCALL),
+    GL_TRACE_FUNCTION(glTexSubImage2D, ePIXELS, 8, 4, 5, -1, 6, 7),
+    GL_TRACE_FUNCTION(glTexSubImage3D, ePIXELS, 10, 5, 6, 7, 8, 9),
+    GL_TRACE_FUNCTION(glTransformFeedbackVaryings, eSTRINGS, 1, 2, -1),
+    GL_TRACE_FUNCTION(glUniform1f, eCALL),
+    GL_TRACE_FUNCTION(glUniform1i, eCALL),
+    GL_TRACE_FUNCTION(glUniform3fv, eBLOB, 2, 1, 12),
+    GL_TRACE_FUNCTION(glUniform4fv, eBLOB, 2, 1, 16),
+    GL_TRACE_FUNCTION(glUniformBlockBinding, eCALL),
+    GL_TRACE_FUNCTION(glUniformMatrix3fv, eBLOB, 3, 1, 36),
+    GL_TRACE_FUNCTION(glUniformMatrix4fv, eBLOB, 3, 1, 64),
+    GL_TRACE_FUNCTION(glUnmapBuffer, eUNMAP),
+    GL_TRACE_FUNCTION(glUseProgram, eCALL),
+    GL_TRACE_FUNCTION(glVertexAttribDivisor, eCALL),
+    GL_TRACE_FUNCTION(glVertexAttribIPointer, eCALL),
+    GL_TRACE_FUNCTION(glVertexAttribPointer, eCALL),
+    GL_TRACE_FUNCTION(glViewport, eCALL),
+};
+
+#undef GL_TRACE_FUNCTION
+
+static constexpr GLuint trace_function_count = GLuint(sizeof(trace_functions) / sizeof(trace_functions[0]));
+
+/* bytes of client memory a pixel transfer reads, under the current unpack state */
+static size_t pixel_bytes(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type)
+{
+    size_t channels;
+    switch (format)
+    {
+    case GL_RG:
+    case GL_RG_INTEGER:
+        channels = 2;
+        break;
+    case GL_RGB:
+    case GL_BGR:
+    case GL_RGB_INTEGER:
+        channels = 3;
+        break;
+    case GL_RGBA:
+    case GL_BGRA:
+    case GL_RGBA_INTEGER:
+        channels = 4;
+        break;
+    default:
+        channels = 1;
+        break;
+    }
+    size_t pixel;
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+        pixel = channels;
+        break;
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_HALF_FLOAT:
+        pixel = channels * 2;
+        break;
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+        pixel = 2;
+        break;
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_FLOAT:
+        pixel = channels * 4;
+        break;
+    default:
+        // the packed 32 bit types
+        pixel = 4;
+        break;
+    }
+    GLint alignment = 4, rowLength = 0, imageHeight = 0;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &rowLength);
+    glGetIntegerv(GL_UNPACK_IMAGE_HEIGHT, &imageHeight);
+    alignment = std::max(alignment, 1);
+    const size_t row = (size_t(rowLength > 0 ? rowLength : width) * pixel + alignment - 1) / alignment * alignment;
+    const size_t rows = size_t(imageHeight > 0 ? imageHeight : height);
+    // the last row is only as long as it needs to be
+    return row * (rows * size_t(depth - 1) + size_t(height - 1)) + size_t(width) * pixel;
+}
+
+/* values a glClearBuffer*v call reads for buffer */
+static size_t clear_values(GLenum buffer)
+{
+    return (buffer == GL_COLOR) ? 4 : 1;
+}
+
+static std::uint64_t zigzag(std::uint64_t value)
+{
+    const std::int64_t signedValue = std::int64_t(value);
+    return (std::uint64_t(signedValue) << 1) ^ std::uint64_t(signedValue >> 63);
+}
+
+static std::uint64_t unzigzag(std::uint64_t value)
+{
+    return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+GLTraceWriter::GLTraceWriter(const std::filesystem::path &file, GLuint firstFrame, GLuint lastFrame)
+: mFile(file, std::ios::binary), mFrame(0), mFirstFrame(firstFrame), mLastFrame(std::max(firstFrame, lastFrame))
+{
+    if (!mFile.is_open())
+    {
+        std::cerr << "Could not open trace " << file.string() << std::endl;
+        return;
+    }
+    mBuffer.insert(mBuffer.end(), std::begin(MAGIC), std::end(MAGIC));
+    writeVarint(VERSION);
+    writeVarint(trace_function_count);
+    for (GLuint index = 0; index < trace_function_count; ++index)
+    {
+        const GLTraceFunction &function = trace_functions[index];
+        writeBlob(function.name, std::strlen(function.name));
+        // entry points the driver lacks are all null, and never called
+        if (function.address() != nullptr)
+            mIndices.emplace(function.address(), index);
+    }
+    flush();
+}
+
+GLTraceWriter::~GLTraceWriter()
+{
+    flush();
+}
+
+void GLTraceWriter::writeVarint(std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        mBuffer.push_back(GLubyte(value | 0x80));
+        value >>= 7;
+    }
+    mBuffer.push_back(GLubyte(value));
+}
+
+void GLTraceWriter::writeBlob(const void *data, size_t size)
+{
+    writeVarint(size);
+    const GLubyte *bytes = static_cast<const GLubyte *>(data);
+    mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+}
+
+void GLTraceWriter::writeMappedWrite(std::uint64_t target, GLintptr offset, const GLubyte *data, GLsizeiptr length)
+{
+    writeVarint(eCODE_MAPPED_WRITE);
+    writeVarint(target);
+    writeVarint(std::uint64_t(offset));
+    writeBlob(data, size_t(length));
+}
+
+void GLTraceWriter::flush()
+{
+    if (mFile.is_open() && !mBuffer.empty())
+    {
+        mFile.write(reinterpret_cast<const char *>(mBuffer.data()), std::streamsize(mBuffer.size()));
+        mBuffer.clear();
+    }
+}
+
+void GLTraceWriter::recordCall(const void *address, GLuint argCount, const std::uint64_t *values, const GLTraceArgType *types, std::uint64_t result)
+{
+    auto found = mIndices.find(address);
+    if (found == mIndices.end())
+    {
+        if (mUnknown.insert(address).second)
+            std::cerr << "Trace leaves out calls to the GL entry point at " << address << std::endl;
+        return;
+    }
+    const GLTraceFunction &function = trace_functions[found->second];
+    const bool kept = mFrame >= mFirstFrame;
+    if ((function.rule == eSKIP) || (!kept && ((function.rule == eDRAW) || (function.rule == eQUERY))))
+        return;
+    const int *params = function.params;
+
+    if ((function.rule == eFLUSH) || (function.rule == eUNMAP))
+    {
+        // what was written through the mapping goes first, for replay to write through its own
+        auto mapping = mMappings.find(values[0]);
+        if (mapping != mMappings.end())
+        {
+            const Mapping &written = mapping->second;
+            if (function.rule == eFLUSH)
+            {
+                const GLintptr offset = GLintptr(values[1]);
+                const GLsizeiptr length = GLsizeiptr(values[2]);
+                if (written.explicitFlush && (offset >= 0) && (length > 0) && (offset + length <= written.length))
+                    writeMappedWrite(values[0], offset, written.data + offset, length);
+            }
+            else
+            {
+                // explicitly flushed mappings went up a range at a time; otherwise GL takes the whole range as written
+                if (!written.explicitFlush)
+                    writeMappedWrite(values[0], 0, written.data, written.length);
+                mMappings.erase(mapping);
+            }
+        }
+    }
+
+    writeVarint(eCODE_FIRST_FUNCTION + found->second);
+    writeVarint(argCount);
+    for (GLuint arg = 0; arg < argCount; ++arg)
+    {
+        const std::uint64_t value = values[arg];
+        if (types[arg] == eTRACE_FLOAT)
+        {
+            mBuffer.push_back(eARG_FLOAT);
+            const GLubyte *bytes = reinterpret_cast<const GLubyte *>(&value);
+            mBuffer.insert(mBuffer.end(), bytes, bytes + sizeof(value));
+            continue;
+        }
+        if (types[arg] == eTRACE_INTEGER)
+        {
+            mBuffer.push_back(eARG_INTEGER);
+            writeVarint(zigzag(value));
+            continue;
+        }
+        if (value == 0)
+        {
+            mBuffer.push_back(eARG_NULL);
+            continue;
+        }
+        const void *pointer = reinterpret_cast<const void *>(std::uintptr_t(value));
+        switch (function.rule)
+        {
+        case eBLOB:
+            if (int(arg) == params[0])
+            {
+                mBuffer.push_back(eARG_BLOB);
+                writeBlob(pointer, size_t(params[1] >= 0 ? values[params[1]] : 1) * size_t(params[2]));
+            }
+            else
+            {
+                mBuffer.push_back(eARG_OUTPUT);
+            }
+            break;
+        case eCLEAR:
+            if (int(arg) == params[0])
+            {
+                mBuffer.push_back(eARG_BLOB);
+                writeBlob(pointer, clear_values(GLenum(values[0])) * size_t(params[1]));
+            }
+            else
+            {
+                mBuffer.push_back(eARG_OUTPUT);
+            }
+            break;
+        case eGEN:
+            // written by the call, and recorded to check replay gets the same names
+            mBuffer.push_back(eARG_BLOB);
+            writeBlob(pointer, size_t(values[params[0]]) * sizeof(GLuint));
+            break;
+        case eSTRINGS:
+            if (int(arg) == params[1])
+            {
+                const GLsizei count = GLsizei(values[params[0]]);
+                const GLchar *const *strings = static_cast<const GLchar *const *>(pointer);
+                const GLint *lengths = (params[2] >= 0) ? reinterpret_cast<const GLint *>(std::uintptr_t(values[params[2]])) : nullptr;
+                mBuffer.push_back(eARG_STRINGS);
+                writeVarint(GLuint(count));
+                for (GLsizei i = 0; i < count; ++i)
+                {
+                    const size_t length = (lengths != nullptr && lengths[i] >= 0) ? size_t(lengths[i]) : std::strlen(strings[i]);
+                    writeBlob(strings[i], length);
+                    // terminated, so replay can hand them straight back
+                    mBuffer.push_back(0);
+                }
+            }
+            else if (int(arg) == params[2])
+            {
+                mBuffer.push_back(eARG_LENGTHS);
+            }
+            else
+            {
+                mBuffer.push_back(eARG_OUTPUT);
+            }
+            break;
+        case eSTRING:
+            if (int(arg) == params[0])
+            {
+                // the terminator too, so replay can hand it straight back
+                mBuffer.push_back(eARG_BLOB);
+                writeBlob(pointer, std::strlen(static_cast<const char *>(pointer)) + 1);
+            }
+            else
+            {
+                mBuffer.push_back(eARG_OUTPUT);
+            }
+            break;
+        case ePIXELS:
+            if (int(arg) == params[0])
+            {
+                GLint unpackBuffer = 0;
+                glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+                if (unpackBuffer != 0)
+                {
+                    // an offset into the bound pixel buffer
+                    mBuffer.push_back(eARG_ADDRESS);
+                    writeVarint(value);
+                }
+                else
+                {
+                    const GLsizei depth = (params[3] >= 0) ? GLsizei(values[params[3]]) : 1;
+                    mBuffer.push_back(eARG_BLOB);
+                    writeBlob(pointer, pixel_bytes(GLsizei(values[params[1]]), GLsizei(values[params[2]]), depth, GLenum(values[params[4]]),
+                                                   GLenum(values[params[5]])));
+                }
+            }
+            else
+            {
+                mBuffer.push_back(eARG_OUTPUT);
+            }
+            break;
+        case eQUERY:
+            mBuffer.push_back(eARG_OUTPUT);
+            break;
+        default:
+            mBuffer.push_back(eARG_ADDRESS);
+            writeVarint(value);
+            break;
+        }
+    }
+    if ((function.rule == eCREATE) || (function.rule == eMAP))
+    {
+        writeVarint(result);
+    }
+    if ((function.rule == eMAP) && (result != 0) && ((values[3] & GL_MAP_WRITE_BIT) != 0))
+    {
+        mMappings[values[0]] = Mapping{reinterpret_cast<const GLubyte *>(std::uintptr_t(result)), GLsizeiptr(values[2]), (values[3] & GL_MAP_FLUSH_EXPLICIT_BIT) != 0};
+    }
+}
+
+bool GLTraceWriter::endFrame()
+{
+    writeVarint(eCODE_FRAME);
+    writeVarint(mFrame);
+    mBuffer.push_back(mFrame >= mFirstFrame ? 1 : 0);
+    flush();
+    ++mFrame;
+    return mFrame <= mLastFrame;
+}
+
+void gl_trace_from_environment()
+{
+    const char *file = std::getenv("FULGUROUS_TRACE");
+    if ((file == nullptr) || (*file == 0) || (gl_trace() != nullptr))
+        return;
+    GLuint firstFrame = 0, lastFrame = ~0u;
+    if (const char *frames = std::getenv("FULGUROUS_TRACE_FRAMES"))
+    {
+        char *end = nullptr;
+        firstFrame = GLuint(std::strtoul(frames, &end, 10));
+        lastFrame = (*end == '-') ? GLuint(std::strtoul(end + 1, nullptr, 10)) : firstFrame;
+    }
+    GLTraceWriter *trace = new GLTraceWriter(file, firstFrame, lastFrame);
+    if (!trace->isOpen())
+    {
+        delete trace;
+        return;
+    }
+    std::cout << "Tracing GL calls to " << file << ", keeping frames " << firstFrame << " to " << lastFrame << std::endl;
+    gl_trace() = trace;
+}
+
+void gl_trace_stop()
+{
+    GLTraceWriter *trace = gl_trace();
+    // nothing goes to it while it closes
+    gl_trace() = nullptr;
+    delete trace;
+}
+
+const char *gl_function_name(const void *function)
+{
+    // only asked on errors, by then glad has filled the pointers in
+    static const std::unordered_map<const void *, const char *> names = []() {
+        std::unordered_map<const void *, const char *> byAddress;
+        for (const GLTraceFunction &entry : trace_functions)
+        {
+            if (entry.address() != nullptr)
+                byAddress.emplace(entry.address(), entry.name);
+        }
+        return byAddress;
+    }();
+    auto found = names.find(function);
+    return (found != names.end()) ? found->second : nullptr;
+}
+
+bool GLTraceReplay::readVarint(size_t &offset, std::uint64_t &value) const
+{
+    value = 0;
+    for (GLuint shift = 0; (offset < mTrace.size()) && (shift < 64); shift += 7)
+    {
+        const GLubyte byte = mTrace[offset++];
+        value |= std::uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool GLTraceReplay::open(const std::filesystem::path &file)
+{
+    std::ifstream input(file, std::ios::binary);
+    if (!input.is_open())
+    {
+        std::cerr << "Could not open trace " << file.string() << std::endl;
+        return false;
+    }
+    mTrace.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    if ((mTrace.size() < sizeof(MAGIC)) || (std::memcmp(mTrace.data(), MAGIC, sizeof(MAGIC)) != 0))
+    {
+        std::cerr << file.string() << " is not a trace" << std::endl;
+        return false;
+    }
+    size_t offset = sizeof(MAGIC);
+    std::uint64_t version = 0;
+    if (!readVarint(offset, version) || (version != VERSION))
+    {
+        std::cerr << file.string() << " is from another version of the tracer" << std::endl;
+        return false;
+    }
+    std::uint64_t count = 0;
+    // every name takes at least its length's byte
+    if (!readVarint(offset, count) || !fits(offset, size_t(count)))
+    {
+        std::cerr << file.string() << " is cut short" << std::endl;
+        return false;
+    }
+    mFunctions.assign(size_t(count), nullptr);
+    mNames.resize(size_t(count));
+    for (size_t index = 0; index < count; ++index)
+    {
+        std::uint64_t length = 0;
+        if (!readVarint(offset, length) || !fits(offset, size_t(length)))
+        {
+            std::cerr << file.string() << " is cut short" << std::endl;
+            return false;
+        }
+        mNames[index].assign(reinterpret_cast<const char *>(mTrace.data() + offset), size_t(length));
+        offset += size_t(length);
+        // by name, so traces outlive changes to the table
+        for (const GLTraceFunction &function : trace_functions)
+        {
+            if (mNames[index] == function.name)
+                mFunctions[index] = &function;
+        }
+        if (mFunctions[index] == nullptr)
+            std::cerr << "Replay will skip " << mNames[index] << std::endl;
+    }
+    mFirstRecord = offset;
+
+    // the kept frames start after the last marker of a frame that was not kept; every record is checked here, so run can trust them
+    mKeptStart = mKeptEnd = mFirstRecord;
+    while (offset < mTrace.size())
+    {
+        const size_t record = offset;
+        if (!step(offset, false, false))
+        {
+            std::cerr << file.string() << " is cut short or corrupt at byte " << record << std::endl;
+            return false;
+        }
+        if (mAtMarker)
+        {
+            if (mMarkerKept)
+                mKeptEnd = offset;
+            else
+                mKeptStart = mKeptEnd = offset;
+        }
+    }
+    mCallCounts.assign(size_t(count), 0);
+    mCallSeconds.assign(size_t(count), 0.0);
+    return true;
+}
+
+bool GLTraceReplay::step(size_t &offset, bool execute, bool timed)
+{
+    mAtMarker = false;
+    std::uint64_t code = 0;
+    if (!readVarint(offset, code))
+        return false;
+    if (code == eCODE_FRAME)
+    {
+        std::uint64_t frame = 0;
+        if (!readVarint(offset, frame) || !fits(offset, 1))
+            return false;
+        mAtMarker = true;
+        mMarkerFrame = GLuint(frame);
+        mMarkerKept = mTrace[offset++] != 0;
+        return true;
+    }
+    if (code == eCODE_MAPPED_WRITE)
+    {
+        std::uint64_t target = 0, at = 0, length = 0;
+        if (!readVarint(offset, target) || !readVarint(offset, at) || !readVarint(offset, length) || !fits(offset, size_t(length)))
+            return false;
+        auto mapped = mMapped.find(target);
+        // a mapping that failed or came back smaller here is left alone
+        if (execute && (mapped != mMapped.end()) && (mapped->second.data != nullptr) && (at <= std::uint64_t(mapped->second.length)) &&
+            (length <= std::uint64_t(mapped->second.length) - at))
+            std::memcpy(mapped->second.data + at, mTrace.data() + offset, size_t(length));
+        offset += size_t(length);
+        return true;
+    }
+
+    const size_t index = size_t(code - eCODE_FIRST_FUNCTION);
+    if (index >= mFunctions.size())
+        return false;
+    const GLTraceFunction *function = mFunctions[index];
+    std::uint64_t argCount = 0;
+    if (!readVarint(offset, argCount) || (argCount > MAX_ARGS))
+        return false;
+    std::uint64_t values[MAX_ARGS] = {};
+    // the last blob argument, for the checks against what the rule says GL reads
+    size_t blobArg = MAX_ARGS, blobLength = 0;
+    const GLubyte *blob = nullptr;
+    const GLubyte *generated = nullptr;
+    mStrings.clear();
+    mLengths.clear();
+    for (GLuint arg = 0; arg < argCount; ++arg)
+    {
+        if (!fits(offset, 1))
+            return false;
+        const GLubyte kind = mTrace[offset++];
+        std::uint64_t value = 0;
+        switch (kind)
+        {
+        case eARG_INTEGER:
+            if (!readVarint(offset, value))
+                return false;
+            value = unzigzag(value);
+            break;
+        case eARG_FLOAT:
+            if (!fits(offset, sizeof(value)))
+                return false;
+            std::memcpy(&value, mTrace.data() + offset, sizeof(value));
+            offset += sizeof(value);
+            break;
+        case eARG_ADDRESS:
+            if (!readVarint(offset, value))
+                return false;
+            break;
+        case eARG_BLOB:
+        {
+            std::uint64_t length = 0;
+            if (!readVarint(offset, length) || !fits(offset, size_t(length)))
+                return false;
+            blobArg = arg;
+            blobLength = size_t(length);
+            blob = mTrace.data() + offset;
+            if ((function != nullptr) && (function->rule == eGEN))
+            {
+                // the names the capture got; GL writes this replay's into scratch
+                generated = mTrace.data() + offset;
+                value = gl_trace_value(mScratch.data());
+            }
+            else
+            {
+                value = gl_trace_value(mTrace.data() + offset);
+            }
+            offset += size_t(length);
+            break;
+        }
+        case eARG_OUTPUT:
+            value = gl_trace_value(mScratch.data());
+            break;
+        case eARG_STRINGS:
+        {
+            std::uint64_t count = 0;
+            if (!readVarint(offset, count))
+                return false;
+            for (std::uint64_t i = 0; i < count; ++i)
+            {
+                std::uint64_t length = 0;
+                // each is followed by its terminator
+                if (!readVarint(offset, length) || !fits(offset, size_t(length)) || !fits(offset + size_t(length), 1) || (mTrace[offset + size_t(length)] != 0))
+                    return false;
+                mStrings.push_back(reinterpret_cast<const GLchar *>(mTrace.data() + offset));
+                mLengths.push_back(GLint(length));
+                offset += size_t(length) + 1;
+            }
+            value = gl_trace_value(mStrings.data());
+            break;
+        }
+        case eARG_LENGTHS:
+            value = gl_trace_value(mLengths.data());
+            break;
+        default:
+            return false;
+        }
+        values[arg] = value;
+    }
+    std::uint64_t recorded = 0;
+    if ((function != nullptr) && ((function->rule == eCREATE) || (function->rule == eMAP)))
+    {
+        if (!readVarint(offset, recorded))
+            return false;
+    }
+    // GL reads no more than the capture wrote down, and writes no more names than scratch holds
+    if (function != nullptr)
+    {
+        const int *params = function->params;
+        switch (function->rule)
+        {
+        case eBLOB:
+            if ((int(blobArg) == params[0]) && ((params[1] >= 0 ? values[params[1]] : 1) > blobLength / size_t(params[2])))
+                return false;
+            break;
+        case eCLEAR:
+            if ((int(blobArg) == params[0]) && (blobLength < clear_values(GLenum(values[0])) * size_t(params[1])))
+                return false;
+            break;
+        case eGEN:
+            if ((values[params[0]] > SCRATCH_BYTES / sizeof(GLuint)) || ((generated != nullptr) && (values[params[0]] > blobLength / sizeof(GLuint))))
+                return false;
+            break;
+        case eSTRING:
+            if ((int(blobArg) == params[0]) && ((blobLength == 0) || (blob[blobLength - 1] != 0)))
+                return false;
+            break;
+        default:
+            break;
+        }
+    }
+    // nor is there anything to call for entry points this driver lacks
+    if (!execute || (function == nullptr) || (function->address() == nullptr))
+        return true;
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::uint64_t result = function->invoke(function->address(), values);
+    if (timed)
+    {
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        mCallCounts[index]++;
+        mCallSeconds[index] += seconds;
+        mCalls++;
+        mCpuSeconds += seconds;
+    }
+    switch (function->rule)
+    {
+    case eGEN:
+        if (mCheckNames && (generated != nullptr) && (std::memcmp(generated, mScratch.data(), size_t(values[function->params[0]]) * sizeof(GLuint)) != 0))
+            mMismatches++;
+        break;
+    case eCREATE:
+        if (mCheckNames && (result != recorded))
+            mMismatches++;
+        break;
+    case eMAP:
+        mMapped[values[0]] = Mapped{reinterpret_cast<GLubyte *>(std::uintptr_t(result)), GLsizeiptr(values[2])};
+        break;
+    case eUNMAP:
+        mMapped.erase(values[0]);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+void GLTraceReplay::run(GLuint loops)
+{
+    mScratch.assign(SCRATCH_BYTES, 0);
+    mFrames.clear();
+    mCheckNames = true;
+    // open has already checked every record
+    size_t offset = mFirstRecord;
+    while (offset < mKeptStart)
+    {
+        if (!step(offset, true, false))
+            break;
+    }
+    glFinish();
+
+    for (GLuint loop = 0; loop < loops; ++loop)
+    {
+        mCalls = 0;
+        mCpuSeconds = 0.0;
+        auto frameStart = std::chrono::steady_clock::now();
+        for (offset = mKeptStart; (offset < mKeptEnd) && step(offset, true, true);)
+        {
+            if (mAtMarker)
+            {
+                // the GPU's share of the frame too
+                glFinish();
+                const auto frameEnd = std::chrono::steady_clock::now();
+                mFrames.push_back(FrameStats{mMarkerFrame, mCalls, mCpuSeconds, std::chrono::duration<double>(frameEnd - frameStart).count()});
+                mCalls = 0;
+                mCpuSeconds = 0.0;
+                frameStart = frameEnd;
+            }
+        }
+        // later loops make their objects anew, under names of their own
+        mCheckNames = false;
+    }
+}
+
+std::vector<GLTraceReplay::CallStats> GLTraceReplay::calls() const
+{
+    std::vector<CallStats> result;
+    for (size_t index = 0; index < mCallCounts.size(); ++index)
+    {
+        if (mCallCounts[index] > 0)
+            result.push_back(CallStats{mNames[index], mCallCounts[index], mCallSeconds[index]});
+    }
+    std::sort(result.begin(), result.end(), [](const CallStats &a, const CallStats &b) { return a.seconds > b.seconds; });
+    return result;
+}
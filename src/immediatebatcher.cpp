@@ -0,0 +1,259 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <gl_funcalls.h>
+#include <vectormath_aos.h>
+
+using namespace Vectormath::Aos;
+
+#include <shader.h>
+#include <shaderprogram.h>
+#include <immediatebatcher.h>
+
+ImmediateBatcher::ImmediateBatcher(GLsizeiptr bytesPerFlush, GLuint flushesInFlight, const std::string &positionName, const std::string &colourName)
+: mPositionName(positionName), mColourName(colourName), mLast(nullptr), mBuffer(0), mSegmentSize(std::max(bytesPerFlush, GLsizeiptr(sizeof(Vertex)))),
+  mSegmentCount(std::max(flushesInFlight, 1u)), mSegment(0), mMapped(nullptr), mFences(mSegmentCount, nullptr), mGroupsDrawn(0)
+{
+}
+
+ImmediateBatcher::~ImmediateBatcher()
+{
+    release();
+}
+
+ImmediateBatcher::Group &ImmediateBatcher::findGroup(ShaderProgram &program, GLenum mode)
+{
+    for (std::unique_ptr<Group> &group : mGroups)
+    {
+        if ((group->id == program.id()) && (group->mode == mode))
+            return *group;
+    }
+    mGroups.push_back(std::make_unique<Group>(Group{&program, program.id(), mode, {}, 0}));
+    return *mGroups.back();
+}
+
+void ImmediateBatcher::box(ShaderProgram &program, const Point3 &lower, const Point3 &upper, GLuint colour)
+{
+    const GLfloat x[2] = {lower.getX(), upper.getX()};
+    const GLfloat y[2] = {lower.getY(), upper.getY()};
+    const GLfloat z[2] = {lower.getZ(), upper.getZ()};
+    Vertex *v = append(program, GL_LINES, 24);
+    for (GLuint i = 0; i < 4; ++i)
+    {
+        const GLuint a = i & 1, b = i >> 1;
+        // the edges along x, y and z through this pair of the other two axes' sides
+        *v++ = Vertex{x[0], y[a], z[b], colour};
+        *v++ = Vertex{x[1], y[a], z[b], colour};
+        *v++ = Vertex{x[a], y[0], z[b], colour};
+        *v++ = Vertex{x[a], y[1], z[b], colour};
+        *v++ = Vertex{x[a], y[b], z[0], colour};
+        *v++ = Vertex{x[a], y[b], z[1], colour};
+    }
+}
+
+void ImmediateBatcher::cross(ShaderProgram &program, const Point3 &p, GLfloat size, GLuint colour)
+{
+    const GLfloat x = p.getX(), y = p.getY(), z = p.getZ();
+    Vertex *v = append(program, GL_LINES, 6);
+    v[0] = Vertex{x - size, y, z, colour};
+    v[1] = Vertex{x + size, y, z, colour};
+    v[2] = Vertex{x, y - size, z, colour};
+    v[3] = Vertex{x, y + size, z, colour};
+    v[4] = Vertex{x, y, z - size, colour};
+    v[5] = Vertex{x, y, z + size, colour};
+}
+
+size_t ImmediateBatcher::pending() const
+{
+    size_t count = 0;
+    for (const std::unique_ptr<Group> &group : mGroups)
+    {
+        count += group->vertices.size();
+    }
+    return count;
+}
+
+void ImmediateBatcher::releaseVertexArrays()
+{
+    for (VertexArray &array : mVertexArrays)
+    {
+        gl_exec(glDeleteVertexArrays, 1, &array.vao);
+    }
+    mVertexArrays.clear();
+}
+
+void ImmediateBatcher::release()
+{
+    for (GLsync &fence : mFences)
+    {
+        if (fence != nullptr)
+        {
+            gl_exec(glDeleteSync, fence);
+            fence = nullptr;
+        }
+    }
+    if (mBuffer != 0)
+    {
+        // GL keeps the old store alive for draws still reading it
+        if (mMapped != nullptr)
+        {
+            gl_exec(glBindBuffer, GL_ARRAY_BUFFER, mBuffer);
+            gl_exec(glUnmapBuffer, GL_ARRAY_BUFFER);
+            gl_exec(glBindBuffer, GL_ARRAY_BUFFER, 0);
+            mMapped = nullptr;
+        }
+        gl_exec(glDeleteBuffers, 1, &mBuffer);
+        mBuffer = 0;
+    }
+    // their attributes point at the old buffer
+    releaseVertexArrays();
+}
+
+void ImmediateBatcher::reserve(GLsizeiptr size)
+{
+    // while tracing, uploads go through glBufferSubData so the trace sees them; one can start or stop between flushes
+    const bool persistent = GLAD_GL_ARB_buffer_storage && (gl_trace() == nullptr);
+    if ((mBuffer != 0) && (size <= mSegmentSize) && (persistent == (mMapped != nullptr)))
+        return;
+    release();
+
+    // segments start on a whole vertex, so draws can index from the segment's first
+    while (mSegmentSize < size)
+        mSegmentSize *= 2;
+    mSegmentSize = (mSegmentSize + GLsizeiptr(sizeof(Vertex)) - 1) / GLsizeiptr(sizeof(Vertex)) * GLsizeiptr(sizeof(Vertex));
+    gl_exec(glGenBuffers, 1, &mBuffer);
+    gl_exec(glBindBuffer, GL_ARRAY_BUFFER, mBuffer);
+    if (persistent)
+    {
+        const GLsizeiptr total = mSegmentSize * mSegmentCount;
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl_exec(glBufferStorage, GL_ARRAY_BUFFER, total, nullptr, flags);
+        mMapped = static_cast<GLubyte *>(gl_exec(glMapBufferRange, GL_ARRAY_BUFFER, 0, total, flags));
+    }
+    else
+    {
+        gl_exec(glBufferData, GL_ARRAY_BUFFER, mSegmentSize, nullptr, GL_STREAM_DRAW);
+    }
+    gl_exec(glBindBuffer, GL_ARRAY_BUFFER, 0);
+}
+
+GLuint ImmediateBatcher::vertexArray(ShaderProgram &program)
+{
+    for (VertexArray &array : mVertexArrays)
+    {
+        if (array.id == program.id())
+        {
+            array.unusedFlushes = 0;
+            return array.vao;
+        }
+    }
+    mVertexArrays.push_back(VertexArray{program.id(), 0, 0});
+    VertexArray &array = mVertexArrays.back();
+    gl_exec(glGenVertexArrays, 1, &array.vao);
+
+    gl_exec(glBindVertexArray, array.vao);
+    gl_exec(glBindBuffer, GL_ARRAY_BUFFER, mBuffer);
+    const GLint position = program.attribute_location(mPositionName);
+    if (position >= 0)
+    {
+        gl_exec(glEnableVertexAttribArray, GLuint(position));
+        gl_exec(glVertexAttribPointer, GLuint(position), 3, GL_FLOAT, GL_FALSE, GLsizei(sizeof(Vertex)), (const void *)offsetof(Vertex, x));
+    }
+    const GLint colour = program.attribute_location(mColourName);
+    if (colour >= 0)
+    {
+        gl_exec(glEnableVertexAttribArray, GLuint(colour));
+        gl_exec(glVertexAttribPointer, GLuint(colour), 4, GL_UNSIGNED_BYTE, GL_TRUE, GLsizei(sizeof(Vertex)), (const void *)offsetof(Vertex, colour));
+    }
+    gl_exec(glBindVertexArray, 0);
+    gl_exec(glBindBuffer, GL_ARRAY_BUFFER, 0);
+    return array.vao;
+}
+
+void ImmediateBatcher::flush()
+{
+    mGroupsDrawn = 0;
+    mLast = nullptr;
+    // nothing says when a program goes, so whatever has not been used in a while is let go
+    mGroups.erase(std::remove_if(mGroups.begin(), mGroups.end(),
+                                 [](const std::unique_ptr<Group> &group) { return group->vertices.empty() && (++group->unusedFlushes > UNUSED_FLUSHES); }),
+                  mGroups.end());
+    for (auto it = mVertexArrays.begin(); it != mVertexArrays.end();)
+    {
+        if (++it->unusedFlushes > UNUSED_FLUSHES)
+        {
+            gl_exec(glDeleteVertexArrays, 1, &it->vao);
+            it = mVertexArrays.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    const GLsizeiptr size = GLsizeiptr(pending() * sizeof(Vertex));
+    if (size == 0)
+        return;
+    reserve(size);
+
+    GLsizeiptr segmentStart = 0;
+    if (mMapped != nullptr)
+    {
+        mSegment = (mSegment + 1) % mSegmentCount;
+        // only blocks if the GPU is more than flushesInFlight flushes behind
+        gl_wait_fence(mFences[mSegment]);
+        segmentStart = GLsizeiptr(mSegment) * mSegmentSize;
+        GLsizeiptr offset = segmentStart;
+        for (const std::unique_ptr<Group> &group : mGroups)
+        {
+            const size_t bytes = group->vertices.size() * sizeof(Vertex);
+            std::memcpy(mMapped + offset, group->vertices.data(), bytes);
+            offset += GLsizeiptr(bytes);
+        }
+        // as glBufferSubData would have counted it
+        gl_render_stats().bytesUploaded += std::uint64_t(size);
+    }
+    else
+    {
+        gl_exec(glBindBuffer, GL_ARRAY_BUFFER, mBuffer);
+        // orphan the store, so the driver hands back fresh memory rather than waiting on the last flush's draws
+        gl_exec(glBufferData, GL_ARRAY_BUFFER, mSegmentSize, nullptr, GL_STREAM_DRAW);
+        GLsizeiptr offset = 0;
+        for (const std::unique_ptr<Group> &group : mGroups)
+        {
+            const GLsizeiptr bytes = GLsizeiptr(group->vertices.size() * sizeof(Vertex));
+            if (bytes > 0)
+                gl_exec(glBufferSubData, GL_ARRAY_BUFFER, offset, bytes, group->vertices.data());
+            offset += bytes;
+        }
+        gl_exec(glBindBuffer, GL_ARRAY_BUFFER, 0);
+    }
+
+    GLint first = GLint(segmentStart / GLsizeiptr(sizeof(Vertex)));
+    for (const std::unique_ptr<Group> &group : mGroups)
+    {
+        const GLsizei count = GLsizei(group->vertices.size());
+        if (count == 0)
+            continue;
+        group->program->use();
+        gl_exec(glBindVertexArray, vertexArray(*group->program));
+        gl_exec(glDrawArrays, group->mode, first, count);
+        first += count;
+        group->vertices.clear();
+        group->unusedFlushes = 0;
+        mGroupsDrawn++;
+    }
+    gl_exec(glBindVertexArray, 0);
+    gl_exec(glUseProgram, 0);
+
+    if (mMapped != nullptr)
+    {
+        mFences[mSegment] = gl_exec(glFenceSync, GLenum(GL_SYNC_GPU_COMMANDS_COMPLETE), GLbitfield(0));
+    }
+}
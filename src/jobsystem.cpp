@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <jobsystem.h>
+
+namespace
+{
+    // which worker of which job system the current thread is, if any
+    thread_local const JobSystem *currentSystem = nullptr;
+    thread_local int currentWorker = -1;
+}
+
+JobSystem::JobSystem(unsigned workerCount)
+: stopping(false), mainThread(std::this_thread::get_id()), statsStart(std::chrono::steady_clock::now())
+{
+    if (workerCount == 0)
+    {
+        unsigned hardware = std::thread::hardware_concurrency();
+        workerCount = hardware > 1 ? hardware - 1 : 0;
+    }
+    for (unsigned i = 0; i < workerCount; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    // start the threads only once every deque exists, as they steal from each other
+    for (unsigned i = 0; i < workerCount; ++i)
+    {
+        workers[i]->thread = std::thread([this, i]() { worker_loop(i); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+    {
+        worker->thread.join();
+    }
+}
+
+void JobSystem::add(const Counter &counter)
+{
+    if (counter)
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        counter->pending++;
+    }
+}
+
+void JobSystem::finish(const Counter &counter)
+{
+    if (!counter)
+        return;
+    std::vector<Job> ready;
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (--counter->pending == 0)
+        {
+            ready.swap(counter->continuations);
+            done = true;
+        }
+    }
+    for (Job &job : ready)
+    {
+        job();
+    }
+    if (done)
+    {
+        // anyone in wait() on this counter sleeps on wake too
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_all();
+    }
+}
+
+void JobSystem::schedule(Task task)
+{
+    if (workers.empty())
+    {
+        // no workers: everything runs inline
+        execute(task, nullptr);
+        return;
+    }
+    // workers keep their own jobs local, everyone else spreads them round robin
+    unsigned index = (currentSystem == this && currentWorker >= 0) ? unsigned(currentWorker) : nextWorker++ % unsigned(workers.size());
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    queued++;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+void JobSystem::run(Job job, const Counter &counter)
+{
+    add(counter);
+    schedule(Task{std::move(job), counter});
+}
+
+void JobSystem::run_after(const Counter &dependency, Job job, const Counter &counter)
+{
+    add(counter);
+    Task task{std::move(job), counter};
+    if (dependency)
+    {
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->pending > 0)
+        {
+            auto shared = std::make_shared<Task>(std::move(task));
+            dependency->continuations.push_back([this, shared]() { schedule(std::move(*shared)); });
+            return;
+        }
+    }
+    schedule(std::move(task));
+}
+
+void JobSystem::run_on_main(Job job, const Counter &counter)
+{
+    add(counter);
+    {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainTasks.push_back(Task{std::move(job), counter});
+    }
+    // the main thread may be asleep in wait()
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+}
+
+size_t JobSystem::pump_main(size_t maxJobs)
+{
+    size_t ran = 0;
+    while (ran < maxJobs)
+    {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            if (mainTasks.empty())
+                break;
+            task = std::move(mainTasks.front());
+            mainTasks.pop_front();
+        }
+        execute(task, nullptr);
+        ++ran;
+    }
+    return ran;
+}
+
+void JobSystem::execute(Task &task, Worker *worker)
+{
+    if (worker == nullptr)
+    {
+        task.job();
+        finish(task.counter);
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    task.job();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    worker->busyNanoseconds += std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    worker->jobs++;
+    finish(task.counter);
+}
+
+bool JobSystem::try_run_one(int workerIndex)
+{
+    Task task;
+    bool found = false;
+    bool stolen = false;
+    if (workerIndex >= 0)
+    {
+        // newest first from our own deque, it is most likely still in cache
+        Worker &own = *workers[workerIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    const size_t count = workers.size();
+    const size_t first = workerIndex >= 0 ? size_t(workerIndex) + 1 : 0;
+    for (size_t i = 0; !found && i < count; ++i)
+    {
+        // oldest first from everyone else's
+        Worker &victim = *workers[(first + i) % count];
+        if (&victim == (workerIndex >= 0 ? workers[workerIndex].get() : nullptr))
+            continue;
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            found = stolen = true;
+        }
+    }
+    if (!found)
+        return false;
+    queued--;
+    Worker *worker = workerIndex >= 0 ? workers[workerIndex].get() : nullptr;
+    if (worker && stolen)
+        worker->steals++;
+    execute(task, worker);
+    return true;
+}
+
+void JobSystem::worker_loop(unsigned index)
+{
+    currentSystem = this;
+    currentWorker = int(index);
+    for (;;)
+    {
+        if (try_run_one(int(index)))
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return stopping || queued > 0; });
+        if (stopping && queued == 0)
+            return;
+    }
+}
+
+void JobSystem::wait(const Counter &counter)
+{
+    if (!counter)
+        return;
+    const int workerIndex = currentSystem == this ? currentWorker : -1;
+    const bool onMain = is_main_thread();
+    auto mainQueued = [this]() {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        return !mainTasks.empty();
+    };
+    while (!counter->done())
+    {
+        if (try_run_one(workerIndex))
+            continue;
+        // the main thread may be waiting on GL work queued for itself
+        if (onMain && pump_main(1) > 0)
+            continue;
+        // nothing to help with, so sleep until the counter is done or there is something again
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&]() { return counter->done() || queued > 0 || (onMain && mainQueued()); });
+    }
+}
+
+void JobSystem::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body)
+{
+    grain = std::max<size_t>(grain, 1);
+    const size_t chunks = (count + grain - 1) / grain;
+    if (chunks <= 1 || workers.empty())
+    {
+        if (count > 0)
+            body(0, count);
+        return;
+    }
+    Counter counter = make_counter();
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        const size_t begin = chunk * grain;
+        const size_t end = std::min(count, begin + grain);
+        run([&body, begin, end]() { body(begin, end); }, counter);
+    }
+    wait(counter);
+}
+
+std::vector<JobSystem::WorkerStats> JobSystem::stats() const
+{
+    const double elapsed = double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - statsStart).count());
+    std::vector<WorkerStats> result;
+    for (const auto &worker : workers)
+    {
+        WorkerStats stats;
+        stats.utilisation = elapsed > 0.0 ? float(double(worker->busyNanoseconds.load()) / elapsed) : 0.0f;
+        stats.jobs = worker->jobs.load();
+        stats.steals = worker->steals.load();
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void JobSystem::reset_stats()
+{
+    for (auto &worker : workers)
+    {
+        worker->busyNanoseconds = 0;
+        worker->jobs = 0;
+        worker->steals = 0;
+    }
+    statsStart = std::chrono::steady_clock::now();
+}
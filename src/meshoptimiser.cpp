@@ -0,0 +1,337 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+#include <meshoptimiser.h>
+
+static constexpr GLuint NO_VERTEX = ~0u;
+
+VertexCacheStats analyse_vertex_cache(const GLuint *indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+    VertexCacheStats stats{0.0f, 0.0f, 0};
+    // a vertex is in the cache if it was transformed within the last cacheSize misses
+    std::vector<size_t> timestamps(vertexCount, 0);
+    size_t clock = cacheSize + 1;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        GLuint vertex = indices[i];
+        if (clock - timestamps[vertex] > cacheSize)
+        {
+            timestamps[vertex] = clock++;
+            stats.transforms++;
+        }
+    }
+    size_t triangleCount = indexCount / 3;
+    stats.acmr = triangleCount ? float(stats.transforms) / float(triangleCount) : 0.0f;
+    stats.atvr = vertexCount ? float(stats.transforms) / float(vertexCount) : 0.0f;
+    return stats;
+}
+
+namespace
+{
+    // Forsyth's scoring, see "Linear-Speed Vertex Cache Optimisation"
+    constexpr int SCORE_CACHE_SIZE = 32;
+    constexpr int MAX_VALENCE = 32;
+    constexpr float CACHE_DECAY_POWER = 1.5f;
+    constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+    constexpr float VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+    struct ScoreTables
+    {
+        float cache[SCORE_CACHE_SIZE];
+        float valence[MAX_VALENCE + 1];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < SCORE_CACHE_SIZE; ++i)
+            {
+                if (i < 3)
+                {
+                    // the last triangle's vertices score the same, so we don't favour its winding
+                    cache[i] = LAST_TRIANGLE_SCORE;
+                }
+                else
+                {
+                    float scaler = 1.0f / (SCORE_CACHE_SIZE - 3);
+                    cache[i] = std::pow(1.0f - (i - 3) * scaler, CACHE_DECAY_POWER);
+                }
+            }
+            valence[0] = 0.0f;
+            for (int i = 1; i <= MAX_VALENCE; ++i)
+            {
+                valence[i] = VALENCE_BOOST_SCALE * std::pow(float(i), -VALENCE_BOOST_POWER);
+            }
+        }
+    };
+
+    float vertex_score(const ScoreTables &tables, int cachePosition, unsigned remaining)
+    {
+        if (remaining == 0)
+        {
+            // nothing left to draw with this vertex
+            return -1.0f;
+        }
+        float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+        return score + tables.valence[std::min<unsigned>(remaining, MAX_VALENCE)];
+    }
+}
+
+void optimise_vertex_cache(GLuint *dst, const GLuint *indices, size_t indexCount, size_t vertexCount)
+{
+    static const ScoreTables tables;
+    const size_t triangleCount = indexCount / 3;
+    std::vector<GLuint> source(indices, indices + triangleCount * 3);
+
+    // triangles using each vertex, packed per vertex
+    std::vector<unsigned> remaining(vertexCount, 0);
+    for (GLuint vertex : source)
+        remaining[vertex]++;
+    std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+    std::vector<GLuint> adjacency(source.size());
+    {
+        std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < source.size(); ++i)
+            adjacency[fill[source[i]]++] = GLuint(i / 3);
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScores[v] = vertex_score(tables, -1, remaining[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScores[t] = vertexScores[source[t * 3]] + vertexScores[source[t * 3 + 1]] + vertexScores[source[t * 3 + 2]];
+
+    GLuint cache[SCORE_CACHE_SIZE + 3];
+    GLuint nextCache[SCORE_CACHE_SIZE + 3];
+    size_t cacheCount = 0;
+    size_t inputCursor = 0;
+    size_t best = triangleCount ? size_t(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin()) : 0;
+
+    for (size_t output = 0; output < triangleCount; ++output)
+    {
+        if (best == triangleCount)
+        {
+            // dead end: nothing in the cache has any triangles left, take the next unused one
+            while (emitted[inputCursor])
+                ++inputCursor;
+            best = inputCursor;
+        }
+
+        const GLuint *triangle = &source[best * 3];
+        std::copy(triangle, triangle + 3, dst + output * 3);
+        emitted[best] = true;
+
+        // remove the triangle from its vertices' adjacency
+        for (int k = 0; k < 3; ++k)
+        {
+            GLuint vertex = triangle[k];
+            GLuint *first = &adjacency[adjacencyOffsets[vertex]];
+            GLuint *last = first + remaining[vertex];
+            *std::find(first, last, GLuint(best)) = *(last - 1);
+            remaining[vertex]--;
+        }
+
+        // new LRU cache: this triangle's vertices at the front, then the old contents
+        size_t nextCount = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (std::find(nextCache, nextCache + nextCount, triangle[k]) == nextCache + nextCount)
+                nextCache[nextCount++] = triangle[k];
+        }
+        for (size_t c = 0; c < cacheCount; ++c)
+        {
+            GLuint vertex = cache[c];
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                nextCache[nextCount++] = vertex;
+        }
+
+        // rescore everything that was or is in the cache
+        for (size_t c = 0; c < nextCount; ++c)
+        {
+            GLuint vertex = nextCache[c];
+            int position = c < SCORE_CACHE_SIZE ? int(c) : -1;
+            float score = vertex_score(tables, position, remaining[vertex]);
+            float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+            for (size_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex] + remaining[vertex]; ++a)
+                triangleScores[adjacency[a]] += delta;
+        }
+
+        // and pick the best triangle touching the cache
+        best = triangleCount;
+        float bestScore = -1.0f;
+        for (size_t c = 0; c < nextCount; ++c)
+        {
+            GLuint vertex = nextCache[c];
+            for (size_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex] + remaining[vertex]; ++a)
+            {
+                GLuint t = adjacency[a];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = std::min<size_t>(nextCount, SCORE_CACHE_SIZE);
+        std::copy(nextCache, nextCache + cacheCount, cache);
+    }
+}
+
+namespace
+{
+    // triangle index where each cluster starts; the last entry is the triangle count
+    std::vector<size_t> overdraw_clusters(const GLuint *indices, size_t triangleCount, size_t vertexCount, float threshold)
+    {
+        const unsigned cacheSize = DEFAULT_VERTEX_CACHE_SIZE;
+        std::vector<size_t> timestamps(vertexCount, 0);
+        size_t clock = cacheSize + 1;
+        auto misses = [&](size_t t)
+        {
+            unsigned count = 0;
+            for (int k = 0; k < 3; ++k)
+            {
+                GLuint vertex = indices[t * 3 + k];
+                if (clock - timestamps[vertex] > cacheSize)
+                {
+                    timestamps[vertex] = clock++;
+                    count++;
+                }
+            }
+            return count;
+        };
+        auto reset = [&]()
+        {
+            clock += cacheSize + 1;
+        };
+
+        // hard boundaries: where the cache optimiser had to restart from cold, and the start whatever it holds
+        std::vector<size_t> hard;
+        if (triangleCount > 0)
+            hard.push_back(0);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            // the first triangle still warms the cache for the rest
+            if ((misses(t) == 3) && (t > 0))
+                hard.push_back(t);
+        }
+        hard.push_back(triangleCount);
+
+        // soft boundaries: split a hard cluster wherever the prefix is already cache efficient enough
+        std::vector<size_t> clusters;
+        for (size_t h = 0; h + 1 < hard.size(); ++h)
+        {
+            size_t start = hard[h], end = hard[h + 1];
+            reset();
+            size_t clusterMisses = 0;
+            for (size_t t = start; t < end; ++t)
+                clusterMisses += misses(t);
+            float clusterAcmr = float(clusterMisses) / float(end - start);
+
+            reset();
+            clusters.push_back(start);
+            size_t runStart = start, runMisses = 0;
+            for (size_t t = start; t < end; ++t)
+            {
+                runMisses += misses(t);
+                float runAcmr = float(runMisses) / float(t + 1 - runStart);
+                if (t + 1 < end && runAcmr <= threshold * clusterAcmr)
+                {
+                    clusters.push_back(t + 1);
+                    runStart = t + 1;
+                    runMisses = 0;
+                    reset();
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+        return clusters;
+    }
+}
+
+void optimise_overdraw(GLuint *dst, const GLuint *indices, size_t indexCount, const GLfloat *positions, size_t vertexCount, size_t positionStride, float threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    std::vector<GLuint> source(indices, indices + triangleCount * 3);
+    std::vector<size_t> clusters = overdraw_clusters(source.data(), triangleCount, vertexCount, threshold);
+    const size_t clusterCount = clusters.size() - 1;
+
+    float meshCentre[3] = {0.0f, 0.0f, 0.0f};
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        for (int k = 0; k < 3; ++k)
+            meshCentre[k] += positions[v * positionStride + k];
+    }
+    for (int k = 0; k < 3; ++k)
+        meshCentre[k] /= float(std::max<size_t>(vertexCount, 1));
+
+    // clusters facing away from the centre occlude the rest, so draw them first
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        float centroid[3] = {0.0f, 0.0f, 0.0f};
+        float normal[3] = {0.0f, 0.0f, 0.0f};
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const GLfloat *p0 = &positions[source[t * 3] * positionStride];
+            const GLfloat *p1 = &positions[source[t * 3 + 1] * positionStride];
+            const GLfloat *p2 = &positions[source[t * 3 + 2] * positionStride];
+            float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                centroid[k] += (p0[k] + p1[k] + p2[k]) * (triangleArea / 3.0f);
+                normal[k] += n[k];
+            }
+            area += triangleArea;
+        }
+        float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float key = 0.0f;
+        if (area > 0.0f && normalLength > 0.0f)
+        {
+            for (int k = 0; k < 3; ++k)
+                key += (centroid[k] / area - meshCentre[k]) * (normal[k] / normalLength);
+        }
+        sortKeys[c] = key;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    GLuint *out = dst;
+    for (size_t c : order)
+    {
+        out = std::copy(&source[clusters[c] * 3], &source[0] + clusters[c + 1] * 3, out);
+    }
+}
+
+size_t optimise_vertex_fetch_remap(GLuint *remap, const GLuint *indices, size_t indexCount, size_t vertexCount)
+{
+    std::fill(remap, remap + vertexCount, NO_VERTEX);
+    GLuint next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        GLuint vertex = indices[i];
+        if (remap[vertex] == NO_VERTEX)
+            remap[vertex] = next++;
+    }
+    size_t referenced = next;
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        if (remap[v] == NO_VERTEX)
+            remap[v] = next++;
+    }
+    return referenced;
+}
@@ -0,0 +1,461 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include <meshsimplify.h>
+
+namespace
+{
+    /* boundary planes count this much more than the faces, so outlines hold their shape */
+    constexpr double BORDER_WEIGHT = 10.0;
+
+    /* symmetric 4x4 plane quadric, plus the weight it was accumulated with */
+    struct Quadric
+    {
+        double a2 = 0, ab = 0, ac = 0, ad = 0;
+        double b2 = 0, bc = 0, bd = 0;
+        double c2 = 0, cd = 0;
+        double d2 = 0;
+        double weight = 0;
+
+        void addPlane(double a, double b, double c, double d, double w)
+        {
+            a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+            b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+            c2 += w * c * c; cd += w * c * d;
+            d2 += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric &q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+            weight += q.weight;
+        }
+
+        /* weighted mean squared distance of p from the planes */
+        double error(const GLfloat *p) const
+        {
+            const double x = p[0], y = p[1], z = p[2];
+            const double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                           + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                           + c2 * z * z + 2 * cd * z
+                           + d2;
+            return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+        }
+    };
+
+    enum VertexKind : GLubyte
+    {
+        eVERTEX_INTERIOR = 0,
+        /* on an open edge: only slides along it */
+        eVERTEX_BORDER,
+        /* a UV or normal seam, or non manifold: others may collapse onto it but it stays */
+        eVERTEX_LOCKED
+    };
+
+    struct Collapse
+    {
+        double cost;
+        GLuint from;
+        GLuint to;
+        GLuint version;
+
+        bool operator>(const Collapse &other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    void cross(const GLfloat *a, const GLfloat *b, const GLfloat *c, double n[3])
+    {
+        const double e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const double e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+        n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+        n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+    }
+
+    uint64_t edge_key(GLuint a, GLuint b)
+    {
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const GLuint *indices, size_t indexCount, const GLfloat *positions, size_t vertexCount, size_t positionStride)
+        : mTriangles(indices, indices + indexCount), mPositions(positions), mStride(positionStride),
+          mQuadrics(vertexCount), mKinds(vertexCount, eVERTEX_INTERIOR), mVersions(vertexCount, 0),
+          mRemoved(vertexCount, false), mTriangleRemoved(indexCount / 3, false), mVertexTriangles(vertexCount)
+        {
+            mLive = indexCount / 3;
+            classifyVertices();
+            for (size_t t = 0; t < mLive; ++t)
+            {
+                for (int k = 0; k < 3; ++k)
+                    mVertexTriangles[mTriangles[t * 3 + k]].push_back(GLuint(t));
+            }
+            accumulateQuadrics();
+        }
+
+        GLfloat run(size_t targetTriangles, double maxError)
+        {
+            for (GLuint v = 0; v < mQuadrics.size(); ++v)
+                pushBest(v);
+            const double maxCost = maxError * maxError;
+            double worst = 0.0;
+            while (mLive > targetTriangles && !mHeap.empty())
+            {
+                const Collapse collapse = mHeap.top();
+                mHeap.pop();
+                if (collapse.cost > maxCost)
+                    break;
+                if (mRemoved[collapse.from] || mRemoved[collapse.to] || collapse.version != mVersions[collapse.from])
+                    continue;
+                // queued collapses were valid, and anything that could change that bumps the version
+                if (!valid(collapse.from, collapse.to))
+                    continue;
+                worst = std::max(worst, collapse.cost);
+                apply(collapse.from, collapse.to);
+            }
+            return GLfloat(std::sqrt(worst));
+        }
+
+        size_t write(GLuint *dst) const
+        {
+            size_t count = 0;
+            for (size_t t = 0; t < mTriangleRemoved.size(); ++t)
+            {
+                if (mTriangleRemoved[t])
+                    continue;
+                for (int k = 0; k < 3; ++k)
+                    dst[count++] = mTriangles[t * 3 + k];
+            }
+            return count;
+        }
+
+    private:
+        const GLfloat *position(GLuint v) const
+        {
+            return mPositions + size_t(v) * mStride;
+        }
+
+        void classifyVertices()
+        {
+            // vertices sharing a position with another are seams; moving one would tear the mesh
+            std::vector<GLuint> used(mTriangles);
+            std::sort(used.begin(), used.end());
+            used.erase(std::unique(used.begin(), used.end()), used.end());
+            auto samePosition = [this](GLuint a, GLuint b) { return std::memcmp(position(a), position(b), sizeof(GLfloat) * 3) == 0; };
+            std::sort(used.begin(), used.end(), [this](GLuint a, GLuint b) { return std::memcmp(position(a), position(b), sizeof(GLfloat) * 3) < 0; });
+            for (size_t i = 1; i < used.size(); ++i)
+            {
+                if (samePosition(used[i - 1], used[i]))
+                {
+                    mKinds[used[i - 1]] = eVERTEX_LOCKED;
+                    mKinds[used[i]] = eVERTEX_LOCKED;
+                }
+            }
+
+            std::unordered_map<uint64_t, GLuint> edgeUses;
+            edgeUses.reserve(mTriangles.size());
+            for (size_t t = 0; t < mTriangles.size(); t += 3)
+            {
+                for (int k = 0; k < 3; ++k)
+                    ++edgeUses[edge_key(mTriangles[t + k], mTriangles[t + (k + 1) % 3])];
+            }
+            for (const auto &edge : edgeUses)
+            {
+                const GLuint a = GLuint(edge.first >> 32), b = GLuint(edge.first & 0xffffffffu);
+                if (edge.second == 1)
+                {
+                    for (GLuint v : {a, b})
+                    {
+                        if (mKinds[v] != eVERTEX_LOCKED)
+                            mKinds[v] = eVERTEX_BORDER;
+                    }
+                }
+                else if (edge.second > 2)
+                {
+                    mKinds[a] = eVERTEX_LOCKED;
+                    mKinds[b] = eVERTEX_LOCKED;
+                }
+            }
+        }
+
+        void accumulateQuadrics()
+        {
+            for (size_t t = 0; t < mTriangles.size(); t += 3)
+            {
+                const GLuint *tri = &mTriangles[t];
+                double n[3];
+                cross(position(tri[0]), position(tri[1]), position(tri[2]), n);
+                const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length <= 0.0)
+                    continue;
+                const double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+                const GLfloat *p = position(tri[0]);
+                const double d = -(a * p[0] + b * p[1] + c * p[2]);
+                // weighted by area, so big faces keep their plane
+                const double area = length * 0.5;
+                for (int k = 0; k < 3; ++k)
+                    mQuadrics[tri[k]].addPlane(a, b, c, d, area);
+
+                // open edges get a plane through them, perpendicular to the face
+                for (int k = 0; k < 3; ++k)
+                {
+                    const GLuint i0 = tri[k], i1 = tri[(k + 1) % 3];
+                    if (!borderEdge(i0, i1))
+                        continue;
+                    const GLfloat *p0 = position(i0), *p1 = position(i1);
+                    const double e[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                    double m[3] = {e[1] * c - e[2] * b, e[2] * a - e[0] * c, e[0] * b - e[1] * a};
+                    const double edgeLength = std::sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+                    const double mLength = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+                    if (mLength <= 0.0)
+                        continue;
+                    for (double &component : m)
+                        component /= mLength;
+                    const double md = -(m[0] * p0[0] + m[1] * p0[1] + m[2] * p0[2]);
+                    const double w = BORDER_WEIGHT * edgeLength * edgeLength;
+                    mQuadrics[i0].addPlane(m[0], m[1], m[2], md, w);
+                    mQuadrics[i1].addPlane(m[0], m[1], m[2], md, w);
+                }
+            }
+        }
+
+        /* an edge of exactly one live triangle, from the adjacency as it stands after earlier collapses */
+        bool borderEdge(GLuint a, GLuint b) const
+        {
+            GLuint uses = 0;
+            for (GLuint t : mVertexTriangles[a])
+            {
+                if (mTriangleRemoved[t])
+                    continue;
+                const GLuint *tri = &mTriangles[t * 3];
+                if (tri[0] == b || tri[1] == b || tri[2] == b)
+                    ++uses;
+            }
+            return uses == 1;
+        }
+
+        /* the live vertices sharing a triangle with v, other than v and skip, sorted */
+        std::vector<GLuint> ring(GLuint v, GLuint skip) const
+        {
+            std::vector<GLuint> vertices;
+            for (GLuint t : mVertexTriangles[v])
+            {
+                if (mTriangleRemoved[t])
+                    continue;
+                for (int k = 0; k < 3; ++k)
+                {
+                    const GLuint n = mTriangles[t * 3 + k];
+                    if (n != v && n != skip)
+                        vertices.push_back(n);
+                }
+            }
+            std::sort(vertices.begin(), vertices.end());
+            vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+            return vertices;
+        }
+
+        /**
+         * The link condition: the only vertices joined to both ends of the
+         * edge are those opposite it in its own triangles. Any other would
+         * leave two triangles, or an edge of three, once the ends merge.
+         */
+        bool keepsManifold(GLuint from, GLuint to) const
+        {
+            size_t opposite = 0;
+            for (GLuint t : mVertexTriangles[from])
+            {
+                if (mTriangleRemoved[t])
+                    continue;
+                const GLuint *tri = &mTriangles[t * 3];
+                if (tri[0] == to || tri[1] == to || tri[2] == to)
+                    ++opposite;
+            }
+            const std::vector<GLuint> fromRing = ring(from, to);
+            const std::vector<GLuint> toRing = ring(to, from);
+            std::vector<GLuint> common;
+            std::set_intersection(fromRing.begin(), fromRing.end(), toRing.begin(), toRing.end(), std::back_inserter(common));
+            return common.size() == opposite;
+        }
+
+        /* whether from may move onto to under the vertex kind rules */
+        bool allowed(GLuint from, GLuint to) const
+        {
+            switch (mKinds[from])
+            {
+            case eVERTEX_INTERIOR:
+                return true;
+            case eVERTEX_BORDER:
+                return mKinds[to] != eVERTEX_INTERIOR && borderEdge(from, to);
+            default:
+                return false;
+            }
+        }
+
+        double cost(GLuint from, GLuint to) const
+        {
+            Quadric q = mQuadrics[from];
+            q.add(mQuadrics[to]);
+            return q.error(position(to));
+        }
+
+        /* queue the cheapest allowed collapse of v that folds nothing over */
+        void pushBest(GLuint v)
+        {
+            if (mRemoved[v] || mKinds[v] == eVERTEX_LOCKED)
+                return;
+            double best = std::numeric_limits<double>::max();
+            GLuint target = ~0u;
+            for (GLuint t : mVertexTriangles[v])
+            {
+                if (mTriangleRemoved[t])
+                    continue;
+                for (int k = 0; k < 3; ++k)
+                {
+                    const GLuint n = mTriangles[t * 3 + k];
+                    if (n == v || !allowed(v, n))
+                        continue;
+                    const double c = cost(v, n);
+                    if (c < best && valid(v, n))
+                    {
+                        best = c;
+                        target = n;
+                    }
+                }
+            }
+            if (target != ~0u)
+                mHeap.push(Collapse{best, v, target, mVersions[v]});
+        }
+
+        /* moving from onto to must not fold any triangle over, nor pinch the surface */
+        bool valid(GLuint from, GLuint to) const
+        {
+            bool adjacent = false;
+            for (GLuint t : mVertexTriangles[from])
+            {
+                if (mTriangleRemoved[t])
+                    continue;
+                const GLuint *tri = &mTriangles[t * 3];
+                if (tri[0] == to || tri[1] == to || tri[2] == to)
+                {
+                    adjacent = true;
+                    continue;
+                }
+                const GLfloat *p[3], *q[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    p[k] = position(tri[k]);
+                    q[k] = tri[k] == from ? position(to) : p[k];
+                }
+                double before[3], after[3];
+                cross(p[0], p[1], p[2], before);
+                cross(q[0], q[1], q[2], after);
+                if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0)
+                    return false;
+            }
+            return adjacent && keepsManifold(from, to);
+        }
+
+        void apply(GLuint from, GLuint to)
+        {
+            for (GLuint t : mVertexTriangles[from])
+            {
+                if (mTriangleRemoved[t])
+                    continue;
+                GLuint *tri = &mTriangles[t * 3];
+                if (tri[0] == to || tri[1] == to || tri[2] == to)
+                {
+                    mTriangleRemoved[t] = true;
+                    --mLive;
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (tri[k] == from)
+                        tri[k] = to;
+                }
+                mVertexTriangles[to].push_back(t);
+            }
+            mVertexTriangles[from].clear();
+            mRemoved[from] = true;
+            mQuadrics[to].add(mQuadrics[from]);
+
+            // drop dead triangles from to's list, then requeue everything whose costs changed
+            std::vector<GLuint> &triangles = mVertexTriangles[to];
+            triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [this](GLuint t) { return mTriangleRemoved[t]; }), triangles.end());
+            std::vector<GLuint> neighbours{to};
+            for (GLuint t : triangles)
+            {
+                for (int k = 0; k < 3; ++k)
+                    neighbours.push_back(mTriangles[t * 3 + k]);
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+            for (GLuint n : neighbours)
+            {
+                ++mVersions[n];
+                pushBest(n);
+            }
+        }
+
+        std::vector<GLuint> mTriangles;
+        const GLfloat *mPositions;
+        size_t mStride;
+        std::vector<Quadric> mQuadrics;
+        std::vector<GLubyte> mKinds;
+        std::vector<GLuint> mVersions;
+        std::vector<bool> mRemoved;
+        std::vector<bool> mTriangleRemoved;
+        std::vector<std::vector<GLuint>> mVertexTriangles;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> mHeap;
+        size_t mLive;
+    };
+}
+
+size_t simplify_mesh(GLuint *dst, const GLuint *indices, size_t indexCount, const GLfloat *positions, size_t vertexCount, size_t positionStride,
+                     size_t targetIndexCount, GLfloat maxError, GLfloat *resultError)
+{
+    Simplifier simplifier(indices, indexCount, positions, vertexCount, positionStride);
+    const GLfloat error = simplifier.run(targetIndexCount / 3, maxError);
+    if (resultError != nullptr)
+        *resultError = error;
+    return simplifier.write(dst);
+}
+
+std::vector<LODLevel> build_lod_chain(const GLuint *indices, size_t indexCount, const GLfloat *positions, size_t vertexCount, size_t positionStride,
+                                      size_t maxLevels, GLfloat ratio, GLfloat maxError)
+{
+    std::vector<LODLevel> levels;
+    levels.push_back(LODLevel{std::vector<GLuint>(indices, indices + indexCount), 0.0f});
+    while (levels.size() < maxLevels)
+    {
+        const LODLevel &previous = levels.back();
+        const size_t target = size_t(previous.indices.size() / 3 * ratio) * 3;
+        std::vector<GLuint> simplified(previous.indices.size());
+        GLfloat error = 0.0f;
+        // each level starts from the last, so its error adds to what that one already had
+        const size_t count = simplify_mesh(simplified.data(), previous.indices.data(), previous.indices.size(), positions, vertexCount,
+                                           positionStride, target, maxError - previous.error, &error);
+        // stop once the mesh will not go much further
+        if (count == 0 || count > previous.indices.size() * 9 / 10)
+            break;
+        simplified.resize(count);
+        levels.push_back(LODLevel{std::move(simplified), previous.error + error});
+    }
+    return levels;
+}
@@ -0,0 +1,555 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <gl_funcalls.h>
+#include <statecache.h>
+#include <texture.h>
+#include <rendergraph.h>
+
+/* frames a pooled texture may go unused before it is freed */
+static constexpr GLuint POOL_FRAMES = 3;
+
+static bool is_depth_format(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+    case GL_DEPTH32F_STENCIL8:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool has_stencil(GLenum internalFormat)
+{
+    return (internalFormat == GL_DEPTH24_STENCIL8) || (internalFormat == GL_DEPTH32F_STENCIL8);
+}
+
+static size_t pixel_size(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_R8:
+        return 1;
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+        return 2;
+    case GL_RGB8:
+    case GL_SRGB8:
+    case GL_DEPTH_COMPONENT24:
+        return 3;
+    case GL_RGBA16F:
+    case GL_RG32F:
+    case GL_DEPTH32F_STENCIL8:
+        return 8;
+    case GL_RGB32F:
+        return 12;
+    case GL_RGBA32F:
+        return 16;
+    default:
+        // RGBA8, R32F, RG16F, packed formats and the 32 bit depths
+        return 4;
+    }
+}
+
+/* clears honour the depth mask, so it is opened for them and put back as the pass expects */
+static void clear_depth(GLenum buffer)
+{
+    GLboolean depthMask = GL_TRUE;
+    gl_exec(glGetBooleanv, GL_DEPTH_WRITEMASK, &depthMask);
+    if (!depthMask)
+        gl_exec(glDepthMask, GL_TRUE);
+    if (buffer == GL_DEPTH_STENCIL)
+    {
+        gl_exec(glClearBufferfi, GL_DEPTH_STENCIL, 0, 1.0f, 0);
+    }
+    else
+    {
+        // glClearBufferfi only takes GL_DEPTH_STENCIL
+        const GLfloat one = 1.0f;
+        gl_exec(glClearBufferfv, GL_DEPTH, 0, &one);
+    }
+    if (!depthMask)
+        gl_exec(glDepthMask, GL_FALSE);
+}
+
+static bool same_desc(const RenderGraph::TextureDesc &a, const RenderGraph::TextureDesc &b)
+{
+    return (a.width == b.width) && (a.height == b.height) && (a.internalFormat == b.internalFormat);
+}
+
+RenderGraph::Resource RenderGraph::Builder::create(const char *name, const TextureDesc &desc)
+{
+    Entry entry;
+    entry.name = name;
+    entry.desc = desc;
+    mGraph.mEntries.push_back(entry);
+    return mGraph.addVersion(GLuint(mGraph.mEntries.size() - 1), NONE);
+}
+
+RenderGraph::Resource RenderGraph::Builder::read(Resource resource)
+{
+    assert(resource < mGraph.mVersions.size());
+    mGraph.checkFeedback(mPass, mGraph.mVersions[resource].entry, true);
+    mGraph.mPasses[mPass].reads.push_back(resource);
+    mGraph.mVersions[resource].readers.push_back(mPass);
+    return resource;
+}
+
+RenderGraph::Resource RenderGraph::Builder::write(Resource resource, bool clear)
+{
+    assert(resource < mGraph.mVersions.size());
+    Version &version = mGraph.mVersions[resource];
+    if (version.overwriter != NONE)
+    {
+        std::cerr << "Pass " << mGraph.mPasses[mPass].name << " writes a version of " << mGraph.mEntries[version.entry].name
+                  << " that pass " << mGraph.mPasses[version.overwriter].name << " already wrote; write the version it returned" << std::endl;
+    }
+    version.overwriter = mPass;
+    const GLuint entry = version.entry;
+    mGraph.checkFeedback(mPass, entry, false);
+    // what outlives the frame has to be drawn
+    if ((mGraph.mEntries[entry].imported != nullptr) || mGraph.mEntries[entry].backbuffer)
+        mGraph.mPasses[mPass].keep = true;
+    const Resource output = mGraph.addVersion(entry, mPass);
+    mGraph.mPasses[mPass].writes.push_back(Attachment{resource, output, clear});
+    return output;
+}
+
+void RenderGraph::Builder::keep()
+{
+    mGraph.mPasses[mPass].keep = true;
+}
+
+void RenderGraph::checkFeedback(GLuint pass, GLuint entry, bool reading) const
+{
+    // every version of an entry is the same texture, so sampling any of them while drawing into it is undefined
+    const Pass &declared = mPasses[pass];
+    bool loop = false;
+    if (reading)
+    {
+        for (const Attachment &write : declared.writes)
+        {
+            loop = loop || (mVersions[write.input].entry == entry);
+        }
+    }
+    else
+    {
+        for (Resource resource : declared.reads)
+        {
+            loop = loop || (mVersions[resource].entry == entry);
+        }
+    }
+    if (loop)
+    {
+        std::cerr << "Pass " << declared.name << " both reads and draws into " << mEntries[entry].name
+                  << ", a feedback loop; draw into another texture" << std::endl;
+    }
+}
+
+RenderGraph::Resource RenderGraph::addVersion(GLuint entry, GLuint producer)
+{
+    Version version;
+    version.entry = entry;
+    version.producer = producer;
+    mVersions.push_back(version);
+    mEntries[entry].latest = Resource(mVersions.size() - 1);
+    return mEntries[entry].latest;
+}
+
+RenderGraph::Resource RenderGraph::backbuffer(GLsizei width, GLsizei height)
+{
+    for (Entry &entry : mEntries)
+    {
+        if (entry.backbuffer)
+        {
+            entry.desc = {width, height, GL_RGBA8};
+            return entry.latest;
+        }
+    }
+    Entry entry;
+    entry.name = "backbuffer";
+    entry.desc = {width, height, GL_RGBA8};
+    entry.backbuffer = true;
+    mEntries.push_back(entry);
+    return addVersion(GLuint(mEntries.size() - 1), NONE);
+}
+
+RenderGraph::Resource RenderGraph::import(const char *name, const Texture &texture)
+{
+    for (Entry &entry : mEntries)
+    {
+        if (entry.imported == &texture)
+            return entry.latest;
+    }
+    Entry entry;
+    entry.name = name;
+    entry.desc = {texture.getWidth(), texture.getHeight(), texture.getInternalFormat()};
+    entry.imported = &texture;
+    mEntries.push_back(entry);
+    return addVersion(GLuint(mEntries.size() - 1), NONE);
+}
+
+void RenderGraph::addPass(const char *name, const std::function<void(Builder &pass)> &setup, Execute execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    mPasses.push_back(std::move(pass));
+    Builder builder(*this, GLuint(mPasses.size() - 1));
+    setup(builder);
+}
+
+void RenderGraph::cull()
+{
+    // reference counts: a version is used by its readers, and by an overwriter that keeps what it holds
+    for (Version &version : mVersions)
+    {
+        version.refs = GLuint(version.readers.size());
+    }
+    for (Pass &pass : mPasses)
+    {
+        pass.refs = GLuint(pass.writes.size());
+        pass.culled = false;
+        for (const Attachment &write : pass.writes)
+        {
+            if (!write.clear)
+                mVersions[write.input].refs++;
+        }
+    }
+
+    // unused versions release their producers, and culled producers release what they used
+    std::vector<Resource> unused;
+    for (Resource resource = 0; resource < mVersions.size(); ++resource)
+    {
+        if (mVersions[resource].refs == 0)
+            unused.push_back(resource);
+    }
+    mCulled = 0;
+    while (!unused.empty())
+    {
+        const Version &version = mVersions[unused.back()];
+        unused.pop_back();
+        if (version.producer == NONE)
+            continue;
+        Pass &pass = mPasses[version.producer];
+        if (pass.keep || pass.culled || (--pass.refs > 0))
+            continue;
+        pass.culled = true;
+        mCulled++;
+        for (Resource read : pass.reads)
+        {
+            if (--mVersions[read].refs == 0)
+                unused.push_back(read);
+        }
+        for (const Attachment &write : pass.writes)
+        {
+            if (!write.clear && (--mVersions[write.input].refs == 0))
+                unused.push_back(write.input);
+        }
+    }
+}
+
+void RenderGraph::sort()
+{
+    // edges: producer before readers and overwriter, readers before overwriter
+    const size_t count = mPasses.size();
+    std::vector<std::vector<GLuint>> after(count);
+    std::vector<GLuint> waiting(count, 0);
+    auto edge = [&](GLuint from, GLuint to) {
+        if ((from == NONE) || (from == to) || mPasses[from].culled)
+            return;
+        after[from].push_back(to);
+        waiting[to]++;
+    };
+    for (GLuint p = 0; p < count; ++p)
+    {
+        const Pass &pass = mPasses[p];
+        if (pass.culled)
+            continue;
+        for (Resource read : pass.reads)
+        {
+            edge(mVersions[read].producer, p);
+        }
+        for (const Attachment &write : pass.writes)
+        {
+            edge(mVersions[write.input].producer, p);
+            for (GLuint reader : mVersions[write.input].readers)
+            {
+                edge(reader, p);
+            }
+        }
+    }
+
+    // Kahn's, taking the earliest declared of the ready passes so independent passes keep their order
+    mOrder.clear();
+    std::vector<bool> placed(count, false);
+    for (bool progress = true; progress;)
+    {
+        progress = false;
+        for (GLuint p = 0; p < count; ++p)
+        {
+            if (placed[p] || mPasses[p].culled || (waiting[p] > 0))
+                continue;
+            placed[p] = true;
+            mOrder.push_back(p);
+            for (GLuint next : after[p])
+            {
+                waiting[next]--;
+            }
+            progress = true;
+            break;
+        }
+    }
+    for (GLuint p = 0; p < count; ++p)
+    {
+        if (!placed[p] && !mPasses[p].culled)
+        {
+            std::cerr << "Render graph has a cycle through pass " << mPasses[p].name << "; running it in declared order" << std::endl;
+            mOrder.push_back(p);
+        }
+    }
+}
+
+void RenderGraph::allocate()
+{
+    for (Entry &entry : mEntries)
+    {
+        entry.firstUse = NONE;
+        entry.lastUse = 0;
+        entry.physical = NONE;
+    }
+    auto use = [&](Resource resource, GLuint position) {
+        Entry &entry = mEntries[mVersions[resource].entry];
+        entry.firstUse = std::min(entry.firstUse, position);
+        entry.lastUse = std::max(entry.lastUse, position);
+    };
+    for (GLuint position = 0; position < mOrder.size(); ++position)
+    {
+        const Pass &pass = mPasses[mOrder[position]];
+        for (Resource read : pass.reads)
+        {
+            use(read, position);
+        }
+        for (const Attachment &write : pass.writes)
+        {
+            use(write.input, position);
+        }
+    }
+
+    for (Pooled &pooled : mPool)
+    {
+        pooled.inUse = false;
+    }
+    mTransients = 0;
+    mPhysical = 0;
+    size_t declaredBytes = 0, physicalBytes = 0;
+    // a texture whose last use is over goes back to the pool before the next pass takes one
+    for (GLuint position = 0; position < mOrder.size(); ++position)
+    {
+        for (Entry &entry : mEntries)
+        {
+            if ((entry.firstUse != position) || (entry.imported != nullptr) || entry.backbuffer)
+                continue;
+            mTransients++;
+            const size_t previousBytes = declaredBytes;
+            declaredBytes += size_t(entry.desc.width) * size_t(entry.desc.height) * pixel_size(entry.desc.internalFormat);
+            GLuint found = NONE;
+            for (GLuint i = 0; i < mPool.size(); ++i)
+            {
+                if (!mPool[i].inUse && same_desc(mPool[i].desc, entry.desc))
+                {
+                    found = i;
+                    break;
+                }
+            }
+            if (found == NONE)
+            {
+                Pooled pooled;
+                pooled.desc = entry.desc;
+                pooled.unusedFrames = 1;
+                pooled.texture = std::make_unique<Texture>(entry.desc.width, entry.desc.height, entry.desc.internalFormat, 1);
+                pooled.texture->setFilter(GL_LINEAR, GL_LINEAR);
+                pooled.texture->setWrap(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+                mPool.push_back(std::move(pooled));
+                found = GLuint(mPool.size() - 1);
+            }
+            if (mPool[found].unusedFrames > 0)
+            {
+                // first taken this frame
+                mPhysical++;
+                physicalBytes += declaredBytes - previousBytes;
+            }
+            mPool[found].inUse = true;
+            mPool[found].unusedFrames = 0;
+            entry.physical = found;
+        }
+        for (Entry &entry : mEntries)
+        {
+            if ((entry.physical != NONE) && (entry.lastUse == position))
+                mPool[entry.physical].inUse = false;
+        }
+    }
+    mSavedBytes = declaredBytes - physicalBytes;
+}
+
+void RenderGraph::compile()
+{
+    cull();
+    sort();
+    allocate();
+}
+
+Framebuffer &RenderGraph::framebuffer(const std::vector<GLuint> &colour, GLuint depth, GLenum depthAttachment)
+{
+    std::vector<GLuint> key = colour;
+    key.push_back(depth);
+    std::unique_ptr<Framebuffer> &found = mFramebuffers[key];
+    if (!found)
+    {
+        found = std::make_unique<Framebuffer>();
+        found->activate();
+        for (size_t i = 0; i < colour.size(); ++i)
+        {
+            found->attach(GLenum(GL_COLOR_ATTACHMENT0 + i), colour[i]);
+        }
+        if (depth != 0)
+        {
+            found->attach(depthAttachment, depth);
+        }
+        found->drawBuffers(GLsizei(colour.size()));
+        if (!found->complete())
+        {
+            std::cerr << "Render graph framebuffer is incomplete" << std::endl;
+        }
+    }
+    return *found;
+}
+
+void RenderGraph::execute()
+{
+    std::vector<GLuint> colour;
+    for (GLuint p : mOrder)
+    {
+        const Pass &pass = mPasses[p];
+        GLDebugScope scope(pass.name);
+        colour.clear();
+        GLuint depth = 0;
+        GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+        const Entry *target = nullptr;
+        bool onBackbuffer = false;
+        for (const Attachment &write : pass.writes)
+        {
+            const Entry &entry = mEntries[mVersions[write.input].entry];
+            target = (target != nullptr) ? target : &entry;
+            if (entry.backbuffer)
+            {
+                onBackbuffer = true;
+                continue;
+            }
+            const GLuint texture = this->texture(write.input).getTexture();
+            if (is_depth_format(entry.desc.internalFormat))
+            {
+                depth = texture;
+                depthAttachment = has_stencil(entry.desc.internalFormat) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+            }
+            else
+            {
+                colour.push_back(texture);
+            }
+        }
+        if (onBackbuffer && (!colour.empty() || (depth != 0)))
+        {
+            std::cerr << "Pass " << pass.name << " writes the backbuffer and textures at once; it only draws to the backbuffer" << std::endl;
+        }
+
+        if (target != nullptr)
+        {
+            if (onBackbuffer)
+                gl_exec(glBindFramebuffer, GL_FRAMEBUFFER, 0);
+            else
+                framebuffer(colour, depth, depthAttachment).activate();
+            gl_exec(glViewport, 0, 0, target->desc.width, target->desc.height);
+
+            // cleared to zero, and depth to one; the backbuffer's depth and stencil go with its colour
+            GLint drawBuffer = 0;
+            for (const Attachment &write : pass.writes)
+            {
+                const Entry &entry = mEntries[mVersions[write.input].entry];
+                const bool isDepth = !entry.backbuffer && is_depth_format(entry.desc.internalFormat);
+                if (write.clear)
+                {
+                    if (isDepth)
+                    {
+                        clear_depth(has_stencil(entry.desc.internalFormat) ? GL_DEPTH_STENCIL : GL_DEPTH);
+                    }
+                    else if (entry.backbuffer)
+                    {
+                        const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                        gl_exec(glClearBufferfv, GL_COLOR, 0, zero);
+                        clear_depth(GL_DEPTH_STENCIL);
+                    }
+                    else
+                    {
+                        const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                        gl_exec(glClearBufferfv, GL_COLOR, drawBuffer, zero);
+                    }
+                }
+                if (!isDepth && !entry.backbuffer)
+                    drawBuffer++;
+            }
+        }
+        if (pass.execute)
+        {
+            pass.execute(*this);
+        }
+    }
+    gl_exec(glBindFramebuffer, GL_FRAMEBUFFER, 0);
+}
+
+void RenderGraph::reset()
+{
+    mPasses.clear();
+    mEntries.clear();
+    mVersions.clear();
+    mOrder.clear();
+    for (size_t i = mPool.size(); i-- > 0;)
+    {
+        Pooled &pooled = mPool[i];
+        if (++pooled.unusedFrames <= POOL_FRAMES)
+            continue;
+        const GLuint name = pooled.texture->getTexture();
+        for (auto framebuffer = mFramebuffers.begin(); framebuffer != mFramebuffers.end();)
+        {
+            if (std::find(framebuffer->first.begin(), framebuffer->first.end(), name) != framebuffer->first.end())
+                framebuffer = mFramebuffers.erase(framebuffer);
+            else
+                ++framebuffer;
+        }
+        mPool.erase(mPool.begin() + std::ptrdiff_t(i));
+    }
+}
+
+const Texture &RenderGraph::texture(Resource resource) const
+{
+    const Entry &entry = mEntries[mVersions[resource].entry];
+    assert(!entry.backbuffer && ((entry.imported != nullptr) || (entry.physical != NONE)));
+    return (entry.imported != nullptr) ? *entry.imported : *mPool[entry.physical].texture;
+}
+
+std::vector<const char *> RenderGraph::order() const
+{
+    std::vector<const char *> names;
+    for (GLuint p : mOrder)
+    {
+        names.push_back(mPasses[p].name);
+    }
+    return names;
+}
@@ -0,0 +1,107 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdio>
+#include "nanovg.h"
+#include <renderstats.h>
+
+static constexpr float PANEL_WIDTH = 220.0f;
+static constexpr float GRAPH_HEIGHT = 36.0f;
+static constexpr float LINE_HEIGHT = 15.0f;
+static constexpr float PADDING = 6.0f;
+
+void RenderStatsOverlay::push(const RenderStats &stats, float frameMilliseconds)
+{
+    mStats[mNext] = stats;
+    mMilliseconds[mNext] = frameMilliseconds;
+    mNext = (mNext + 1) % HISTORY;
+    mCount = std::min(mCount + 1, HISTORY);
+}
+
+template <typename Value>
+void RenderStatsOverlay::drawGraph(NVGcontext *vg, float x, float y, const char *label, const char *unit, Value value) const
+{
+    const float w = PANEL_WIDTH - 2.0f * PADDING;
+    const float h = GRAPH_HEIGHT;
+
+    nvgBeginPath(vg);
+    nvgRect(vg, x, y, w, h);
+    nvgFillColor(vg, nvgRGBA(0, 0, 0, 128));
+    nvgFill(vg);
+    if (mCount == 0)
+        return;
+
+    // oldest on the left; scaled so the peak just fits
+    float peak = 0.0f;
+    for (size_t i = 0; i < mCount; ++i)
+    {
+        const size_t slot = (mNext + HISTORY - mCount + i) % HISTORY;
+        peak = std::max(peak, float(value(mStats[slot], mMilliseconds[slot])));
+    }
+    peak = std::max(peak, 1e-6f);
+    nvgBeginPath(vg);
+    nvgMoveTo(vg, x, y + h);
+    for (size_t i = 0; i < mCount; ++i)
+    {
+        const size_t slot = (mNext + HISTORY - mCount + i) % HISTORY;
+        const float v = float(value(mStats[slot], mMilliseconds[slot])) / peak;
+        nvgLineTo(vg, x + w * float(i) / float(HISTORY - 1), y + h * (1.0f - 0.9f * v));
+    }
+    nvgLineTo(vg, x + w * float(mCount - 1) / float(HISTORY - 1), y + h);
+    nvgFillColor(vg, nvgRGBA(255, 192, 0, 128));
+    nvgFill(vg);
+
+    char text[64];
+    nvgFontSize(vg, 13.0f);
+    nvgFillColor(vg, nvgRGBA(240, 240, 240, 192));
+    nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+    nvgText(vg, x + 3.0f, y + 2.0f, label, nullptr);
+    std::snprintf(text, sizeof(text), "%.2f %s", double(value(latest(), latestMilliseconds())), unit);
+    nvgTextAlign(vg, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP);
+    nvgText(vg, x + w - 3.0f, y + 2.0f, text, nullptr);
+    std::snprintf(text, sizeof(text), "peak %.2f", double(peak));
+    nvgTextAlign(vg, NVG_ALIGN_RIGHT | NVG_ALIGN_BOTTOM);
+    nvgFillColor(vg, nvgRGBA(240, 240, 240, 128));
+    nvgText(vg, x + w - 3.0f, y + h - 2.0f, text, nullptr);
+}
+
+void RenderStatsOverlay::draw(NVGcontext *vg, float x, float y) const
+{
+    const RenderStats &stats = latest();
+    const char *labels[] = {"draw calls", "instanced", "triangles", "dispatches", "program binds", "VAO binds",
+                            "buffer binds", "uniform uploads", "buffers alive", "programs alive"};
+    const long long counts[] = {(long long)stats.drawCalls,        (long long)stats.instancedDraws, (long long)stats.triangles,
+                                (long long)stats.dispatches,       (long long)stats.programBinds,   (long long)stats.vertexArrayBinds,
+                                (long long)stats.bufferBinds,      (long long)stats.uniformUploads, (long long)stats.buffersAlive,
+                                (long long)stats.programsAlive};
+    const size_t lines = sizeof(counts) / sizeof(counts[0]);
+    const float height = 3.0f * (GRAPH_HEIGHT + PADDING) + float(lines) * LINE_HEIGHT + 2.0f * PADDING;
+
+    nvgSave(vg);
+    nvgFontFace(vg, "sans-bold");
+    nvgBeginPath(vg);
+    nvgRoundedRect(vg, x, y, PANEL_WIDTH, height, 4.0f);
+    nvgFillColor(vg, nvgRGBA(28, 30, 34, 192));
+    nvgFill(vg);
+
+    float row = y + PADDING;
+    drawGraph(vg, x + PADDING, row, "frame", "ms", [](const RenderStats &, float ms) { return ms; });
+    row += GRAPH_HEIGHT + PADDING;
+    drawGraph(vg, x + PADDING, row, "draws", "", [](const RenderStats &s, float) { return s.drawCalls; });
+    row += GRAPH_HEIGHT + PADDING;
+    drawGraph(vg, x + PADDING, row, "uploaded", "KB", [](const RenderStats &s, float) { return double(s.bytesUploaded) / 1024.0; });
+    row += GRAPH_HEIGHT + PADDING;
+
+    char text[32];
+    nvgFontSize(vg, 13.0f);
+    nvgFillColor(vg, nvgRGBA(240, 240, 240, 192));
+    for (size_t i = 0; i < lines; ++i)
+    {
+        nvgTextAlign(vg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+        nvgText(vg, x + PADDING, row, labels[i], nullptr);
+        std::snprintf(text, sizeof(text), "%lld", counts[i]);
+        nvgTextAlign(vg, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP);
+        nvgText(vg, x + PANEL_WIDTH - PADDING, row, text, nullptr);
+        row += LINE_HEIGHT;
+    }
+    nvgRestore(vg);
+}
@@ -5,18 +5,26 @@
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <filesystem>
 #include <utils.h>
 #include <gl_funcalls.h>
 #include <shader.h>
 #include <shaderprogram.h>
 
+static GLuint64 next_program_id = 1;
+
 ShaderProgram::ShaderProgram()
-: program(0)
+: program(0), program_id(next_program_id++), feedback_mode(GL_INTERLEAVED_ATTRIBS)
 {
     shaders[ShaderKind::eVERTEX_SHADER]   = 0;
     shaders[ShaderKind::eFRAGMENT_SHADER] = 0;
     shaders[ShaderKind::eGEOMETRY_SHADER] = 0;
+    shaders[ShaderKind::eCOMPUTE_SHADER]  = 0;
+    shaders[ShaderKind::eTESS_CONTROL_SHADER]    = 0;
+    shaders[ShaderKind::eTESS_EVALUATION_SHADER] = 0;
+    work_group_size[0] = work_group_size[1] = work_group_size[2] = 0;
 }
 
 ShaderProgram::~ShaderProgram()
@@ -28,6 +36,34 @@ ShaderProgram::~ShaderProgram()
     }
 }
 
+ShaderProgram::ShaderProgram(ShaderProgram&& other) noexcept
+: ShaderProgram()
+{
+    swap(other);
+}
+
+ShaderProgram& ShaderProgram::operator=(ShaderProgram&& other) noexcept
+{
+    swap(other);
+    return *this;
+}
+
+void ShaderProgram::swap(ShaderProgram& other) noexcept
+{
+    std::swap(uniforms, other.uniforms);
+    std::swap(attributes, other.attributes);
+    std::swap(uniform_blocks, other.uniform_blocks);
+    std::swap(storage_blocks, other.storage_blocks);
+    std::swap(work_group_size, other.work_group_size);
+    std::swap(shaders, other.shaders);
+    std::swap(sources, other.sources);
+    std::swap(program, other.program);
+    std::swap(program_id, other.program_id);
+    std::swap(attribute_bindings, other.attribute_bindings);
+    std::swap(feedback_varyings, other.feedback_varyings);
+    std::swap(feedback_mode, other.feedback_mode);
+}
+
 void ShaderProgram::use()
 {
     if (program != 0)
@@ -49,8 +85,9 @@ void ShaderProgram::load_from_file(ShaderKind kind, const std::string& filename)
 
 void ShaderProgram::load_from_string(ShaderKind kind, const std::string& source)
 {
-    GLuint glShaderConstants[ShaderKind::eSHADER_COUNT] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
-    shaders[kind] = glCreateShader(glShaderConstants[kind]);
+    GLuint glShaderConstants[ShaderKind::eSHADER_COUNT] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER, GL_COMPUTE_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER };
+    shaders[kind] = gl_exec(glCreateShader, glShaderConstants[kind]);
+    sources[kind] = source;
     GLint source_length = (GLint) source.size();
     GLchar *source_text =  (GLchar*) source.c_str();
     gl_exec(glShaderSource, shaders[kind], 1, &source_text, &source_length);
@@ -128,6 +165,157 @@ void ShaderProgram::gather_uniforms()
     }       
 }
 
+void ShaderProgram::gather_uniform_blocks()
+{
+    GLint num_blocks;
+    gl_exec(glGetProgramiv, program, GL_ACTIVE_UNIFORM_BLOCKS, &num_blocks);
+    for(GLint block_index = 0; block_index < num_blocks; ++block_index)
+    {
+        UniformBlock block;
+        block.index = GLuint(block_index);
+        GLint name_length;
+        gl_exec(glGetActiveUniformBlockiv, program, block.index, GL_UNIFORM_BLOCK_NAME_LENGTH, &name_length);
+        std::vector<GLchar> block_name(name_length + 1, 0);
+        gl_exec(glGetActiveUniformBlockName, program, block.index, name_length, nullptr, block_name.data());
+        block.name = std::string(block_name.data());
+        gl_exec(glGetActiveUniformBlockiv, program, block.index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+
+        GLint num_members;
+        gl_exec(glGetActiveUniformBlockiv, program, block.index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &num_members);
+        std::vector<GLint> member_indices(num_members);
+        if (num_members > 0)
+        {
+            gl_exec(glGetActiveUniformBlockiv, program, block.index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, member_indices.data());
+        }
+        for(GLint member_index : member_indices)
+        {
+            const GLuint uniform_index = GLuint(member_index);
+            GLint member_name_length;
+            gl_exec(glGetActiveUniformsiv, program, 1, &uniform_index, GL_UNIFORM_NAME_LENGTH, &member_name_length);
+            std::vector<GLchar> member_name(member_name_length + 1, 0);
+            gl_exec(glGetActiveUniformName, program, uniform_index, member_name_length, nullptr, member_name.data());
+            UniformBlock::Member member;
+            member.name = std::string(member_name.data());
+            gl_exec(glGetActiveUniformsiv, program, 1, &uniform_index, GL_UNIFORM_OFFSET, &member.offset);
+            block.members.push_back(member);
+        }
+
+        // every program sees the same buffer for a block of this name
+        block.binding = uniform_block_binding(block.name);
+        gl_exec(glUniformBlockBinding, program, block.index, block.binding);
+        uniform_blocks.push_back(block);
+    }
+}
+
+GLint ShaderProgram::UniformBlock::member_offset(const std::string& memberName) const
+{
+    const std::string qualified = name + "." + memberName;
+    // arrays are reflected by their first element
+    const std::string element = memberName + "[0]";
+    for (const Member& member : members)
+    {
+        if (member.name == memberName || member.name == qualified || member.name == element || member.name == qualified + "[0]")
+            return member.offset;
+    }
+    return -1;
+}
+
+const ShaderProgram::UniformBlock* ShaderProgram::uniform_block(const std::string& name) const
+{
+    auto result = std::find_if(std::begin(uniform_blocks), std::end(uniform_blocks), [&name](const UniformBlock& block) { return block.name == name; });
+    return result != std::end(uniform_blocks) ? &*result : nullptr;
+}
+
+void ShaderProgram::gather_storage_blocks()
+{
+    // storage blocks are only reflected through the program interface query
+    if (!GLAD_GL_ARB_shader_storage_buffer_object || !GLAD_GL_ARB_program_interface_query)
+        return;
+    GLint num_blocks;
+    gl_exec(glGetProgramInterfaceiv, program, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &num_blocks);
+    GLint max_name_length;
+    gl_exec(glGetProgramInterfaceiv, program, GL_SHADER_STORAGE_BLOCK, GL_MAX_NAME_LENGTH, &max_name_length);
+    for(GLint block_index = 0; block_index < num_blocks; ++block_index)
+    {
+        StorageBlock block;
+        block.index = GLuint(block_index);
+        std::vector<GLchar> block_name(max_name_length + 1, 0);
+        gl_exec(glGetProgramResourceName, program, GL_SHADER_STORAGE_BLOCK, block.index, max_name_length, nullptr, block_name.data());
+        block.name = std::string(block_name.data());
+        block.binding = storage_block_binding(block.name);
+        gl_exec(glShaderStorageBlockBinding, program, block.index, block.binding);
+        storage_blocks.push_back(block);
+    }
+}
+
+const ShaderProgram::StorageBlock* ShaderProgram::storage_block(const std::string& name) const
+{
+    auto result = std::find_if(std::begin(storage_blocks), std::end(storage_blocks), [&name](const StorageBlock& block) { return block.name == name; });
+    return result != std::end(storage_blocks) ? &*result : nullptr;
+}
+
+
+std::unique_ptr<ShaderProgram> ShaderProgram::depth_only() const
+{
+    std::unique_ptr<ShaderProgram> variant = std::make_unique<ShaderProgram>();
+    variant->attribute_bindings = attributes;
+    for(ShaderKind kind : { eVERTEX_SHADER, eTESS_CONTROL_SHADER, eTESS_EVALUATION_SHADER, eGEOMETRY_SHADER })
+    {
+        if (!sources[kind].empty())
+        {
+            variant->load_from_string(kind, sources[kind]);
+            variant->compile(kind);
+        }
+    }
+    // the fragment shader has to be the same version as the vertex shader
+    std::string version = "#version 330 core";
+    const std::string& vertex = sources[eVERTEX_SHADER];
+    const size_t start = vertex.find("#version");
+    if (start != std::string::npos)
+    {
+        version = vertex.substr(start, vertex.find_first_of("\r\n", start) - start);
+    }
+    variant->load_from_string(eFRAGMENT_SHADER, version + "\nvoid main()\n{\n}\n");
+    variant->compile(eFRAGMENT_SHADER);
+    variant->link();
+    return variant;
+}
+
+void ShaderProgram::dispatch(GLuint x, GLuint y, GLuint z)
+{
+    if (work_group_size[0] == 0)
+    {
+        std::cerr << "Only a linked compute program can be dispatched." << std::endl;
+        return;
+    }
+    use();
+    gl_exec(glDispatchCompute, x, y, z);
+}
+
+void ShaderProgram::dispatch_invocations(GLuint x, GLuint y, GLuint z)
+{
+    const GLuint size[3] = { GLuint(std::max(work_group_size[0], 1)), GLuint(std::max(work_group_size[1], 1)), GLuint(std::max(work_group_size[2], 1)) };
+    dispatch((x + size[0] - 1) / size[0], (y + size[1] - 1) / size[1], (z + size[2] - 1) / size[2]);
+}
+
+GLuint uniform_block_binding(const std::string& blockName)
+{
+    static std::unordered_map<std::string, GLuint> bindings;
+    auto it = bindings.find(blockName);
+    if (it == bindings.end())
+        it = bindings.emplace(blockName, GLuint(bindings.size())).first;
+    return it->second;
+}
+
+GLuint storage_block_binding(const std::string& blockName)
+{
+    static std::unordered_map<std::string, GLuint> bindings;
+    auto it = bindings.find(blockName);
+    if (it == bindings.end())
+        it = bindings.emplace(blockName, GLuint(bindings.size())).first;
+    return it->second;
+}
+
 GLint ShaderProgram::attribute_location(const std::string& name)
 {
     auto result = std::find_if(std::begin(attributes), std::end(attributes), [name](const ShaderParameter& param) { return param.name == name; });
@@ -140,11 +328,25 @@ GLint ShaderProgram::uniform_location(const std::string& name)
     return result != std::end(uniforms) ? result->location : -1;
 }
 
+void ShaderProgram::capture_varyings(const std::vector<std::string>& names, GLenum bufferMode)
+{
+    feedback_varyings = names;
+    feedback_mode = bufferMode;
+}
+
 void ShaderProgram::link()
 {
-    if ((shaders[eVERTEX_SHADER] != 0) && (shaders[eFRAGMENT_SHADER] != 0))
+    const bool compute = shaders[eCOMPUTE_SHADER] != 0;
+    const bool graphics = (shaders[eVERTEX_SHADER] != 0) || (shaders[eFRAGMENT_SHADER] != 0) || (shaders[eGEOMETRY_SHADER] != 0) ||
+                          (shaders[eTESS_CONTROL_SHADER] != 0) || (shaders[eTESS_EVALUATION_SHADER] != 0);
+    if (compute && graphics)
+    {
+        std::cerr << "A compute shader has to be linked into a program of its own." << std::endl;
+        return;
+    }
+    if (compute || ((shaders[eVERTEX_SHADER] != 0) && ((shaders[eFRAGMENT_SHADER] != 0) || !feedback_varyings.empty())))
     {
-        program = glCreateProgram();
+        program = gl_exec(glCreateProgram);
         if (program == 0)        
         {
             std::cerr << "Program creation failed." << std::endl;
@@ -157,6 +359,20 @@ void ShaderProgram::link()
                 gl_exec(glAttachShader, program, shaders[i]);
             }
         }
+        if (!feedback_varyings.empty())
+        {
+            // only takes effect at the next link
+            std::vector<const GLchar*> names;
+            for(const std::string& name : feedback_varyings)
+            {
+                names.push_back(name.c_str());
+            }
+            gl_exec(glTransformFeedbackVaryings, program, GLsizei(names.size()), names.data(), feedback_mode);
+        }
+        for(const ShaderParameter& attribute : attribute_bindings)
+        {
+            gl_exec(glBindAttribLocation, program, attribute.location, attribute.name.c_str());
+        }
         gl_exec(glLinkProgram, program);
         GLint result;
         gl_exec(glGetProgramiv, program, GL_LINK_STATUS, &result);
@@ -193,5 +409,11 @@ void ShaderProgram::link()
         gl_exec(glUseProgram, program);
         gather_attributes();
         gather_uniforms();
+        gather_uniform_blocks();
+        gather_storage_blocks();
+        if (compute)
+        {
+            gl_exec(glGetProgramiv, program, GL_COMPUTE_WORK_GROUP_SIZE, work_group_size);
+        }
     }
 }
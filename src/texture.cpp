@@ -0,0 +1,436 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <gl_funcalls.h>
+#include <texture.h>
+
+// nanovg.c compiles its own stb_image into the examples, so this copy stays private to load_image
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace
+{
+    struct Tap
+    {
+        GLsizei index;
+        float weight;
+    };
+
+    float box_kernel(float x)
+    {
+        return (x >= -0.5f && x < 0.5f) ? 1.0f : 0.0f;
+    }
+
+    float bessel_i0(float x)
+    {
+        // power series, converges quickly for the arguments a kaiser window needs
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 20; ++k)
+        {
+            term *= (x * 0.5f) / float(k);
+            sum += term * term;
+        }
+        return sum;
+    }
+
+    constexpr float KAISER_WIDTH = 3.0f;
+    constexpr float KAISER_ALPHA = 4.0f;
+
+    float kaiser_kernel(float x)
+    {
+        const float t = x / KAISER_WIDTH;
+        if (t <= -1.0f || t >= 1.0f)
+            return 0.0f;
+        const float pi = 3.14159265358979f;
+        const float sinc = x == 0.0f ? 1.0f : std::sin(pi * x) / (pi * x);
+        return sinc * bessel_i0(KAISER_ALPHA * std::sqrt(1.0f - t * t)) / bessel_i0(KAISER_ALPHA);
+    }
+
+    /* taps[i] are the source samples and weights for destination sample i */
+    std::vector<std::vector<Tap>> make_taps(GLsizei source, GLsizei destination, MipFilter filter)
+    {
+        const float scale = float(source) / float(destination);
+        const float support = filter == eMIP_KAISER ? KAISER_WIDTH : 0.5f;
+        std::vector<std::vector<Tap>> taps(destination);
+        for (GLsizei i = 0; i < destination; ++i)
+        {
+            // work in destination units, so the kernel widens with the scale
+            const float centre = (float(i) + 0.5f) * scale;
+            const GLsizei first = GLsizei(std::floor(centre - support * scale));
+            const GLsizei last = GLsizei(std::ceil(centre + support * scale));
+            float total = 0.0f;
+            for (GLsizei j = first; j <= last; ++j)
+            {
+                const float x = (float(j) + 0.5f - centre) / scale;
+                const float weight = filter == eMIP_KAISER ? kaiser_kernel(x) : box_kernel(x);
+                if (weight != 0.0f)
+                {
+                    taps[i].push_back({std::clamp<GLsizei>(j, 0, source - 1), weight});
+                    total += weight;
+                }
+            }
+            for (Tap &tap : taps[i])
+                tap.weight /= total;
+        }
+        return taps;
+    }
+
+    float linear_to_srgb(float c)
+    {
+        return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    }
+
+    void for_rows(JobSystem *jobs, GLsizei rows, size_t valuesPerRow, const std::function<void(size_t, size_t)> &body)
+    {
+        if (jobs == nullptr)
+        {
+            body(0, size_t(rows));
+            return;
+        }
+        jobs->parallel_for(size_t(rows), std::max<size_t>(1, 16384 / std::max<size_t>(valuesPerRow, 1)), body);
+    }
+
+    /* separable resample of source into destination, which must already be sized */
+    void downsample(const Image &source, Image &destination, MipFilter filter, bool srgb, JobSystem *jobs)
+    {
+        const GLint channels = source.channels;
+        // alpha is coverage, not colour, so it is never gamma corrected
+        const GLint colourChannels = (srgb && channels >= 3) ? 3 : 0;
+
+        float decode[2][256];
+        for (int i = 0; i < 256; ++i)
+        {
+            const float c = float(i) / 255.0f;
+            decode[0][i] = c;
+            decode[1][i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        const auto columns = make_taps(source.width, destination.width, filter);
+        const auto rows = make_taps(source.height, destination.height, filter);
+
+        // horizontal pass: source rows into floats, destination width
+        std::vector<float> wide(size_t(destination.width) * source.height * channels);
+        for_rows(jobs, source.height, size_t(destination.width) * channels, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y)
+            {
+                const GLubyte *in = &source.pixels[y * source.rowSize()];
+                float *out = &wide[y * destination.width * channels];
+                for (GLsizei x = 0; x < destination.width; ++x)
+                {
+                    for (GLint c = 0; c < channels; ++c)
+                    {
+                        const float *table = decode[c < colourChannels ? 1 : 0];
+                        float sum = 0.0f;
+                        for (const Tap &tap : columns[x])
+                            sum += table[in[tap.index * channels + c]] * tap.weight;
+                        out[x * channels + c] = sum;
+                    }
+                }
+            }
+        });
+
+        // vertical pass back to bytes
+        for_rows(jobs, destination.height, destination.rowSize(), [&](size_t begin, size_t end) {
+            const size_t stride = size_t(destination.width) * channels;
+            for (size_t y = begin; y < end; ++y)
+            {
+                GLubyte *out = &destination.pixels[y * destination.rowSize()];
+                for (size_t i = 0; i < stride; ++i)
+                {
+                    float sum = 0.0f;
+                    for (const Tap &tap : rows[y])
+                        sum += wide[tap.index * stride + i] * tap.weight;
+                    // the kaiser lobes can ring past the ends of the range
+                    sum = std::clamp(sum, 0.0f, 1.0f);
+                    if (GLint(i % channels) < colourChannels)
+                        sum = linear_to_srgb(sum);
+                    out[i] = GLubyte(sum * 255.0f + 0.5f);
+                }
+            }
+        });
+    }
+
+    /* unsized format matching an internal format, for glTexImage2D */
+    GLenum base_format(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_R8:
+            return GL_RED;
+        case GL_RG8:
+            return GL_RG;
+        case GL_RGB8:
+        case GL_SRGB8:
+            return GL_RGB;
+        case GL_DEPTH_COMPONENT16:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32:
+        case GL_DEPTH_COMPONENT32F:
+            return GL_DEPTH_COMPONENT;
+        case GL_DEPTH24_STENCIL8:
+        case GL_DEPTH32F_STENCIL8:
+            return GL_DEPTH_STENCIL;
+        default:
+            return GL_RGBA;
+        }
+    }
+}
+
+Image load_image(const std::filesystem::path &filename)
+{
+    Image image;
+    int width, height, channels;
+    stbi_uc *pixels = stbi_load(filename.string().c_str(), &width, &height, &channels, 0);
+    if (pixels == nullptr)
+    {
+        std::cerr << "Could not load " << filename << ": " << stbi_failure_reason() << std::endl;
+        return image;
+    }
+    image.width = width;
+    image.height = height;
+    image.channels = channels;
+    image.pixels.assign(pixels, pixels + size_t(width) * height * channels);
+    stbi_image_free(pixels);
+    return image;
+}
+
+GLsizei mip_count(GLsizei width, GLsizei height)
+{
+    GLsizei levels = 1;
+    for (GLsizei size = std::max(width, height); size > 1; size /= 2)
+        ++levels;
+    return levels;
+}
+
+void build_mip_chain(std::vector<Image> &levels, MipFilter filter, bool srgb, JobSystem *jobs)
+{
+    assert(!levels.empty());
+    if (filter != eMIP_BOX && filter != eMIP_KAISER)
+    {
+        levels.resize(1);
+        return;
+    }
+    const GLsizei count = mip_count(levels[0].width, levels[0].height);
+    levels.resize(count);
+    for (GLsizei level = 1; level < count; ++level)
+    {
+        const Image &source = levels[level - 1];
+        Image &destination = levels[level];
+        destination.width = std::max(1, source.width / 2);
+        destination.height = std::max(1, source.height / 2);
+        destination.channels = source.channels;
+        destination.pixels.resize(destination.rowSize() * destination.height);
+        downsample(source, destination, filter, srgb, jobs);
+    }
+}
+
+Texture::Texture(GLsizei width, GLsizei height, GLenum internalFormat, GLsizei levels)
+: mWidth(width), mHeight(height), mLevels(levels > 0 ? levels : mip_count(width, height)), mInternalFormat(internalFormat),
+  mImmutable(GLAD_GL_ARB_texture_storage != 0)
+{
+    gl_exec(glGenTextures, 1, &mTexture);
+    bindForUpdate();
+    if (mImmutable)
+    {
+        gl_exec(glTexStorage2D, GL_TEXTURE_2D, mLevels, mInternalFormat, mWidth, mHeight);
+    }
+    else
+    {
+        // every level has to be specified for the texture to be complete
+        for (GLsizei level = 0; level < mLevels; ++level)
+        {
+            const GLenum format = base_format(mInternalFormat);
+            gl_exec(glTexImage2D, GL_TEXTURE_2D, level, GLint(mInternalFormat), std::max(1, mWidth >> level), std::max(1, mHeight >> level), 0,
+                    format, format == GL_DEPTH_STENCIL ? GL_UNSIGNED_INT_24_8 : GL_UNSIGNED_BYTE, nullptr);
+        }
+        gl_exec(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mLevels - 1);
+    }
+    setFilter(mLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR, GL_LINEAR);
+    setWrap(GL_REPEAT, GL_REPEAT);
+}
+
+Texture::~Texture()
+{
+    if (mTexture != 0)
+    {
+        state_cache().forgetTexture(mTexture);
+        gl_exec(glDeleteTextures, 1, &mTexture);
+    }
+}
+
+Texture::Texture(Texture &&other) noexcept
+: mTexture(std::exchange(other.mTexture, 0)), mWidth(other.mWidth), mHeight(other.mHeight), mLevels(other.mLevels),
+  mInternalFormat(other.mInternalFormat), mImmutable(other.mImmutable)
+{
+}
+
+Texture &Texture::operator=(Texture &&other) noexcept
+{
+    std::swap(mTexture, other.mTexture);
+    std::swap(mWidth, other.mWidth);
+    std::swap(mHeight, other.mHeight);
+    std::swap(mLevels, other.mLevels);
+    std::swap(mInternalFormat, other.mInternalFormat);
+    std::swap(mImmutable, other.mImmutable);
+    return *this;
+}
+
+GLenum Texture::internalFormat(GLint channels, bool srgb)
+{
+    switch (channels)
+    {
+    case 1:
+        return GL_R8;
+    case 2:
+        return GL_RG8;
+    case 3:
+        return srgb ? GL_SRGB8 : GL_RGB8;
+    default:
+        return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    }
+}
+
+GLenum Texture::pixelFormat(GLint channels)
+{
+    switch (channels)
+    {
+    case 1:
+        return GL_RED;
+    case 2:
+        return GL_RG;
+    case 3:
+        return GL_RGB;
+    default:
+        return GL_RGBA;
+    }
+}
+
+void Texture::upload(GLint level, GLint y, GLsizei rows, GLenum format, const void *pixels)
+{
+    assert(level < mLevels);
+    bindForUpdate();
+    // image rows are tightly packed, 3 channel ones are rarely a multiple of 4
+    gl_exec(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+    gl_exec(glTexSubImage2D, GL_TEXTURE_2D, level, 0, y, std::max(1, mWidth >> level), rows, format, GL_UNSIGNED_BYTE, pixels);
+    gl_exec(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Texture::upload(GLint level, const Image &image)
+{
+    assert(image.width == std::max(1, mWidth >> level) && image.height == std::max(1, mHeight >> level));
+    upload(level, 0, image.height, pixelFormat(image.channels), image.pixels.data());
+}
+
+void Texture::generateMipmaps()
+{
+    bindForUpdate();
+    gl_exec(glGenerateMipmap, GL_TEXTURE_2D);
+}
+
+void Texture::setFilter(GLenum minFilter, GLenum magFilter)
+{
+    bindForUpdate();
+    gl_exec(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GLint(minFilter));
+    gl_exec(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GLint(magFilter));
+}
+
+void Texture::setWrap(GLenum wrapS, GLenum wrapT)
+{
+    bindForUpdate();
+    gl_exec(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GLint(wrapS));
+    gl_exec(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GLint(wrapT));
+}
+
+void Texture::setAnisotropy(GLfloat anisotropy)
+{
+    if (!GLAD_GL_ARB_texture_filter_anisotropic && !GLAD_GL_EXT_texture_filter_anisotropic)
+        return;
+    GLfloat maximum = 1.0f;
+    gl_exec(glGetFloatv, GL_MAX_TEXTURE_MAX_ANISOTROPY, &maximum);
+    bindForUpdate();
+    gl_exec(glTexParameterf, GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, std::clamp(anisotropy, 1.0f, maximum));
+}
+
+TextureArray::TextureArray(GLsizei width, GLsizei height, GLsizei layers, GLenum internalFormat, GLsizei levels)
+: mWidth(width), mHeight(height), mLayers(layers), mLevels(levels > 0 ? levels : mip_count(width, height)), mInternalFormat(internalFormat)
+{
+    gl_exec(glGenTextures, 1, &mTexture);
+    bindForUpdate();
+    if (GLAD_GL_ARB_texture_storage)
+    {
+        gl_exec(glTexStorage3D, GL_TEXTURE_2D_ARRAY, mLevels, mInternalFormat, mWidth, mHeight, mLayers);
+    }
+    else
+    {
+        for (GLsizei level = 0; level < mLevels; ++level)
+        {
+            gl_exec(glTexImage3D, GL_TEXTURE_2D_ARRAY, level, GLint(mInternalFormat), std::max(1, mWidth >> level), std::max(1, mHeight >> level), mLayers, 0,
+                    base_format(mInternalFormat), GL_UNSIGNED_BYTE, nullptr);
+        }
+        gl_exec(glTexParameteri, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, mLevels - 1);
+    }
+    setFilter(mLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR, GL_LINEAR);
+    // atlas pages must not wrap into their neighbours
+    setWrap(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+}
+
+TextureArray::~TextureArray()
+{
+    if (mTexture != 0)
+    {
+        state_cache().forgetTexture(mTexture);
+        gl_exec(glDeleteTextures, 1, &mTexture);
+    }
+}
+
+TextureArray::TextureArray(TextureArray &&other) noexcept
+: mTexture(std::exchange(other.mTexture, 0)), mWidth(other.mWidth), mHeight(other.mHeight), mLayers(other.mLayers), mLevels(other.mLevels),
+  mInternalFormat(other.mInternalFormat)
+{
+}
+
+TextureArray &TextureArray::operator=(TextureArray &&other) noexcept
+{
+    std::swap(mTexture, other.mTexture);
+    std::swap(mWidth, other.mWidth);
+    std::swap(mHeight, other.mHeight);
+    std::swap(mLayers, other.mLayers);
+    std::swap(mLevels, other.mLevels);
+    std::swap(mInternalFormat, other.mInternalFormat);
+    return *this;
+}
+
+void TextureArray::upload(GLint level, GLint layer, const Image &image)
+{
+    assert(level < mLevels && layer < mLayers);
+    assert(image.width == std::max(1, mWidth >> level) && image.height == std::max(1, mHeight >> level));
+    bindForUpdate();
+    gl_exec(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+    gl_exec(glTexSubImage3D, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, image.width, image.height, 1,
+            Texture::pixelFormat(image.channels), GL_UNSIGNED_BYTE, image.pixels.data());
+    gl_exec(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+}
+
+void TextureArray::generateMipmaps()
+{
+    bindForUpdate();
+    gl_exec(glGenerateMipmap, GL_TEXTURE_2D_ARRAY);
+}
+
+void TextureArray::setFilter(GLenum minFilter, GLenum magFilter)
+{
+    bindForUpdate();
+    gl_exec(glTexParameteri, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GLint(minFilter));
+    gl_exec(glTexParameteri, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GLint(magFilter));
+}
+
+void TextureArray::setWrap(GLenum wrapS, GLenum wrapT)
+{
+    bindForUpdate();
+    gl_exec(glTexParameteri, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GLint(wrapS));
+    gl_exec(glTexParameteri, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GLint(wrapT));
+}
@@ -0,0 +1,400 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <gl_funcalls.h>
+#include <texturepacker.h>
+
+namespace
+{
+    bool contains(const PackRect &outer, const PackRect &inner)
+    {
+        return inner.x >= outer.x && inner.y >= outer.y &&
+               inner.x + inner.width <= outer.x + outer.width &&
+               inner.y + inner.height <= outer.y + outer.height;
+    }
+
+    /* expand an image to more channels: grey fills rgb, missing alpha is opaque */
+    Image convert_channels(const Image &source, GLint channels)
+    {
+        if (source.channels == channels)
+            return source;
+        Image result;
+        result.width = source.width;
+        result.height = source.height;
+        result.channels = channels;
+        result.pixels.resize(result.rowSize() * result.height);
+        const size_t count = size_t(source.width) * source.height;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const GLubyte *in = &source.pixels[i * source.channels];
+            GLubyte *out = &result.pixels[i * channels];
+            const bool grey = source.channels <= 2;
+            const bool hasAlpha = source.channels == 2 || source.channels == 4;
+            for (GLint c = 0; c < channels; ++c)
+            {
+                if (c == 3 || (channels == 2 && c == 1))
+                    out[c] = hasAlpha ? in[source.channels - 1] : 255;
+                else
+                    out[c] = grey ? in[0] : in[std::min(c, source.channels - 1)];
+            }
+        }
+        return result;
+    }
+
+    /* copy image into page at (x, y), extruding its edge pixels padding deep all round */
+    void blit_padded(Image &page, const Image &image, GLsizei x, GLsizei y, GLsizei padding)
+    {
+        const GLint channels = page.channels;
+        for (GLsizei row = -padding; row < image.height + padding; ++row)
+        {
+            const GLsizei sy = std::clamp<GLsizei>(row, 0, image.height - 1);
+            const GLsizei dy = y + row;
+            if (dy < 0 || dy >= page.height)
+                continue;
+            for (GLsizei column = -padding; column < image.width + padding; ++column)
+            {
+                const GLsizei sx = std::clamp<GLsizei>(column, 0, image.width - 1);
+                const GLsizei dx = x + column;
+                if (dx < 0 || dx >= page.width)
+                    continue;
+                std::copy_n(&image.pixels[(size_t(sy) * image.width + sx) * channels], channels,
+                            &page.pixels[(size_t(dy) * page.width + dx) * channels]);
+            }
+        }
+    }
+
+    Image blank_page(GLsizei width, GLsizei height, GLint channels)
+    {
+        Image page;
+        page.width = width;
+        page.height = height;
+        page.channels = channels;
+        page.pixels.assign(page.rowSize() * height, 0);
+        return page;
+    }
+
+    GLint widest_channels(const std::vector<Image> &images)
+    {
+        GLint channels = 1;
+        for (const Image &image : images)
+            channels = std::max(channels, image.channels);
+        return channels;
+    }
+
+    /* packs into one page with either method */
+    struct PagePacker
+    {
+        PackMethod method;
+        SkylinePacker skyline;
+        MaxRectsPacker maxRects;
+
+        PagePacker(PackMethod method, GLsizei size) : method(method), skyline(size, size), maxRects(size, size)
+        {
+        }
+
+        bool insert(GLsizei width, GLsizei height, PackRect &placed)
+        {
+            return method == ePACK_SKYLINE ? skyline.insert(width, height, placed) : maxRects.insert(width, height, placed);
+        }
+    };
+}
+
+SkylinePacker::SkylinePacker(GLsizei width, GLsizei height)
+: mWidth(width), mHeight(height), mUsed(0)
+{
+    mSkyline.push_back({0, 0, width});
+}
+
+GLsizei SkylinePacker::fit(size_t index, GLsizei width, GLsizei height) const
+{
+    const GLsizei x = mSkyline[index].x;
+    if (x + width > mWidth)
+        return -1;
+    GLsizei y = 0;
+    GLsizei remaining = width;
+    // the rect rests on the highest segment it spans
+    for (size_t i = index; remaining > 0; ++i)
+    {
+        assert(i < mSkyline.size());
+        y = std::max(y, mSkyline[i].y);
+        if (y + height > mHeight)
+            return -1;
+        remaining -= mSkyline[i].width;
+    }
+    return y;
+}
+
+bool SkylinePacker::insert(GLsizei width, GLsizei height, PackRect &placed)
+{
+    size_t best = SIZE_MAX;
+    GLsizei bestTop = mHeight + 1;
+    GLsizei bestWidth = mWidth + 1;
+    for (size_t i = 0; i < mSkyline.size(); ++i)
+    {
+        const GLsizei y = fit(i, width, height);
+        if (y < 0)
+            continue;
+        // lowest top edge first, then the narrowest segment to keep wide ones free
+        if (y + height < bestTop || (y + height == bestTop && mSkyline[i].width < bestWidth))
+        {
+            best = i;
+            bestTop = y + height;
+            bestWidth = mSkyline[i].width;
+        }
+    }
+    if (best == SIZE_MAX)
+        return false;
+
+    placed = {mSkyline[best].x, bestTop - height, width, height};
+    mSkyline.insert(mSkyline.begin() + best, Segment{placed.x, bestTop, width});
+
+    // trim or remove the segments the new one now covers
+    for (size_t i = best + 1; i < mSkyline.size();)
+    {
+        Segment &segment = mSkyline[i];
+        const GLsizei covered = placed.x + width - segment.x;
+        if (covered <= 0)
+            break;
+        if (covered < segment.width)
+        {
+            segment.x += covered;
+            segment.width -= covered;
+            break;
+        }
+        mSkyline.erase(mSkyline.begin() + i);
+    }
+    for (size_t i = 0; i + 1 < mSkyline.size();)
+    {
+        if (mSkyline[i].y == mSkyline[i + 1].y)
+        {
+            mSkyline[i].width += mSkyline[i + 1].width;
+            mSkyline.erase(mSkyline.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    mUsed += size_t(width) * height;
+    return true;
+}
+
+float SkylinePacker::occupancy() const
+{
+    return float(mUsed) / float(size_t(mWidth) * mHeight);
+}
+
+MaxRectsPacker::MaxRectsPacker(GLsizei width, GLsizei height)
+: mWidth(width), mHeight(height), mUsed(0)
+{
+    mFree.push_back({0, 0, width, height});
+}
+
+bool MaxRectsPacker::insert(GLsizei width, GLsizei height, PackRect &placed)
+{
+    const PackRect *best = nullptr;
+    GLsizei bestShort = std::numeric_limits<GLsizei>::max();
+    GLsizei bestLong = std::numeric_limits<GLsizei>::max();
+    for (const PackRect &free : mFree)
+    {
+        if (free.width < width || free.height < height)
+            continue;
+        const GLsizei leftX = free.width - width;
+        const GLsizei leftY = free.height - height;
+        const GLsizei shortSide = std::min(leftX, leftY);
+        const GLsizei longSide = std::max(leftX, leftY);
+        if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+        {
+            best = &free;
+            bestShort = shortSide;
+            bestLong = longSide;
+        }
+    }
+    if (best == nullptr)
+        return false;
+    placed = {best->x, best->y, width, height};
+    split(placed);
+    prune();
+    mUsed += size_t(width) * height;
+    return true;
+}
+
+void MaxRectsPacker::split(const PackRect &used)
+{
+    std::vector<PackRect> created;
+    for (size_t i = 0; i < mFree.size();)
+    {
+        const PackRect free = mFree[i];
+        if (used.x >= free.x + free.width || used.x + used.width <= free.x ||
+            used.y >= free.y + free.height || used.y + used.height <= free.y)
+        {
+            ++i;
+            continue;
+        }
+        // replace the free rect with the maximal rects either side of the used one
+        if (used.x > free.x)
+            created.push_back({free.x, free.y, used.x - free.x, free.height});
+        if (used.x + used.width < free.x + free.width)
+            created.push_back({used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height});
+        if (used.y > free.y)
+            created.push_back({free.x, free.y, free.width, used.y - free.y});
+        if (used.y + used.height < free.y + free.height)
+            created.push_back({free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height});
+        mFree[i] = mFree.back();
+        mFree.pop_back();
+    }
+    mFree.insert(mFree.end(), created.begin(), created.end());
+}
+
+void MaxRectsPacker::prune()
+{
+    for (size_t i = 0; i < mFree.size(); ++i)
+    {
+        for (size_t j = i + 1; j < mFree.size();)
+        {
+            if (contains(mFree[i], mFree[j]))
+            {
+                mFree.erase(mFree.begin() + j);
+            }
+            else if (contains(mFree[j], mFree[i]))
+            {
+                mFree.erase(mFree.begin() + i);
+                j = i + 1;
+            }
+            else
+            {
+                ++j;
+            }
+        }
+    }
+}
+
+float MaxRectsPacker::occupancy() const
+{
+    return float(mUsed) / float(size_t(mWidth) * mHeight);
+}
+
+PackedAtlas pack_atlas(const std::vector<Image> &images, GLsizei pageSize, GLsizei padding, PackMethod method)
+{
+    PackedAtlas atlas;
+    atlas.width = pageSize;
+    atlas.height = pageSize;
+    atlas.channels = widest_channels(images);
+    atlas.remaps.resize(images.size());
+
+    // big images first pack far better
+    std::vector<size_t> order(images.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&images](size_t a, size_t b) {
+        return std::max(images[a].width, images[a].height) > std::max(images[b].width, images[b].height);
+    });
+
+    std::vector<PagePacker> packers;
+    for (size_t index : order)
+    {
+        const Image &image = images[index];
+        const GLsizei width = image.width + padding * 2;
+        const GLsizei height = image.height + padding * 2;
+        if (width > pageSize || height > pageSize)
+        {
+            std::cerr << "Image " << index << " (" << image.width << "x" << image.height << ") does not fit a " << pageSize << " atlas page" << std::endl;
+            continue;
+        }
+        PackRect placed;
+        size_t page = 0;
+        while (page < packers.size() && !packers[page].insert(width, height, placed))
+            ++page;
+        if (page == packers.size())
+        {
+            packers.emplace_back(method, pageSize);
+            atlas.pages.push_back(blank_page(pageSize, pageSize, atlas.channels));
+            packers.back().insert(width, height, placed);
+        }
+        blit_padded(atlas.pages[page], convert_channels(image, atlas.channels), placed.x + padding, placed.y + padding, padding);
+
+        UVRemap &remap = atlas.remaps[index];
+        remap.scaleU = GLfloat(image.width) / GLfloat(pageSize);
+        remap.scaleV = GLfloat(image.height) / GLfloat(pageSize);
+        remap.offsetU = GLfloat(placed.x + padding) / GLfloat(pageSize);
+        remap.offsetV = GLfloat(placed.y + padding) / GLfloat(pageSize);
+        remap.layer = GLfloat(page);
+    }
+    return atlas;
+}
+
+PackedAtlas pack_layers(const std::vector<Image> &images)
+{
+    PackedAtlas atlas;
+    atlas.channels = widest_channels(images);
+    for (const Image &image : images)
+    {
+        atlas.width = std::max(atlas.width, image.width);
+        atlas.height = std::max(atlas.height, image.height);
+    }
+    for (size_t layer = 0; layer < images.size(); ++layer)
+    {
+        const Image &image = images[layer];
+        atlas.pages.push_back(blank_page(atlas.width, atlas.height, atlas.channels));
+        // pad out to the layer size so the smaller images still clamp to their own edge
+        blit_padded(atlas.pages.back(), convert_channels(image, atlas.channels), 0, 0, std::max(atlas.width, atlas.height));
+
+        UVRemap remap;
+        remap.scaleU = GLfloat(image.width) / GLfloat(atlas.width);
+        remap.scaleV = GLfloat(image.height) / GLfloat(atlas.height);
+        remap.layer = GLfloat(layer);
+        atlas.remaps.push_back(remap);
+    }
+    return atlas;
+}
+
+std::shared_ptr<TextureArray> make_texture_array(const PackedAtlas &atlas, MipFilter filter, bool srgb, JobSystem *jobs)
+{
+    if (atlas.pages.empty())
+        return nullptr;
+    const GLsizei levels = filter == eMIP_NONE ? 1 : mip_count(atlas.width, atlas.height);
+    auto texture = std::make_shared<TextureArray>(atlas.width, atlas.height, GLsizei(atlas.pages.size()),
+                                                  Texture::internalFormat(atlas.channels, srgb), levels);
+    for (GLint layer = 0; layer < GLint(atlas.pages.size()); ++layer)
+    {
+        std::vector<Image> chain{atlas.pages[layer]};
+        build_mip_chain(chain, filter, srgb, jobs);
+        for (GLint level = 0; level < GLint(chain.size()); ++level)
+            texture->upload(level, layer, chain[level]);
+    }
+    if (filter == eMIP_GPU)
+        texture->generateMipmaps();
+    return texture;
+}
+
+bool save_uv_table(const UVRemapTable &table, const std::filesystem::path &filename)
+{
+    std::ofstream file(filename);
+    if (!file)
+    {
+        std::cerr << "Could not write " << filename << std::endl;
+        return false;
+    }
+    file.precision(9);
+    for (const UVRemap &remap : table)
+        file << remap.layer << ' ' << remap.scaleU << ' ' << remap.scaleV << ' ' << remap.offsetU << ' ' << remap.offsetV << '\n';
+    return bool(file);
+}
+
+UVRemapTable load_uv_table(const std::filesystem::path &filename)
+{
+    UVRemapTable table;
+    std::ifstream file(filename);
+    if (!file)
+    {
+        std::cerr << "Could not open " << filename << std::endl;
+        return table;
+    }
+    UVRemap remap;
+    while (file >> remap.layer >> remap.scaleU >> remap.scaleV >> remap.offsetU >> remap.offsetV)
+        table.push_back(remap);
+    return table;
+}
@@ -0,0 +1,262 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include "nanovg.h"
+#include <uilayer.h>
+
+UILayer::UILayer(NVGcontext *target)
+: mTarget(target), mRecorder(nullptr), mRecording(nullptr), mWidth(0.0f), mHeight(0.0f), mRatio(0.0f), mRebuilt(0)
+{
+    NVGparams params;
+    std::memset(&params, 0, sizeof(params));
+    params.userPtr = this;
+    // fringes are part of the geometry, so they have to match the target's
+    params.edgeAntiAlias = nvgInternalParams(target)->edgeAntiAlias;
+    params.renderCreate = renderCreate;
+    params.renderCreateTexture = renderCreateTexture;
+    params.renderDeleteTexture = renderDeleteTexture;
+    params.renderUpdateTexture = renderUpdateTexture;
+    params.renderGetTextureSize = renderGetTextureSize;
+    params.renderViewport = renderViewport;
+    params.renderCancel = renderCancel;
+    params.renderFlush = renderFlush;
+    params.renderFill = renderFill;
+    params.renderStroke = renderStroke;
+    params.renderTriangles = renderTriangles;
+    params.renderDelete = renderDelete;
+    mRecorder = nvgCreateInternal(&params);
+}
+
+UILayer::~UILayer()
+{
+    if (mRecorder != nullptr)
+    {
+        nvgDeleteInternal(mRecorder);
+    }
+}
+
+int UILayer::createFont(const char *name, const char *filename)
+{
+    invalidateAll();
+    return nvgCreateFont(mRecorder, name, filename);
+}
+
+size_t UILayer::addPanel(Build build)
+{
+    mPanels.emplace_back();
+    mPanels.back().build = std::move(build);
+    return mPanels.size() - 1;
+}
+
+void UILayer::setPanel(size_t panel, Build build)
+{
+    mPanels[panel].build = std::move(build);
+    mPanels[panel].dirty = true;
+}
+
+void UILayer::invalidate(size_t panel)
+{
+    mPanels[panel].dirty = true;
+}
+
+void UILayer::invalidateAll()
+{
+    for (Panel &panel : mPanels)
+    {
+        panel.dirty = true;
+    }
+}
+
+void UILayer::record(Panel &panel, float windowWidth, float windowHeight, float devicePixelRatio)
+{
+    panel.commands.clear();
+    panel.paths.clear();
+    panel.fillStarts.clear();
+    panel.strokeStarts.clear();
+    panel.vertices.clear();
+    panel.images.clear();
+    panel.dirty = false;
+
+    mRecording = &panel;
+    nvgBeginFrame(mRecorder, windowWidth, windowHeight, devicePixelRatio);
+    if (panel.build)
+    {
+        panel.build(mRecorder);
+    }
+    nvgEndFrame(mRecorder);
+    mRecording = nullptr;
+
+    // vertices is done growing, so the paths can point into it now
+    for (size_t i = 0; i < panel.paths.size(); ++i)
+    {
+        NVGpath &path = panel.paths[i];
+        path.fill = (path.nfill > 0) ? &panel.vertices[panel.fillStarts[i]] : nullptr;
+        path.stroke = (path.nstroke > 0) ? &panel.vertices[panel.strokeStarts[i]] : nullptr;
+    }
+}
+
+void UILayer::draw(float windowWidth, float windowHeight, float devicePixelRatio)
+{
+    if ((windowWidth != mWidth) || (windowHeight != mHeight) || (devicePixelRatio != mRatio))
+    {
+        invalidateAll();
+        mWidth = windowWidth;
+        mHeight = windowHeight;
+        mRatio = devicePixelRatio;
+    }
+
+    mRebuilt = 0;
+    // a build can grow the font atlas, and the old atlas going dirties panels built on it; a second pass catches those
+    for (GLuint pass = 0; pass < 2; ++pass)
+    {
+        for (Panel &panel : mPanels)
+        {
+            if (panel.dirty)
+            {
+                record(panel, windowWidth, windowHeight, devicePixelRatio);
+                mRebuilt++;
+            }
+        }
+    }
+
+    NVGparams *params = nvgInternalParams(mTarget);
+    for (Panel &panel : mPanels)
+    {
+        for (Command &command : panel.commands)
+        {
+            switch (command.kind)
+            {
+            case eFILL:
+                params->renderFill(params->userPtr, &command.paint, command.composite, &command.scissor, command.fringe, command.bounds,
+                                   &panel.paths[command.first], int(command.count));
+                break;
+            case eSTROKE:
+                params->renderStroke(params->userPtr, &command.paint, command.composite, &command.scissor, command.fringe, command.strokeWidth,
+                                     &panel.paths[command.first], int(command.count));
+                break;
+            case eTRIANGLES:
+                params->renderTriangles(params->userPtr, &command.paint, command.composite, &command.scissor, &panel.vertices[command.first],
+                                        int(command.count), command.fringe);
+                break;
+            }
+        }
+    }
+}
+
+void UILayer::recordImage(int image)
+{
+    if ((image != 0) && (std::find(mRecording->images.begin(), mRecording->images.end(), image) == mRecording->images.end()))
+    {
+        mRecording->images.push_back(image);
+    }
+}
+
+int UILayer::renderCreate(void *uptr)
+{
+    return 1;
+}
+
+int UILayer::renderCreateTexture(void *uptr, int type, int w, int h, int imageFlags, const unsigned char *data)
+{
+    NVGparams *target = nvgInternalParams(static_cast<UILayer *>(uptr)->mTarget);
+    return target->renderCreateTexture(target->userPtr, type, w, h, imageFlags, data);
+}
+
+int UILayer::renderDeleteTexture(void *uptr, int image)
+{
+    UILayer *layer = static_cast<UILayer *>(uptr);
+    for (Panel &panel : layer->mPanels)
+    {
+        if (std::find(panel.images.begin(), panel.images.end(), image) != panel.images.end())
+        {
+            panel.dirty = true;
+        }
+    }
+    NVGparams *target = nvgInternalParams(layer->mTarget);
+    return target->renderDeleteTexture(target->userPtr, image);
+}
+
+int UILayer::renderUpdateTexture(void *uptr, int image, int x, int y, int w, int h, const unsigned char *data)
+{
+    NVGparams *target = nvgInternalParams(static_cast<UILayer *>(uptr)->mTarget);
+    return target->renderUpdateTexture(target->userPtr, image, x, y, w, h, data);
+}
+
+int UILayer::renderGetTextureSize(void *uptr, int image, int *w, int *h)
+{
+    NVGparams *target = nvgInternalParams(static_cast<UILayer *>(uptr)->mTarget);
+    return target->renderGetTextureSize(target->userPtr, image, w, h);
+}
+
+void UILayer::renderViewport(void *uptr, float width, float height, float devicePixelRatio)
+{
+}
+
+void UILayer::renderCancel(void *uptr)
+{
+}
+
+void UILayer::renderFlush(void *uptr)
+{
+}
+
+void UILayer::renderFill(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor, float fringe,
+                         const float *bounds, const NVGpath *paths, int npaths)
+{
+    UILayer *layer = static_cast<UILayer *>(uptr);
+    Panel *panel = layer->mRecording;
+    if (panel == nullptr)
+        return;
+    Command command{eFILL, *paint, compositeOperation, *scissor, fringe, 0.0f, {bounds[0], bounds[1], bounds[2], bounds[3]}, panel->paths.size(),
+                    size_t(npaths)};
+    for (int i = 0; i < npaths; ++i)
+    {
+        const NVGpath &path = paths[i];
+        panel->paths.push_back(path);
+        panel->fillStarts.push_back(panel->vertices.size());
+        panel->vertices.insert(panel->vertices.end(), path.fill, path.fill + path.nfill);
+        panel->strokeStarts.push_back(panel->vertices.size());
+        panel->vertices.insert(panel->vertices.end(), path.stroke, path.stroke + path.nstroke);
+    }
+    panel->commands.push_back(command);
+    layer->recordImage(paint->image);
+}
+
+void UILayer::renderStroke(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor, float fringe,
+                           float strokeWidth, const NVGpath *paths, int npaths)
+{
+    UILayer *layer = static_cast<UILayer *>(uptr);
+    Panel *panel = layer->mRecording;
+    if (panel == nullptr)
+        return;
+    Command command{eSTROKE, *paint, compositeOperation, *scissor, fringe, strokeWidth, {0.0f, 0.0f, 0.0f, 0.0f}, panel->paths.size(), size_t(npaths)};
+    for (int i = 0; i < npaths; ++i)
+    {
+        // strokes only use the stroke vertices
+        NVGpath path = paths[i];
+        path.nfill = 0;
+        panel->paths.push_back(path);
+        panel->fillStarts.push_back(panel->vertices.size());
+        panel->strokeStarts.push_back(panel->vertices.size());
+        panel->vertices.insert(panel->vertices.end(), path.stroke, path.stroke + path.nstroke);
+    }
+    panel->commands.push_back(command);
+    layer->recordImage(paint->image);
+}
+
+void UILayer::renderTriangles(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor,
+                              const NVGvertex *verts, int nverts, float fringe)
+{
+    UILayer *layer = static_cast<UILayer *>(uptr);
+    Panel *panel = layer->mRecording;
+    if (panel == nullptr)
+        return;
+    panel->commands.push_back(
+        Command{eTRIANGLES, *paint, compositeOperation, *scissor, fringe, 0.0f, {0.0f, 0.0f, 0.0f, 0.0f}, panel->vertices.size(), size_t(nverts)});
+    panel->vertices.insert(panel->vertices.end(), verts, verts + nverts);
+    layer->recordImage(paint->image);
+}
+
+void UILayer::renderDelete(void *uptr)
+{
+}
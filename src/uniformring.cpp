@@ -0,0 +1,155 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <gl_funcalls.h>
+#include <vectormath_aos.h>
+
+using namespace Vectormath::Aos;
+
+#include <uniformring.h>
+
+/* while tracing, uploads go through glBufferSubData so the trace sees them */
+static bool wants_mapping()
+{
+    return GLAD_GL_ARB_buffer_storage && (gl_trace() == nullptr);
+}
+
+UniformRing::UniformRing(GLsizeiptr bytesPerFrame, GLuint framesInFlight)
+: mBuffer(0), mSegmentSize(bytesPerFrame), mSegmentCount(std::max(framesInFlight, 1u)), mSegment(0), mHead(0), mAlignment(256),
+  mMapped(nullptr), mFences(mSegmentCount, nullptr)
+{
+}
+
+UniformRing::~UniformRing()
+{
+    for (GLsync fence : mFences)
+    {
+        if (fence != nullptr)
+            gl_exec(glDeleteSync, fence);
+    }
+    for (const Retired &retired : mRetired)
+    {
+        release(retired.buffer, retired.mapped);
+    }
+    release(mBuffer, mMapped);
+}
+
+void UniformRing::release(GLuint buffer, GLubyte *mapped)
+{
+    if (buffer == 0)
+        return;
+    if (mapped != nullptr)
+    {
+        gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, buffer);
+        gl_exec(glUnmapBuffer, GL_UNIFORM_BUFFER);
+        gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, 0);
+    }
+    gl_exec(glDeleteBuffers, 1, &buffer);
+}
+
+void UniformRing::create()
+{
+    gl_exec(glGetIntegerv, GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &mAlignment);
+    mAlignment = std::max(mAlignment, 1);
+    // keep every segment starting on an aligned offset
+    mSegmentSize = (mSegmentSize + mAlignment - 1) / mAlignment * mAlignment;
+    const GLsizeiptr size = mSegmentSize * mSegmentCount;
+
+    gl_exec(glGenBuffers, 1, &mBuffer);
+    gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, mBuffer);
+    if (wants_mapping())
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl_exec(glBufferStorage, GL_UNIFORM_BUFFER, size, nullptr, flags);
+        mMapped = static_cast<GLubyte *>(gl_exec(glMapBufferRange, GL_UNIFORM_BUFFER, 0, size, flags));
+    }
+    else
+    {
+        gl_exec(glBufferData, GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+    gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformRing::retire()
+{
+    mRetired.push_back(Retired{mBuffer, mMapped});
+    mBuffer = 0;
+    mMapped = nullptr;
+    // the GPU is done with none of the new buffer's segments, and GL keeps the old one alive for its draws
+    for (GLsync &fence : mFences)
+    {
+        if (fence != nullptr)
+        {
+            gl_exec(glDeleteSync, fence);
+            fence = nullptr;
+        }
+    }
+}
+
+void UniformRing::grow(GLsizeiptr size)
+{
+    retire();
+    mSegmentSize = std::max(mSegmentSize, GLsizeiptr(mAlignment));
+    do
+        mSegmentSize *= 2;
+    while (mSegmentSize < size);
+    std::cerr << "Uniform ring grew to " << mSegmentSize << " bytes per frame" << std::endl;
+    create();
+    mHead = GLsizeiptr(mSegment) * mSegmentSize;
+}
+
+void UniformRing::beginFrame()
+{
+    // a trace started or stopped since the buffer was made wants the other kind
+    if ((mBuffer != 0) && ((mMapped != nullptr) != wants_mapping()))
+        retire();
+    if (mBuffer == 0)
+        create();
+    mSegment = (mSegment + 1) % mSegmentCount;
+    // only blocks if the CPU is more than framesInFlight frames ahead
+    gl_wait_fence(mFences[mSegment]);
+    mHead = GLsizeiptr(mSegment) * mSegmentSize;
+}
+
+void UniformRing::endFrame()
+{
+    if (mBuffer == 0)
+        return;
+    mFences[mSegment] = gl_exec(glFenceSync, GLenum(GL_SYNC_GPU_COMMANDS_COMPLETE), GLbitfield(0));
+    // nothing after this frame binds them, and GL holds on to them for the draws already made
+    for (const Retired &retired : mRetired)
+    {
+        release(retired.buffer, retired.mapped);
+    }
+    mRetired.clear();
+}
+
+UniformRing::Range UniformRing::push(const void *data, GLsizeiptr size)
+{
+    assert(mBuffer != 0);
+    GLsizeiptr offset = (mHead + mAlignment - 1) / mAlignment * mAlignment;
+    if (offset + size > GLsizeiptr(mSegment + 1) * mSegmentSize)
+    {
+        // earlier draws this frame still read what they were given, so move on rather than wrap over it
+        grow(size);
+        offset = mHead;
+    }
+    gl_render_stats().uniformUploads++;
+    if (mMapped != nullptr)
+    {
+        std::memcpy(mMapped + offset, data, size_t(size));
+        // glBufferSubData counts itself
+        gl_render_stats().bytesUploaded += std::uint64_t(size);
+    }
+    else
+    {
+        gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, mBuffer);
+        gl_exec(glBufferSubData, GL_UNIFORM_BUFFER, offset, size, data);
+        gl_exec(glBindBuffer, GL_UNIFORM_BUFFER, 0);
+    }
+    mHead = offset + size;
+    return {mBuffer, offset, size};
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// THIS IS OPTIONAL AND NOT REQUIRED, ONLY USE THIS IF YOU DON'T WANT GLAD TO INCLUDE windows.h
+// GLAD will include windows.h for APIENTRY if it was not previously defined.
+// Make sure you have the correct definition for APIENTRY for platforms which define _WIN32 but don't use __stdcall
+#ifdef _WIN32
+#define APIENTRY __stdcall
+#endif
+
+// GLAD
+#include <glad/glad.h>
+
+// confirm that GLAD didn't include windows.h
+#ifdef _WINDOWS_
+#error windows.h was included!
+#endif
+
+#include <GLFW/glfw3.h>
+
+#include <gl_funcalls.h>
+#include <gltrace.h>
+
+/*
+ * Plays back a trace written with FULGUROUS_TRACE and reports how long each
+ * frame and each entry point took.
+ *
+ *   fulgurous_replay trace.fglt [--loops N] [--csv frames.csv]
+ */
+
+static void usage()
+{
+	std::cerr << "usage: fulgurous_replay <trace> [--loops N] [--csv file]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	const char *tracePath = nullptr;
+	const char *csvPath = nullptr;
+	GLuint loops = 1;
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		if ((std::strcmp(argv[arg], "--loops") == 0) && (arg + 1 < argc))
+			loops = GLuint(std::max(1, std::atoi(argv[++arg])));
+		else if ((std::strcmp(argv[arg], "--csv") == 0) && (arg + 1 < argc))
+			csvPath = argv[++arg];
+		else if (tracePath == nullptr)
+			tracePath = argv[arg];
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (tracePath == nullptr)
+	{
+		usage();
+		return 1;
+	}
+
+	GLTraceReplay replay;
+	if (!replay.open(tracePath))
+		return 1;
+
+	// an invisible window stands in for a headless context, which GLFW cannot make portably
+	if (!glfwInit())
+	{
+		std::cerr << "Failed to initialise GLFW" << std::endl;
+		return 1;
+	}
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *window = glfwCreateWindow(64, 64, "fulgurous_replay", nullptr, nullptr);
+	if (window == nullptr)
+	{
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		window = glfwCreateWindow(64, 64, "fulgurous_replay", nullptr, nullptr);
+	}
+	if (window == nullptr)
+	{
+		std::cerr << "Failed to create a GL context" << std::endl;
+		glfwTerminate();
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cerr << "Failed to initialize OpenGL context" << std::endl;
+		glfwTerminate();
+		return 1;
+	}
+
+	replay.run(loops);
+
+	double wallTotal = 0.0;
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "frame      calls    cpu ms   wall ms" << std::endl;
+	for (const GLTraceReplay::FrameStats &frame : replay.frames())
+	{
+		std::cout << std::setw(5) << frame.frame << std::setw(11) << frame.calls << std::setw(10) << frame.cpuSeconds * 1000.0 << std::setw(10)
+				  << frame.wallSeconds * 1000.0 << std::endl;
+		wallTotal += frame.wallSeconds;
+	}
+	if (!replay.frames().empty())
+	{
+		std::cout << "mean wall ms " << wallTotal * 1000.0 / double(replay.frames().size()) << std::endl;
+	}
+
+	std::cout << std::endl << "entry point                        calls     total ms   mean us" << std::endl;
+	for (const GLTraceReplay::CallStats &call : replay.calls())
+	{
+		std::cout << std::left << std::setw(32) << call.name << std::right << std::setw(9) << call.calls << std::setw(13) << call.seconds * 1000.0
+				  << std::setw(10) << call.seconds * 1e6 / double(call.calls) << std::endl;
+	}
+	if (replay.nameMismatches() > 0)
+	{
+		std::cout << std::endl
+				  << replay.nameMismatches() << " objects got other names than at capture; timings may not reflect the captured work" << std::endl;
+	}
+
+	if (csvPath != nullptr)
+	{
+		std::ofstream csv(csvPath);
+		csv << "frame,calls,cpu_ms,wall_ms\n";
+		for (const GLTraceReplay::FrameStats &frame : replay.frames())
+		{
+			csv << frame.frame << ',' << frame.calls << ',' << frame.cpuSeconds * 1000.0 << ',' << frame.wallSeconds * 1000.0 << '\n';
+		}
+	}
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}